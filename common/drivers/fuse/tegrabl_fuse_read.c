@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <tegrabl_error.h>
 #include <tegrabl_addressmap.h>
 #include <tegrabl_drf.h>
@@ -22,6 +23,7 @@
 #include <arfuse.h>
 #include <arpmc_impl.h>
 #include <tegrabl_timer.h>
+#include <tegrabl_poll.h>
 
 /* Stores the base address of the fuse module */
 static uintptr_t fuse_base_address = NV_ADDRESS_MAP_FUSE_BASE;
@@ -33,6 +35,9 @@ static uintptr_t fuse_base_address = NV_ADDRESS_MAP_FUSE_BASE;
 #define PMC_IMPL_WRITE(reg, val) \
 	NV_WRITE32((NV_ADDRESS_MAP_PMC_IMPL_BASE + (reg)), val)
 
+/* A fuse read takes a few us, this only catches a wedged controller */
+#define FUSE_READ_TIMEOUT_US 1000U
+
 #define PUBKEY_SIZE_BYTES 32U
 #define SBKKEY_SIZE_BYTES 16U
 #define KEKKEY_SIZE_BYTES 32U
@@ -73,12 +78,35 @@ static uintptr_t fuse_base_address = NV_ADDRESS_MAP_FUSE_BASE;
 #define FUSE_RESERVED_APB2JTAG_LOCK_MASK 0x8U
 #define FUSE_BOOT_SECURITY_INFO_SECURE_MASK 0x7U
 
-uint32_t tegrabl_fuserdata_read(uint32_t addr)
+/* Fuse types below this are considered for the snapshot */
+#define FUSE_SNAPSHOT_NUM_TYPES (FUSE_CCPLEX_DFD_ACCESS_DISABLE + 1U)
+
+/*
+ * Fuses do not change during a boot unless cboot burns them, so the
+ * ones tegrabl_fuse_read() serves are read once, in a single visibility
+ * window, and kept here. Secret keys are never copied into it.
+ */
+struct fuse_snapshot {
+	bool valid;
+	uint32_t word[FUSE_SNAPSHOT_NUM_TYPES];
+	tegrabl_error_t err[FUSE_SNAPSHOT_NUM_TYPES];
+	uint32_t uid[ECID_SIZE_BYTES / sizeof(uint32_t)];
+	uint32_t pubkey_hash[PUBKEY_SIZE_BYTES / sizeof(uint32_t)];
+	uint32_t odmid[ODMID_SIZE_BYTES / sizeof(uint32_t)];
+};
+
+static struct fuse_snapshot fuse_snapshot;
+
+tegrabl_error_t tegrabl_fuserdata_read(uint32_t addr, uint32_t *val)
 {
-	uint32_t val;
+	tegrabl_error_t err;
 	bool original_visibility;
 	uint32_t reg;
 
+	if (val == NULL) {
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+	}
+
 	/* set visibility to true */
 	original_visibility = tegrabl_set_fuse_reg_visibility(true);
 
@@ -90,18 +118,26 @@ uint32_t tegrabl_fuserdata_read(uint32_t addr)
 	reg = NV_FLD_SET_DRF_DEF(FUSE, FUSECTRL, FUSECTRL_CMD, READ, reg);
 	NV_FUSE_WRITE(FUSE_FUSECTRL_0, reg);
 
-	do {
-		reg = NV_FUSE_READ(FUSE_FUSECTRL_0);
-	} while (NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_STATE, reg) !=
-			FUSE_FUSECTRL_0_FUSECTRL_STATE_STATE_IDLE);
+	err = tegrabl_poll_until(fuse_base_address + FUSE_FUSECTRL_0,
+							 NV_DRF_NUM(FUSE, FUSECTRL, FUSECTRL_STATE,
+										0xFFFFFFFFU),
+							 NV_DRF_DEF(FUSE, FUSECTRL, FUSECTRL_STATE,
+										STATE_IDLE),
+							 tegrabl_get_timestamp_us() + FUSE_READ_TIMEOUT_US);
+	if (err != TEGRABL_NO_ERROR) {
+		/* FUSERDATA still holds whatever was there before */
+		pr_error("fuse read of 0x%x did not complete\n", addr);
+		goto fail;
+	}
 
 	/* read fuse */
-	val = NV_FUSE_READ(FUSE_FUSERDATA_0);
+	*val = NV_FUSE_READ(FUSE_FUSERDATA_0);
 
+fail:
 	/* set original visibility */
 	(void)tegrabl_set_fuse_reg_visibility(original_visibility);
 
-	return val;
+	return err;
 }
 
 void tegrabl_fuse_program_mirroring(bool is_enable)
@@ -376,21 +412,10 @@ static void fuse_get_enabled_cpu_cores(uint32_t *enabled_cores)
 	*enabled_cores = ~disabled_core_mask;
 }
 
-/**
- * @brief Queries the max size for the given fuse
- *
- * @param type Type of the fuse whose size is to be queried.
- * @param size Argument to hold the size of the fuse.
- *
- * @return TEGRABL_NO_ERROR if operation is successful.
- */
-tegrabl_error_t tegrabl_fuse_query_size(uint32_t type, uint32_t *size)
+/* Size in bytes of a fuse type, 0 if the type is not supported */
+static uint32_t fuse_get_size(uint32_t type)
 {
-	bool flag = false;
-	if (size == NULL) {
-		pr_debug("Empty buffer given to query size\n");
-		return TEGRABL_ERROR(TEGRABL_ERR_NO_MEMORY, 0);
-	}
+	uint32_t size;
 
 	switch (type) {
 	case FUSE_TYPE_BOOT_SECURITY_INFO:
@@ -439,41 +464,60 @@ tegrabl_error_t tegrabl_fuse_query_size(uint32_t type, uint32_t *size)
 	case FUSE_CCPLEX_DFD_ACCESS_DISABLE:
 	case FUSE_PRIVATE1:
 	case FUSE_PRIVATE2:
-		*size = sizeof(uint32_t);
+		size = sizeof(uint32_t);
 		break;
 	case FUSE_UID:
-		*size = ECID_SIZE_BYTES;
+		size = ECID_SIZE_BYTES;
 		break;
 	case FUSE_SECURE_BOOT_KEY:
 	case FUSE_KEK2:
-		*size = SBKKEY_SIZE_BYTES;
+		size = SBKKEY_SIZE_BYTES;
 		break;
 	case FUSE_KEK0:
-		*size = KEK0KEY_SIZE_BYTES;
+		size = KEK0KEY_SIZE_BYTES;
 		break;
 	case FUSE_KEK1:
-		*size = KGKKEY_SIZE_BYTES;
+		size = KGKKEY_SIZE_BYTES;
 		break;
 	case FUSE_PKC_PUBKEY_HASH:
-		*size = PUBKEY_SIZE_BYTES;
+		size = PUBKEY_SIZE_BYTES;
 		break;
 	case FUSE_KEK256:
-		*size = KEKKEY_SIZE_BYTES;
+		size = KEKKEY_SIZE_BYTES;
 		break;
 	case FUSE_ENDORSEMENT_KEY:
-		*size = EKKEY_SIZE_BYTES;
+		size = EKKEY_SIZE_BYTES;
 		break;
 	case FUSE_ODMID:
-		*size = ODMID_SIZE_BYTES;
+		size = ODMID_SIZE_BYTES;
 		break;
 
 	default:
-		pr_error("Unknown fuse type size requested\n");
-		*size = 0;
-		flag = true;
+		size = 0;
 		break;
 	}
-	if (flag) {
+
+	return size;
+}
+
+/**
+ * @brief Queries the max size for the given fuse
+ *
+ * @param type Type of the fuse whose size is to be queried.
+ * @param size Argument to hold the size of the fuse.
+ *
+ * @return TEGRABL_NO_ERROR if operation is successful.
+ */
+tegrabl_error_t tegrabl_fuse_query_size(uint32_t type, uint32_t *size)
+{
+	if (size == NULL) {
+		pr_debug("Empty buffer given to query size\n");
+		return TEGRABL_ERROR(TEGRABL_ERR_NO_MEMORY, 0);
+	}
+
+	*size = fuse_get_size(type);
+	if (*size == 0U) {
+		pr_error("Unknown fuse type size requested\n");
 		return TEGRABL_ERROR(TEGRABL_ERR_NOT_FOUND, 0);
 	}
 	return TEGRABL_NO_ERROR;
@@ -552,43 +596,11 @@ static tegrabl_error_t tegrabl_get_odmid(uint8_t *odmid)
 			odmid, ODMID_SIZE_BYTES);
 }
 
-/**
- * @brief Reads the requested fuse into the input buffer.
- *
- * @param type Type of the fuse to be read.
- * @param buffer Buffer to hold the data read.
- * @param size Size(in bytes) of the fuse to be read.
- *
- * @return TEGRABL_NO_ERROR if operation is successful.
- */
-tegrabl_error_t tegrabl_fuse_read(
-	fuse_type_t type, uint32_t *buffer, uint32_t size)
+/* Reads a fuse from the fuse registers, which must be visible */
+static tegrabl_error_t fuse_read_hw(fuse_type_t type, uint32_t *buffer)
 {
-	uint32_t temp_size = 0;
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
 	uint32_t reg_data = 0;
-	(void)tegrabl_set_fuse_reg_visibility(true);
-	if (buffer == NULL) {
-		pr_debug("Null pointer passed to read the fuse\n");
-		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
-		goto fail;
-	}
-
-	if (size > 0U) {
-		err = tegrabl_fuse_query_size(type, &temp_size);
-		if (err != 0) {
-			goto fail;
-		}
-		if (temp_size < size) {
-			pr_debug("wrong size supplied in argument\n");
-			err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
-			goto fail;
-		}
-	} else {
-		pr_debug("Size to be read cannot be zero\n");
-		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
-		goto fail;
-	}
 
 	switch (type) {
 	case FUSE_SEC_BOOTDEV:
@@ -602,11 +614,6 @@ tegrabl_error_t tegrabl_fuse_read(
 		*buffer = fuse_get_boot_security_info();
 		break;
 	case FUSE_UID:
-		/* Check if the UID size 16B */
-		if (ECID_SIZE_BYTES != size) {
-			err = TEGRABL_ERR_OUT_OF_RANGE;
-			goto fail;
-		}
 		fuse_query_uid(buffer);
 		break;
 	case FUSE_PKC_PUBKEY_HASH:
@@ -797,6 +804,143 @@ tegrabl_error_t tegrabl_fuse_read(
 		err = TEGRABL_ERROR(TEGRABL_ERR_NOT_FOUND, 0);
 		break;
 	}
+fail:
+	return err;
+}
+
+static bool fuse_is_secret(fuse_type_t type)
+{
+	switch (type) {
+	case FUSE_SECURE_BOOT_KEY:
+	case FUSE_KEK256:
+	case FUSE_KEK0:
+	case FUSE_KEK1:
+	case FUSE_KEK2:
+	case FUSE_ENDORSEMENT_KEY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static uint32_t *fuse_snapshot_slot(fuse_type_t type)
+{
+	switch (type) {
+	case FUSE_UID:
+		return fuse_snapshot.uid;
+	case FUSE_PKC_PUBKEY_HASH:
+		return fuse_snapshot.pubkey_hash;
+	case FUSE_ODMID:
+		return fuse_snapshot.odmid;
+	default:
+		return &fuse_snapshot.word[type];
+	}
+}
+
+void tegrabl_fuse_snapshot_init(void)
+{
+	bool original_visibility;
+	fuse_type_t type;
+
+	original_visibility = tegrabl_set_fuse_reg_visibility(true);
+
+	for (type = 0; type < FUSE_SNAPSHOT_NUM_TYPES; type++) {
+		if ((fuse_get_size(type) == 0U) || fuse_is_secret(type)) {
+			continue;
+		}
+		fuse_snapshot.err[type] = fuse_read_hw(type,
+											   fuse_snapshot_slot(type));
+	}
+
+	(void)tegrabl_set_fuse_reg_visibility(original_visibility);
+
+	fuse_snapshot.valid = true;
+}
+
+void tegrabl_fuse_snapshot_invalidate(void)
+{
+	fuse_snapshot.valid = false;
+}
+
+/* Keys are read straight into the caller's buffer, with the fuses made
+ * visible only for the read */
+static tegrabl_error_t fuse_read_secret(fuse_type_t type, uint32_t *buffer,
+										uint32_t size)
+{
+	uint32_t key[FUSEDATA_MAXSIZE];
+	bool original_visibility;
+	tegrabl_error_t err;
+
+	original_visibility = tegrabl_set_fuse_reg_visibility(true);
+	err = fuse_read_hw(type, key);
+	(void)tegrabl_set_fuse_reg_visibility(original_visibility);
+
+	if (err == TEGRABL_NO_ERROR) {
+		memcpy(buffer, key, size);
+	}
+	memset(key, 0, sizeof(key));
+
+	return err;
+}
+
+/**
+ * @brief Reads the requested fuse into the input buffer.
+ *
+ * @param type Type of the fuse to be read.
+ * @param buffer Buffer to hold the data read.
+ * @param size Size(in bytes) of the fuse to be read.
+ *
+ * @return TEGRABL_NO_ERROR if operation is successful.
+ */
+tegrabl_error_t tegrabl_fuse_read(
+	fuse_type_t type, uint32_t *buffer, uint32_t size)
+{
+	uint32_t temp_size = 0;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	if (buffer == NULL) {
+		pr_debug("Null pointer passed to read the fuse\n");
+		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+		goto fail;
+	}
+
+	if (size > 0U) {
+		err = tegrabl_fuse_query_size(type, &temp_size);
+		if (err != 0) {
+			goto fail;
+		}
+		if (temp_size < size) {
+			pr_debug("wrong size supplied in argument\n");
+			err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+			goto fail;
+		}
+	} else {
+		pr_debug("Size to be read cannot be zero\n");
+		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+		goto fail;
+	}
+
+	/* Check if the UID size 16B */
+	if ((type == FUSE_UID) && (ECID_SIZE_BYTES != size)) {
+		err = TEGRABL_ERR_OUT_OF_RANGE;
+		goto fail;
+	}
+
+	if (fuse_is_secret(type)) {
+		err = fuse_read_secret(type, buffer, size);
+		goto fail;
+	}
+
+	if (!fuse_snapshot.valid) {
+		tegrabl_fuse_snapshot_init();
+	}
+
+	err = fuse_snapshot.err[type];
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
+	memcpy(buffer, fuse_snapshot_slot(type), size);
+
 fail:
 	if (err != 0U) {
 		pr_error("Error = %d in tegrabl_fuse_read\n", err);
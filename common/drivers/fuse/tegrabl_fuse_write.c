@@ -22,9 +22,11 @@
 #include <tegrabl_fuse.h>
 #include <arfuse.h>
 #include <tegrabl_timer.h>
+#include <tegrabl_poll.h>
 #include <tegrabl_fuse_bitmap.h>
 #include <tegrabl_malloc.h>
 #include <tegrabl_soc_misc.h>
+#include <tegrabl_task.h>
 
 /* Stores the base address of the fuse module */
 static uintptr_t fuse_base_address = NV_ADDRESS_MAP_FUSE_BASE;
@@ -33,9 +35,40 @@ static uintptr_t fuse_base_address = NV_ADDRESS_MAP_FUSE_BASE;
 #define NV_FUSE_WRITE(reg, data) NV_WRITE32((fuse_base_address + ((uint32_t)reg)), data)
 #define FUSE_DISABLEREGPROGRAM_0_VAL_MASK 0x1U
 #define FUSE_STROBE_PROGRAMMING_PULSE 5
+/* A burn or sense of the fuse array completes well within this */
+#define FUSE_CTRL_TIMEOUT_US 10000U
+
+/* Poll FUSE_FUSECTRL_0_FUSECTRL_STATE until it reads back STATE_IDLE */
+#define FUSE_WAIT_IDLE() \
+	tegrabl_poll_until(fuse_base_address + FUSE_FUSECTRL_0, \
+		NV_DRF_NUM(FUSE, FUSECTRL, FUSECTRL_STATE, 0xFFFFFFFFU), \
+		NV_DRF_DEF(FUSE, FUSECTRL, FUSECTRL_STATE, STATE_IDLE), \
+		tegrabl_get_timestamp_us() + FUSE_CTRL_TIMEOUT_US)
 
 static uint32_t fuse_word;
 
+/* Set between tegrabl_fuse_write_batch_begin() and _end() */
+static bool fuse_batch_active;
+static bool fuse_batch_visibility;
+
+/*
+ * Keys only read back while mirroring is on, which the programming window
+ * turns off. A batch reads them before the window opens and wipes them at
+ * the end; other fuses come from the fuse snapshot.
+ */
+static const uint32_t fuse_batch_key_types[] = {
+	FUSE_SECURE_BOOT_KEY,
+	FUSE_KEK256,
+	FUSE_KEK0,
+	FUSE_KEK1,
+	FUSE_KEK2,
+	FUSE_ENDORSEMENT_KEY,
+};
+#define FUSE_BATCH_NUM_KEYS \
+	(sizeof(fuse_batch_key_types) / sizeof(fuse_batch_key_types[0]))
+static uint32_t fuse_batch_keys[FUSE_BATCH_NUM_KEYS][FUSEDATA_MAXSIZE];
+static tegrabl_error_t fuse_batch_key_err[FUSE_BATCH_NUM_KEYS];
+
 #define write_fuse_word_0(name, data)								\
 {																	\
 	fuse_word =	(name##_ADDR_0_MASK & data) <<						\
@@ -179,9 +212,10 @@ fail:
 	return err;
 }
 
-static void fuse_write_post_process(void)
+static tegrabl_error_t fuse_write_post_process(void)
 {
 	uint32_t data;
+	tegrabl_error_t err;
 
 	/* Enable back fuse mirroring and set PD to 1,
 	 * wait for the required setup time
@@ -202,11 +236,10 @@ static void fuse_write_post_process(void)
 	 */
 	tegrabl_udelay(50);
 
-	/* Poll FUSE_FUSECTRL_0_FUSECTRL_STATE until it reads back STATE_IDLE */
-	do {
-		data = NV_FUSE_READ(FUSE_FUSECTRL_0);
-		data = NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_STATE, data);
-	} while (data != FUSE_FUSECTRL_0_FUSECTRL_STATE_STATE_IDLE);
+	err = FUSE_WAIT_IDLE();
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 
 	/* Simultaneously set FUSE_PRIV2INTFC_START_0_PRIV2INTFC_START_DATA &
 	 * _PRIV2INTFC_SKIP_RECORDS
@@ -227,21 +260,26 @@ static void fuse_write_post_process(void)
 	/* Poll FUSE_FUSECTRL_0 until both FUSECTRL_FUSE_SENSE_DONE is set,
 	 * and FUSECTRL_STATE is STATE_IDLE
 	 */
-	do {
-		data = NV_FUSE_READ(FUSE_FUSECTRL_0);
-		data = NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_FUSE_SENSE_DONE, data);
-	} while (data == 0UL);
+	err = tegrabl_poll_while(fuse_base_address + FUSE_FUSECTRL_0,
+			NV_DRF_NUM(FUSE, FUSECTRL, FUSECTRL_FUSE_SENSE_DONE, 0xFFFFFFFFU), 0U,
+			tegrabl_get_timestamp_us() + FUSE_CTRL_TIMEOUT_US);
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 
-	do {
-		data = NV_FUSE_READ(FUSE_FUSECTRL_0);
-		data = NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_STATE, data);
-	} while (data != FUSE_FUSECTRL_0_FUSECTRL_STATE_STATE_IDLE);
+	err = FUSE_WAIT_IDLE();
 
+fail:
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("error = 0x%x in fuse_write_post_process\n", err);
+	}
+	return err;
 }
 
-static void fuse_initiate_burn(void)
+static tegrabl_error_t fuse_initiate_burn(void)
 {
 	uint32_t data;
+	tegrabl_error_t err;
 
 	/* Initiate the fuse burn */
 	data = NV_FUSE_READ(FUSE_FUSECTRL_0);
@@ -255,19 +293,23 @@ static void fuse_initiate_burn(void)
 	tegrabl_udelay(50);
 
 	/* Wait for the fuse burn to complete */
-	do {
-		data = NV_FUSE_READ(FUSE_FUSECTRL_0);
-		data = NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_STATE, data);
-	} while (data != FUSE_FUSECTRL_0_FUSECTRL_STATE_STATE_IDLE);
+	err = FUSE_WAIT_IDLE();
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 
+	/* A batch verifies all fuses together once it is sensed */
+	if (fuse_batch_active) {
+		goto fail;
+	}
 
 	/* check that the correct data has been burned correctly
 	 * by reading back the data
 	 */
-	do {
-		data = NV_FUSE_READ(FUSE_FUSECTRL_0);
-		data = NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_STATE, data);
-	} while (data != FUSE_FUSECTRL_0_FUSECTRL_STATE_STATE_IDLE);
+	err = FUSE_WAIT_IDLE();
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 
 	data = NV_FUSE_READ(FUSE_FUSECTRL_0);
 	data = NV_FLD_SET_DRF_DEF(FUSE, FUSECTRL, FUSECTRL_CMD, READ, data);
@@ -279,25 +321,35 @@ static void fuse_initiate_burn(void)
 	 */
 	tegrabl_udelay(50);
 
-	do {
-		data = NV_FUSE_READ(FUSE_FUSECTRL_0);
-		data = NV_DRF_VAL(FUSE, FUSECTRL, FUSECTRL_STATE, data);
-	} while (data != FUSE_FUSECTRL_0_FUSECTRL_STATE_STATE_IDLE);
+	err = FUSE_WAIT_IDLE();
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 
 	data = NV_FUSE_READ(FUSE_FUSERDATA_0);
+
+fail:
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("error = 0x%x in fuse_initiate_burn\n", err);
+	}
+	return err;
 }
 
 static tegrabl_error_t fuse_burn(uint32_t addr)
 {
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	tegrabl_error_t post_err;
 
 	if (fuse_word == 0UL) {
 		goto fail;
 	}
 
-	err = fuse_write_pre_process();
-	if (err != TEGRABL_NO_ERROR) {
-		goto fail;
+	/* In a batch the macro stays powered for programming until the end */
+	if (!fuse_batch_active) {
+		err = fuse_write_pre_process();
+		if (err != TEGRABL_NO_ERROR) {
+			goto fail;
+		}
 	}
 	/* Set the desired fuse dword address */
 	NV_FUSE_WRITE(FUSE_FUSEADDR_0, addr);
@@ -305,9 +357,15 @@ static tegrabl_error_t fuse_burn(uint32_t addr)
 	/* Set the desired fuses to burn */
 	NV_FUSE_WRITE(FUSE_FUSEWDATA_0, fuse_word);
 
-	fuse_initiate_burn();
+	err = fuse_initiate_burn();
 
-	fuse_write_post_process();
+	/* Power the macro down and sense again even if the burn timed out */
+	if (!fuse_batch_active) {
+		post_err = fuse_write_post_process();
+		if (err == TEGRABL_NO_ERROR) {
+			err = post_err;
+		}
+	}
 fail:
 	if (err != TEGRABL_NO_ERROR) {
 		pr_error("error = 0x%x in fuse_burn\n", err);
@@ -315,6 +373,41 @@ fail:
 	return err;
 }
 
+/* Index of fuse_type in fuse_batch_key_types, FUSE_BATCH_NUM_KEYS if it is
+ * not a key */
+static uint32_t fuse_batch_key_index(uint32_t fuse_type)
+{
+	uint32_t i;
+
+	for (i = 0; i < FUSE_BATCH_NUM_KEYS; i++) {
+		if (fuse_batch_key_types[i] == fuse_type) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+/* Reads every key a batch may burn while mirroring is still on */
+static void fuse_batch_read_keys(void)
+{
+	uint32_t size;
+	uint32_t i;
+
+	for (i = 0; i < FUSE_BATCH_NUM_KEYS; i++) {
+		fuse_batch_key_err[i] = tegrabl_fuse_query_size(
+			fuse_batch_key_types[i], &size);
+		if ((fuse_batch_key_err[i] == TEGRABL_NO_ERROR) &&
+			(size > sizeof(fuse_batch_keys[i]))) {
+			fuse_batch_key_err[i] = TEGRABL_ERROR(TEGRABL_ERR_TOO_SMALL, 1);
+		}
+		if (fuse_batch_key_err[i] == TEGRABL_NO_ERROR) {
+			fuse_batch_key_err[i] = tegrabl_fuse_read(
+				fuse_batch_key_types[i], fuse_batch_keys[i], size);
+		}
+	}
+}
+
 static tegrabl_error_t fuse_set_macro_and_burn(
 	uint32_t fuse_type, uint32_t *buffer, uint32_t size)
 {
@@ -322,6 +415,7 @@ static tegrabl_error_t fuse_set_macro_and_burn(
 	uint32_t temp_size = 0;
 	uint32_t *temp_buffer = NULL;
 	uint32_t i = 0;
+	uint32_t key;
 
 	if (buffer == NULL) {
 		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 3);
@@ -345,7 +439,16 @@ static tegrabl_error_t fuse_set_macro_and_burn(
 	}
 	memset(temp_buffer, 0, temp_size);
 
-	err = tegrabl_fuse_read(fuse_type, temp_buffer, temp_size);
+	/* A batch has mirroring off, keys come from what it read beforehand */
+	key = fuse_batch_key_index(fuse_type);
+	if (fuse_batch_active && (key < FUSE_BATCH_NUM_KEYS)) {
+		err = fuse_batch_key_err[key];
+		if (err == TEGRABL_NO_ERROR) {
+			memcpy(temp_buffer, fuse_batch_keys[key], temp_size);
+		}
+	} else {
+		err = tegrabl_fuse_read(fuse_type, temp_buffer, temp_size);
+	}
 	if (err != TEGRABL_NO_ERROR) {
 		goto fail;
 	}
@@ -1329,12 +1432,24 @@ tegrabl_error_t tegrabl_fuse_write(
 
 	val_bef_burn = *fuse_val;
 
+	/* Programming window and verification belong to the batch */
+	if (fuse_batch_active) {
+		err = fuse_set_macro_and_burn(fuse_type, fuse_val, size);
+		goto fail;
+	}
+
+	/* No deferred work while program voltage is applied */
+	tegrabl_task_no_yield_begin();
+
 	/* Make all fuse registers visible */
 	original_visibility = tegrabl_set_fuse_reg_visibility(true);
 	tegrabl_pmc_fuse_control_ps18_latch_set();
 
 	err = fuse_set_macro_and_burn(fuse_type, fuse_val, size);
+	/* Even a failed burn may have changed some bits */
+	tegrabl_fuse_snapshot_invalidate();
 	if (err != TEGRABL_NO_ERROR) {
+		tegrabl_task_no_yield_end();
 		goto fail;
 	}
 
@@ -1342,6 +1457,7 @@ tegrabl_error_t tegrabl_fuse_write(
 	tegrabl_mdelay(2);
 
 	tegrabl_pmc_fuse_control_ps18_latch_clear();
+	tegrabl_task_no_yield_end();
 
 	/* Restore back the original visibility */
 	(void)tegrabl_set_fuse_reg_visibility(original_visibility);
@@ -1358,3 +1474,71 @@ fail:
 	}
 	return err;
 }
+
+tegrabl_error_t tegrabl_fuse_write_batch_begin(void)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	if (fuse_batch_active) {
+		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 7);
+		goto fail;
+	}
+
+	/* Values to burn are checked against these, read while mirroring is on */
+	tegrabl_fuse_snapshot_init();
+	fuse_batch_read_keys();
+
+	/* No deferred work while program voltage is applied, until _end() */
+	tegrabl_task_no_yield_begin();
+
+	fuse_batch_visibility = tegrabl_set_fuse_reg_visibility(true);
+	tegrabl_pmc_fuse_control_ps18_latch_set();
+
+	err = fuse_write_pre_process();
+	if (err != TEGRABL_NO_ERROR) {
+		tegrabl_pmc_fuse_control_ps18_latch_clear();
+		(void)tegrabl_set_fuse_reg_visibility(fuse_batch_visibility);
+		tegrabl_task_no_yield_end();
+		memset(fuse_batch_keys, 0, sizeof(fuse_batch_keys));
+		goto fail;
+	}
+
+	fuse_batch_active = true;
+
+fail:
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("error = 0x%x in tegrabl_fuse_write_batch_begin\n", err);
+	}
+	return err;
+}
+
+tegrabl_error_t tegrabl_fuse_write_batch_end(void)
+{
+	tegrabl_error_t err;
+
+	if (!fuse_batch_active) {
+		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 8);
+		goto fail;
+	}
+
+	/* One sense makes every word burnt in the batch visible; the window is
+	 * closed the same way whether it worked or not */
+	err = fuse_write_post_process();
+
+	/* Wait to make sure fuses are burnt */
+	tegrabl_mdelay(2);
+
+	tegrabl_pmc_fuse_control_ps18_latch_clear();
+	(void)tegrabl_set_fuse_reg_visibility(fuse_batch_visibility);
+	tegrabl_task_no_yield_end();
+
+	fuse_batch_active = false;
+	tegrabl_fuse_snapshot_invalidate();
+	memset(fuse_batch_keys, 0, sizeof(fuse_batch_keys));
+
+fail:
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("error = 0x%x in tegrabl_fuse_write_batch_end\n", err);
+	}
+	return err;
+}
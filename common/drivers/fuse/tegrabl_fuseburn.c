@@ -113,8 +113,9 @@ static uint32_t tegrabl_fuse_calculate_parity(uint32_t value)
 	return parity;
 }
 
-static uint32_t tegrabl_fuse_generate_fuse_h2_ecc(void)
+static tegrabl_error_t tegrabl_fuse_generate_fuse_h2_ecc(uint32_t *h2)
 {
+	tegrabl_error_t err;
 	uint32_t start_row_index = 0;
 	uint32_t start_bit_index = 0;
 	uint32_t end_row_index = 0;
@@ -134,7 +135,11 @@ static uint32_t tegrabl_fuse_generate_fuse_h2_ecc(void)
 
 	for (row_index = start_row_index;
 		row_index <= end_row_index; row_index++) {
-		row_data = tegrabl_fuserdata_read(row_index);
+		err = tegrabl_fuserdata_read(row_index, &row_data);
+		if (err != TEGRABL_NO_ERROR) {
+			pr_error("Failed to read fuse row 0x%x\n", row_index);
+			return err;
+		}
 		pr_debug("fuse :%0x has value :%0x\n", row_index, row_data);
 		for (bit_index = 0; bit_index < 32; bit_index++) {
 			pattern++;
@@ -155,7 +160,8 @@ static uint32_t tegrabl_fuse_generate_fuse_h2_ecc(void)
 	hamming_code = hamming_value | (1 << 12) | (parity ^ 1 << 13);
 
 	pr_debug("hamming code value is %0x\n", hamming_code);
-	return hamming_code;
+	*h2 = hamming_code;
+	return TEGRABL_NO_ERROR;
 }
 
 /* validate fuse according magic ID */
@@ -391,6 +397,10 @@ tegrabl_error_t burn_fuses(uint8_t *buffer, uint32_t bufsize)
 	pnode = fuseinfo.nodes;
 	pdata = fuseinfo.data;
 	pr_info("Burning fuses\n");
+	e = tegrabl_fuse_write_batch_begin();
+	if (e != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 	for (i = 0; i < fuseinfo.head->fusenum; i++) {
 		/* burn SecurityMode at last */
 		if (pnode->type != FUSE_SECURITY_MODE) {
@@ -399,9 +409,10 @@ tegrabl_error_t burn_fuses(uint8_t *buffer, uint32_t bufsize)
 			if (e != TEGRABL_NO_ERROR) {
 				pr_error("Fuse value set failed for %s\n",
 					tegrabl_map_fusename_to_type[pnode->type]);
+				(void)tegrabl_fuse_write_batch_end();
 				goto fail;
 			}
-			pr_info("fuse : %s burnt successfully\n",
+			pr_info("fuse : %s programmed\n",
 				tegrabl_map_fusename_to_type[pnode->type]);
 		} else {
 			secmdata = *(uint32_t *)pdata;
@@ -410,6 +421,11 @@ tegrabl_error_t burn_fuses(uint8_t *buffer, uint32_t bufsize)
 		pdata += pnode->size >> 2;
 		pnode++;
 	}
+	e = tegrabl_fuse_write_batch_end();
+	if (e != TEGRABL_NO_ERROR) {
+		pr_error("Failed to sense burnt fuses\n");
+		goto fail;
+	}
 
 	ret = parse_fuse_info(buffer_local, &fuseinfo);
 	if (ret) {
@@ -428,7 +444,11 @@ tegrabl_error_t burn_fuses(uint8_t *buffer, uint32_t bufsize)
 	if (burnsecm != 0U) {
 		uint32_t fuse_h2_value = 0;
 
-		fuse_h2_value = tegrabl_fuse_generate_fuse_h2_ecc();
+		e = tegrabl_fuse_generate_fuse_h2_ecc(&fuse_h2_value);
+		if (e != TEGRABL_NO_ERROR) {
+			pr_error("Hamming ECC generation failed\n");
+			goto fail;
+		}
 		pr_info("Hamming ECC value is %0x\n", fuse_h2_value);
 
 		e = tegrabl_fuse_write(FUSE_H2, &fuse_h2_value, burnsecm);
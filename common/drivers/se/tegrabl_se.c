@@ -26,6 +26,7 @@
 #include <tegrabl_se_helper.h>
 #include <tegrabl_dmamap.h>
 #include <tegrabl_timer.h>
+#include <tegrabl_poll.h>
 #include <arse0.h>
 
 #define SUBKEY_CACHE_SIZE 2U
@@ -36,6 +37,16 @@
 			TEGRABL_CRYPTO_SHA_MIN_BUF_SIZE))
 #define SE_AES_MAX_INPUT_SIZE	(SE_AES_BLOCK_LENGTH * \
 		SE0_AES0_CRYPTO_LAST_BLOCK_0_WRITE_MASK)
+/* Longest SE0 operation, a 16MB SHA/AES chunk, is a few tens of ms */
+#define SE0_OP_TIMEOUT_US 1000000U
+
+/* Wait until an SE0 engine STATUS register no longer reads Busy.
+ * SE0_*_STATUS_0_STATE_* are the same for each STATUS register,
+ * using AES0 status' state. */
+#define SE0_WAIT_IDLE(status_reg) \
+	tegrabl_poll_while((uint32_t)NV_ADDRESS_MAP_SE0_BASE + (status_reg), \
+		NV_DRF_NUM(SE0_AES0, STATUS, STATE, 0xFFFFFFFFU), SE0_OP_STATUS_BUSY, \
+		tegrabl_get_timestamp_us() + SE0_OP_TIMEOUT_US)
 
 /**
  * @brief Defines the aux info enums for keyslot errors
@@ -139,58 +150,6 @@ static tegrabl_error_t tegrabl_start_se0_operation(
 	return err;
 }
 
-/* Check if SE0 engine status is Busy or not */
-static tegrabl_error_t tegrabl_is_se0_engine_busy(
-	uint8_t se_engine_index, bool *engine_status)
-{
-	uint32_t se_config_offset = 0;
-	uint32_t se_config_reg = 0;
-	uint8_t status = 0;
-	bool flag = false;
-	tegrabl_error_t err = TEGRABL_NO_ERROR;
-
-	if (engine_status == NULL) {
-		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
-		goto fail;
-	}
-
-	switch (se_engine_index) {
-	case ARSE_ENG_IDX_AES0:
-		se_config_offset = SE0_AES0_STATUS_0;
-		break;
-	case ARSE_ENG_IDX_SHA:
-		se_config_offset = SE0_SHA_STATUS_0;
-		break;
-	case ARSE_ENG_IDX_PKA0:
-		se_config_offset = SE0_RSA_STATUS_0;
-		break;
-	default:
-		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
-		flag = true;
-		break;
-	}
-	if (flag) {
-		goto fail;
-	}
-
-	se_config_reg = tegrabl_get_se0_reg(se_config_offset);
-
-	/* SE0_*_STATUS_0_STATE_* are the same for each STATUS register,
-	 * using AES0 status' state.
-	 */
-	status = NV_DRF_VAL(SE0_AES0, STATUS, STATE, se_config_reg);
-	if (status == SE0_OP_STATUS_BUSY) {
-		*engine_status = true;
-	} else {
-		*engine_status = false;
-	}
-fail:
-	if (err != TEGRABL_NO_ERROR) {
-		pr_debug("Error = %d, in tegrabl_is_se0_engine_busy\n", err);
-	}
-	return err;
-}
-
 /* Convert given rsa keysize into the way RSA engine expects */
 static uint32_t tegrabl_convert_rsa_keysize(uint32_t rsa_keysize_bits)
 {
@@ -264,7 +223,6 @@ tegrabl_error_t tegrabl_se_rsa_modular_exp(
 	dma_addr_t dma_input_message_addr = 0;
 	dma_addr_t dma_output_destination = 0;
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
-	bool engine_busy = true;
 
 	if ((pinput_message == NULL) || (poutput_destination == NULL)) {
 		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
@@ -362,11 +320,9 @@ tegrabl_error_t tegrabl_se_rsa_modular_exp(
 		goto fail;
 	}
 	/* Poll for BUSY */
-	while (engine_busy) {
-		err = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_PKA0, &engine_busy);
-		if (err != TEGRABL_NO_ERROR) {
-			goto fail;
-		}
+	err = SE0_WAIT_IDLE(SE0_RSA_STATUS_0);
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
 	}
 
 fail:
@@ -411,7 +367,6 @@ static tegrabl_error_t _tegrabl_se_sha_process_block(
 	uintptr_t block_addr = 0;
 	dma_addr_t dma_block_addr = 0;
 	dma_addr_t dma_hash_result = 0;
-	bool engine_busy = true;
 	bool flag = false;
 
 	if ((input_params == NULL) || (context == NULL)) {
@@ -547,11 +502,9 @@ static tegrabl_error_t _tegrabl_se_sha_process_block(
 	}
 
 	/* Poll for BUSY */
-	while (engine_busy) {
-		err = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_SHA, &engine_busy);
-		if (err != TEGRABL_NO_ERROR) {
-			goto fail;
-		}
+	err = SE0_WAIT_IDLE(SE0_SHA_STATUS_0);
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
 	}
 
 fail:
@@ -1186,7 +1139,6 @@ static tegrabl_error_t tegrabl_se_aes_encrypt_decrypt (
 	tegrabl_error_t ret = TEGRABL_NO_ERROR;
 	dma_addr_t dma_src_addr = 0;
 	dma_addr_t dma_dst_addr = 0;
-	bool engine_busy = true;
 
 	tegrabl_get_se0_mutex();
 
@@ -1246,11 +1198,9 @@ static tegrabl_error_t tegrabl_se_aes_encrypt_decrypt (
 	}
 
 	/* Poll for OP_DONE. */
-	while (engine_busy) {
-		ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0, &engine_busy);
-		if (ret != TEGRABL_NO_ERROR) {
-			goto fail;
-		}
+	ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+	if (ret != TEGRABL_NO_ERROR) {
+		goto fail;
 	}
 
 fail:
@@ -1283,7 +1233,6 @@ static tegrabl_error_t se_aes_cmac_generate_subkey(
 	tegrabl_error_t ret = TEGRABL_NO_ERROR;
 	dma_addr_t dma_zero_addr = 0;
 	dma_addr_t dma_l_addr = 0;
-	bool engine_busy = true;
 
 	if ((zero == NULL) || (L == NULL)) {
 		zero = tegrabl_alloc(TEGRABL_HEAP_DMA, 2U * SE_AES_BLOCK_LENGTH);
@@ -1368,12 +1317,9 @@ static tegrabl_error_t se_aes_cmac_generate_subkey(
 		goto fail;
 	}
 	/* Poll for IDLE. */
-	while (engine_busy) {
-		ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0, &engine_busy);
-
-		if (ret != TEGRABL_NO_ERROR) {
-			goto fail;
-		}
+	ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+	if (ret != TEGRABL_NO_ERROR) {
+		goto fail;
 	}
 
 	/* Unmap DMA buffers */
@@ -1454,7 +1400,6 @@ static tegrabl_error_t se_aes_cmac_hash_blocks(
 	dma_addr_t dma_input_message = 0;
 	dma_addr_t dma_hash_addr = 0;
 	dma_addr_t dma_last_block = 0;
-	bool engine_busy = true;
 
 	TEGRABL_UNUSED(pk2);
 
@@ -1494,13 +1439,9 @@ static tegrabl_error_t se_aes_cmac_hash_blocks(
 	if (is_last) {
 		if (num_blocks > 1UL) {
 			/* Check if SE is idle. */
-			engine_busy = true;
-			while (engine_busy) {
-				ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0,
-					&engine_busy);
-				if (ret != TEGRABL_NO_ERROR)
-					goto fail;
-			}
+			ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+			if (ret != TEGRABL_NO_ERROR)
+				goto fail;
 
 			tegrabl_get_se0_mutex();
 
@@ -1565,13 +1506,9 @@ static tegrabl_error_t se_aes_cmac_hash_blocks(
 			}
 
 			/* Poll for IDLE. */
-			engine_busy = true;
-			while (engine_busy) {
-				ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0,
-					&engine_busy);
-				if (ret != TEGRABL_NO_ERROR)
-					goto fail;
-			}
+			ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+			if (ret != TEGRABL_NO_ERROR)
+				goto fail;
 
 			/* Unmap DMA buffers */
 			tegrabl_dma_unmap_buffer(TEGRABL_MODULE_SE,
@@ -1665,13 +1602,9 @@ static tegrabl_error_t se_aes_cmac_hash_blocks(
 		}
 
 		/* Poll for IDLE. */
-		engine_busy = true;
-		while (engine_busy) {
-			ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0,
-				&engine_busy);
-			if (ret != TEGRABL_NO_ERROR)
-				goto fail;
-		}
+		ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+		if (ret != TEGRABL_NO_ERROR)
+			goto fail;
 		/* Unmap DMA buffers */
 		tegrabl_dma_unmap_buffer(TEGRABL_MODULE_SE,
 			0, (void *)last_block, SE_AES_BLOCK_LENGTH,
@@ -1684,13 +1617,9 @@ static tegrabl_error_t se_aes_cmac_hash_blocks(
 		tegrabl_release_se0_mutex();
 	} else {
 		/* Check if SE is busy, wait if so. */
-		engine_busy = true;
-		while (engine_busy) {
-			ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0,
-				&engine_busy);
-			if (ret != TEGRABL_NO_ERROR)
-				goto fail;
-		}
+		ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+		if (ret != TEGRABL_NO_ERROR)
+			goto fail;
 
 		tegrabl_get_se0_mutex();
 		/* Hash the input data for blocks zero to NumBLocks.
@@ -1754,13 +1683,9 @@ static tegrabl_error_t se_aes_cmac_hash_blocks(
 		}
 
 		/* Block while SE processes this chunk, then release mutex. */
-		engine_busy = true;
-		while (engine_busy) {
-			ret = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0,
-				&engine_busy);
-			if (ret != TEGRABL_NO_ERROR) {
-				goto fail;
-			}
+		ret = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+		if (ret != TEGRABL_NO_ERROR) {
+			goto fail;
 		}
 		/* Unmap DMA buffers */
 		tegrabl_dma_unmap_buffer(TEGRABL_MODULE_SE,
@@ -2632,7 +2557,6 @@ tegrabl_error_t tegrabl_se_generate_random_num(void)
 {
 	uint8_t *buffer = NULL;
 	uint8_t num_of_blocks = 1;  /* Generate only 1 random vector */
-	bool is_engine_busy;
 	tegrabl_error_t error = TEGRABL_NO_ERROR;
 
 	tegrabl_se_pre_configure_drbg();
@@ -2660,14 +2584,7 @@ tegrabl_error_t tegrabl_se_generate_random_num(void)
 	}
 
 	/* Poll for op done */
-	is_engine_busy = true;
-	while (is_engine_busy) {
-		error = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0, &is_engine_busy);
-		if (error != TEGRABL_NO_ERROR) {
-			pr_error("Failed to check se0 engine busy\n");
-			break;
-		}
-	}
+	error = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
 
 	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_SE,
 							 0,
@@ -2675,6 +2592,11 @@ tegrabl_error_t tegrabl_se_generate_random_num(void)
 					(uint32_t)num_of_blocks * SE_AES_BLOCK_LENGTH,
 							 TEGRABL_DMA_FROM_DEVICE);
 
+	if (error != TEGRABL_NO_ERROR) {
+		pr_error("SE0 engine stuck busy\n");
+		goto fail;
+	}
+
 	/* Generate random number in SRK */
 	error = tegrabl_se_init_drbg((uint8_t)SE0_AES0_CONFIG_0_DST_SRK, NULL,
 								 num_of_blocks);
@@ -2689,14 +2611,11 @@ tegrabl_error_t tegrabl_se_generate_random_num(void)
 		goto fail;
 	}
 
-	is_engine_busy = true;
 	/* Poll for op done */
-	while (is_engine_busy) {
-	    error = tegrabl_is_se0_engine_busy(ARSE_ENG_IDX_AES0, &is_engine_busy);
-		if (error != TEGRABL_NO_ERROR) {
-			pr_error("Failed to check se0 engine busy\n");
-			break;
-		}
+	error = SE0_WAIT_IDLE(SE0_AES0_STATUS_0);
+	if (error != TEGRABL_NO_ERROR) {
+		pr_error("SE0 engine stuck busy\n");
+		goto fail;
 	}
 
 fail:
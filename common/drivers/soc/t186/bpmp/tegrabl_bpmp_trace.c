@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_NO_MODULE
+
+#include "build_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_bpmp_fw_interface.h>
+#include <tegrabl_ipc_soc.h>
+#include <tegrabl_bpmp_trace.h>
+#include <tegrabl_task.h>
+#include <bpmp_abi.h>
+
+#if defined(CONFIG_ENABLE_BPMP_IPC_TRACE)
+
+/* Recent requests kept for the dump; older ones only count in the table */
+#define BPMP_TRACE_RING_SIZE	128U
+/* Distinct MRQ/sub-command pairs tracked in the table */
+#define BPMP_TRACE_MAX_ROWS		32U
+/* Round-trip histogram: <16us, <32us, ... <1024us, >=1024us */
+#define BPMP_TRACE_NUM_BUCKETS	8U
+#define BPMP_TRACE_BUCKET0_US	16U
+/* Slowest ring entries printed by the dump */
+#define BPMP_TRACE_TOP			8U
+
+#define BPMP_TRACE_NO_ID		0xFFFFFFFFU
+
+struct bpmp_trace_entry {
+	uint32_t start_us;
+	uint32_t rtt_us;
+	uint32_t id;
+	uint16_t mrq;
+	uint8_t cmd;
+	uint8_t failed;
+	uint8_t req_sz;
+	uint8_t resp_sz;
+};
+
+struct bpmp_trace_row {
+	uint32_t mrq;
+	uint32_t cmd;
+	uint32_t count;
+	uint32_t failures;
+	uint32_t total_us;
+	uint32_t max_us;
+	uint32_t hist[BPMP_TRACE_NUM_BUCKETS];
+};
+
+static struct bpmp_trace_entry bpmp_trace_ring[BPMP_TRACE_RING_SIZE];
+static uint32_t bpmp_trace_count;
+static struct bpmp_trace_row bpmp_trace_rows[BPMP_TRACE_MAX_ROWS];
+static uint32_t bpmp_trace_num_rows;
+static uint32_t bpmp_trace_untracked;
+
+/* Sub-command and target ID from the request layout of each MRQ */
+static void bpmp_trace_decode(uint32_t mrq, const void *req, uint32_t req_sz,
+							  uint32_t *cmd, uint32_t *id)
+{
+	uint32_t word[2] = { 0, BPMP_TRACE_NO_ID };
+
+	memcpy(word, req, (req_sz < sizeof(word)) ? req_sz : sizeof(word));
+
+	switch (mrq) {
+	case MRQ_CLK:
+		*cmd = word[0] >> 24;
+		*id = word[0] & 0xFFFFFFU;
+		break;
+	case MRQ_RESET:
+	case MRQ_PG:
+	case MRQ_I2C:
+		/* cmd, then reset/power domain/bus ID */
+		*cmd = word[0];
+		*id = word[1];
+		break;
+	default:
+		*cmd = (req_sz != 0U) ? word[0] : 0U;
+		*id = BPMP_TRACE_NO_ID;
+		break;
+	}
+}
+
+static void bpmp_trace_account(uint32_t mrq, uint32_t cmd, uint32_t rtt_us,
+							   bool failed)
+{
+	struct bpmp_trace_row *row = NULL;
+	uint32_t bucket;
+	uint32_t i;
+
+	for (i = 0; i < bpmp_trace_num_rows; i++) {
+		if ((bpmp_trace_rows[i].mrq == mrq) &&
+			(bpmp_trace_rows[i].cmd == cmd)) {
+			row = &bpmp_trace_rows[i];
+			break;
+		}
+	}
+	if (row == NULL) {
+		if (bpmp_trace_num_rows == BPMP_TRACE_MAX_ROWS) {
+			bpmp_trace_untracked++;
+			return;
+		}
+		row = &bpmp_trace_rows[bpmp_trace_num_rows++];
+		row->mrq = mrq;
+		row->cmd = cmd;
+	}
+
+	for (bucket = 0; bucket < (BPMP_TRACE_NUM_BUCKETS - 1U); bucket++) {
+		if (rtt_us < (BPMP_TRACE_BUCKET0_US << bucket)) {
+			break;
+		}
+	}
+
+	row->count++;
+	row->total_us += rtt_us;
+	if (rtt_us > row->max_us) {
+		row->max_us = rtt_us;
+	}
+	row->hist[bucket]++;
+	if (failed) {
+		row->failures++;
+	}
+}
+
+tegrabl_error_t tegrabl_bpmp_xfer(void *req, void *resp, uint32_t req_sz,
+	uint32_t resp_sz, uint32_t mrq)
+{
+	struct bpmp_trace_entry *entry;
+	uint32_t cmd;
+	uint32_t id;
+	uint32_t claimed;
+	time_t start;
+	tegrabl_error_t err;
+
+	/* Deferred tasks must not talk to BPMP while this waits for a reply */
+	claimed = tegrabl_task_claim(TEGRABL_TASK_RES_BPMP);
+	start = tegrabl_get_timestamp_us();
+	err = tegrabl_ccplex_bpmp_xfer(req, resp, req_sz, resp_sz, mrq);
+	tegrabl_task_release(claimed);
+
+	entry = &bpmp_trace_ring[bpmp_trace_count % BPMP_TRACE_RING_SIZE];
+	bpmp_trace_count++;
+
+	bpmp_trace_decode(mrq, req, req_sz, &cmd, &id);
+	entry->start_us = (uint32_t)start;
+	entry->rtt_us = (uint32_t)(tegrabl_get_timestamp_us() - start);
+	entry->id = id;
+	entry->mrq = (uint16_t)mrq;
+	entry->cmd = (uint8_t)cmd;
+	entry->failed = (err != TEGRABL_NO_ERROR) ? 1U : 0U;
+	entry->req_sz = (uint8_t)req_sz;
+	entry->resp_sz = (uint8_t)resp_sz;
+
+	bpmp_trace_account(mrq, cmd, entry->rtt_us, entry->failed != 0U);
+
+	return err;
+}
+
+static void bpmp_trace_print_entry(const struct bpmp_trace_entry *entry)
+{
+	pr_info("  @%10u mrq %3u cmd %3u id %5d sz %3u/%3u %6u us%s\n",
+			entry->start_us, entry->mrq, entry->cmd, (int32_t)entry->id,
+			entry->req_sz, entry->resp_sz, entry->rtt_us,
+			(entry->failed != 0U) ? " FAILED" : "");
+}
+
+void tegrabl_bpmp_trace_dump(void)
+{
+	const struct bpmp_trace_row *row;
+	const struct bpmp_trace_entry *entry;
+	uint32_t top[BPMP_TRACE_TOP];
+	uint32_t num_top = 0;
+	uint32_t num_entries;
+	uint32_t total_us = 0;
+	uint32_t i;
+	uint32_t j;
+
+	for (i = 0; i < bpmp_trace_num_rows; i++) {
+		total_us += bpmp_trace_rows[i].total_us;
+	}
+	pr_info("BPMP IPC: %u requests, %u us\n", bpmp_trace_count, total_us);
+	pr_info("  mrq cmd  count fail  total_us avg_us max_us"
+			"  <16 <32 <64 <128 <256 <512 <1k >=1k\n");
+	for (i = 0; i < bpmp_trace_num_rows; i++) {
+		row = &bpmp_trace_rows[i];
+		pr_info("  %3u %3u %6u %4u %9u %6u %6u"
+				" %4u %3u %3u %4u %4u %4u %3u %4u\n",
+				row->mrq, row->cmd, row->count, row->failures, row->total_us,
+				row->total_us / row->count, row->max_us,
+				row->hist[0], row->hist[1], row->hist[2], row->hist[3],
+				row->hist[4], row->hist[5], row->hist[6], row->hist[7]);
+	}
+	if (bpmp_trace_untracked != 0U) {
+		pr_info("  %u requests of other mrq/cmd pairs not tabled\n",
+				bpmp_trace_untracked);
+	}
+
+	num_entries = (bpmp_trace_count < BPMP_TRACE_RING_SIZE) ?
+		bpmp_trace_count : BPMP_TRACE_RING_SIZE;
+
+	/* Insertion into a short list of ring indices, slowest first */
+	for (i = 0; i < num_entries; i++) {
+		for (j = num_top; j > 0U; j--) {
+			if (bpmp_trace_ring[top[j - 1U]].rtt_us >=
+				bpmp_trace_ring[i].rtt_us) {
+				break;
+			}
+			if (j < BPMP_TRACE_TOP) {
+				top[j] = top[j - 1U];
+			}
+		}
+		if (j < BPMP_TRACE_TOP) {
+			top[j] = i;
+			if (num_top < BPMP_TRACE_TOP) {
+				num_top++;
+			}
+		}
+	}
+
+	pr_info("Slowest of the last %u BPMP requests:\n", num_entries);
+	for (i = 0; i < num_top; i++) {
+		bpmp_trace_print_entry(&bpmp_trace_ring[top[i]]);
+	}
+
+	pr_debug("Last %u BPMP requests:\n", num_entries);
+	for (i = bpmp_trace_count - num_entries; i != bpmp_trace_count; i++) {
+		entry = &bpmp_trace_ring[i % BPMP_TRACE_RING_SIZE];
+		pr_debug("  @%10u mrq %3u cmd %3u id %5d %6u us\n", entry->start_us,
+				 entry->mrq, entry->cmd, (int32_t)entry->id, entry->rtt_us);
+	}
+}
+
+#else
+
+tegrabl_error_t tegrabl_bpmp_xfer(void *req, void *resp, uint32_t req_sz,
+	uint32_t resp_sz, uint32_t mrq)
+{
+	uint32_t claimed;
+	tegrabl_error_t err;
+
+	/* Deferred tasks must not talk to BPMP while this waits for a reply */
+	claimed = tegrabl_task_claim(TEGRABL_TASK_RES_BPMP);
+	err = tegrabl_ccplex_bpmp_xfer(req, resp, req_sz, resp_sz, mrq);
+	tegrabl_task_release(claimed);
+
+	return err;
+}
+
+void tegrabl_bpmp_trace_dump(void)
+{
+}
+
+#endif /* CONFIG_ENABLE_BPMP_IPC_TRACE */
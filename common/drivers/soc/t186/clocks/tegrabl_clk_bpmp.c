@@ -15,6 +15,7 @@
 #include <tegrabl_timer.h>
 #include <tegrabl_clock.h>
 #include <tegrabl_bpmp_fw_interface.h>
+#include <tegrabl_bpmp_trace.h>
 #include <tegrabl_clk_rst_soc.h>
 #include <tegrabl_qspi.h>
 #include <tegrabl_drf.h>
@@ -22,6 +23,10 @@
 #include <tegrabl_addressmap.h>
 #include <arpmc_impl.h>
 #include <tegrabl_io.h>
+#include <tegrabl_profiler.h>
+#include <tegrabl_profiler_span.h>
+#include <tegrabl_task.h>
+#include <tegrabl_utils.h>
 
 #include <bpmp_abi.h>
 #include <clk-t186.h>
@@ -51,19 +56,61 @@
 #define NUM_USB_CLKS     15
 #define NUM_USB_TRK_CLKS 3
 
-#define NAME_INDEX          0
-
-#define USB_RATE_INDEX      1
-#define USB_PARENT_INDEX    2
-
 #define NUM_UFS_CLKS        18
 #define NUM_UFS_RSTS        8
-#define UFS_RATE_INDEX      1
-#define UFS_PARENT_INDEX    2
+/* M-PHY PLL lock once its clock control is out of reset, before the lanes */
+#define UFS_MPHY_PLL_SETTLE_US 200U
+#define UFSHC_HS_MAX_KHZ    204000U
 
 static uint32_t pllc4_muxed_rate;
 
-static const uint32_t usb_clk_data[NUM_USB_CLKS][3] = {
+#if defined(CONFIG_ENABLE_QSPI)
+/* QSPI read mode; the build default until tegrabl_car_set_qspi_qddr_read() */
+#if defined(CONFIG_ENABLE_QSPI_QDDR_READ)
+static bool qspi_qddr_read = true;
+#else
+static bool qspi_qddr_read;
+#endif
+#endif
+
+/**
+ * Clock init descriptor: enable clock @id unless @flags has
+ * CLK_INIT_NO_ENABLE, program its @parent and @rate_khz and wait @settle_us
+ * afterwards (only where hardware documents a settle time).
+ * TEGRA186_CLK_CLK_MAX as parent and 0 as rate leave them alone.
+ */
+#define CLK_INIT_NO_ENABLE (1U << 0)
+
+struct clk_init_desc {
+	uint32_t id;
+	uint32_t rate_khz;
+	uint32_t parent;
+	uint32_t flags;
+	uint32_t settle_us;
+};
+
+/**
+ * Reset released by a clock init sequence, followed by @settle_us where
+ * hardware documents a settle time.
+ */
+struct clk_init_rst {
+	uint32_t id;
+	uint32_t settle_us;
+};
+
+/**
+ * Clock/reset bring-up sequence of one controller: its clocks in table
+ * order, then the resets released in table order once all clocks are up.
+ */
+struct clk_init_seq {
+	const char *name;
+	const struct clk_init_desc *clks;
+	uint32_t num_clks;
+	const struct clk_init_rst *rsts;
+	uint32_t num_rsts;
+};
+
+static const struct clk_init_desc usb_clk_data[NUM_USB_CLKS] = {
 	{TEGRA186_CLK_USB2_HSIC_TRK,        9600,   TEGRA186_CLK_OSC},
 	{TEGRA186_CLK_USB2_TRK,             9600,   TEGRA186_CLK_OSC},
 	{TEGRA186_CLK_HSIC_TRK,             9600,   TEGRA186_CLK_OSC},
@@ -81,7 +128,7 @@ static const uint32_t usb_clk_data[NUM_USB_CLKS][3] = {
 	{TEGRA186_CLK_UTMIP_PLL_PWRSEQ,     38400,  TEGRA186_CLK_PLLU}
 };
 
-static const uint32_t ufs_clk_data[NUM_UFS_CLKS][3] = {
+static const struct clk_init_desc ufs_clk_data[NUM_UFS_CLKS] = {
 	{TEGRA186_CLK_OSC,                  0,      TEGRA186_CLK_CLK_MAX},  /* 1 */
 	{TEGRA186_CLK_CLK_M,                38400,  TEGRA186_CLK_CLK_MAX},
 	{TEGRA186_CLK_PLLU,                 38400,  TEGRA186_CLK_OSC},
@@ -90,7 +137,8 @@ static const uint32_t ufs_clk_data[NUM_UFS_CLKS][3] = {
 	{TEGRA186_CLK_PLLREFE_IDDQ,         60000,  TEGRA186_CLK_PLLREFE_REF},
 	{TEGRA186_CLK_PLLREFE_OUT1,         625000, TEGRA186_CLK_PLLREFE_IDDQ},
 #if defined(CONFIG_ENABLE_UFS_HS_MODE)
-	{TEGRA186_CLK_UFSHC,                204000,  TEGRA186_CLK_PLLP_OUT0},
+	/* Raised up to UFSHC_HS_MAX_KHZ by ufs_clock_enable() once up */
+	{TEGRA186_CLK_UFSHC,                0,      TEGRA186_CLK_PLLP_OUT0},
 #else
 	{TEGRA186_CLK_UFSHC,                51000,  TEGRA186_CLK_PLLP_OUT0},
 #endif
@@ -106,15 +154,15 @@ static const uint32_t ufs_clk_data[NUM_UFS_CLKS][3] = {
 	{TEGRA186_CLK_MPHY_L1_RX_ANA,       0,      TEGRA186_CLK_CLK_MAX},
 };
 
-static const uint32_t ufs_rst_data[NUM_UFS_RSTS] = {
-	TEGRA186_RESET_MPHY_CLK_CTL,    /* 1 */
-	TEGRA186_RESET_MPHY_L1_RX,
-	TEGRA186_RESET_MPHY_L1_TX,
-	TEGRA186_RESET_MPHY_L0_RX,      /* 4 */
-	TEGRA186_RESET_MPHY_L0_TX,
-	TEGRA186_RESET_UFSHC,
-	TEGRA186_RESET_UFSHC_AXI_M,
-	TEGRA186_RESET_UFSHC_LP,        /* 8 */
+static const struct clk_init_rst ufs_rst_data[NUM_UFS_RSTS] = {
+	{TEGRA186_RESET_MPHY_CLK_CTL,   UFS_MPHY_PLL_SETTLE_US},    /* 1 */
+	{TEGRA186_RESET_MPHY_L1_RX,     0},
+	{TEGRA186_RESET_MPHY_L1_TX,     0},
+	{TEGRA186_RESET_MPHY_L0_RX,     0},                         /* 4 */
+	{TEGRA186_RESET_MPHY_L0_TX,     0},
+	{TEGRA186_RESET_UFSHC,          0},
+	{TEGRA186_RESET_UFSHC_AXI_M,    0},
+	{TEGRA186_RESET_UFSHC_LP,       0},                         /* 8 */
 };
 
 static uint32_t tegrabl_pllid_to_bpmp_pllid[TEGRABL_CLK_PLL_ID_MAX] = {
@@ -710,12 +758,78 @@ static uint32_t src_clk_tegrabl_to_bpmp(tegrabl_clk_src_id_t src)
 	}
 }
 
+/**
+ * Clock/reset state shadow
+ *
+ * Remembers what BPMP last reported or accepted for each clock, so that
+ * queries and setters which would not change anything are answered without
+ * IPC. Entries are filled lazily by queries and updated on writes.
+ *
+ * BPMP changes state on its own, so the shadow only keeps what cannot go
+ * stale behind our back:
+ * - enables are references counted by BPMP and are always sent; "enabled"
+ *   is only remembered to answer queries, and any disable forgets it
+ *   everywhere (dropping a reference may turn a shared parent off too),
+ * - a rate/parent change forgets every cached rate, as BPMP does not tell
+ *   which clocks are fed from the one changed,
+ * - reset state is not shadowed: BPMP does not report it and changes it
+ *   itself, e.g. when it powergates or unpowergates a partition.
+ */
+#define CLK_SHADOW_ENABLED		(1U << 0)
+#define CLK_SHADOW_PARENT_VALID	(1U << 1)
+#define CLK_SHADOW_RATE_VALID	(1U << 2)
+
+struct clk_shadow {
+	uint8_t flags;
+	uint16_t parent;
+	uint32_t req_khz;	/* last rate requested, 0 if only queried */
+	uint32_t rate_khz;	/* rate reported by BPMP */
+};
+
+static struct clk_shadow clk_shadow[TEGRA186_CLK_CLK_MAX];
+static struct tegrabl_clk_shadow_stats clk_shadow_stats;
+
+static void clk_shadow_forget(uint32_t flag, uint32_t keep_id)
+{
+	uint32_t i;
+
+	for (i = 0; i < TEGRA186_CLK_CLK_MAX; i++) {
+		if (i != keep_id) {
+			clk_shadow[i].flags &= (uint8_t)~flag;
+		}
+	}
+	clk_shadow_stats.invalidations++;
+}
+
+static void clk_shadow_rate_changed(void)
+{
+	clk_shadow_forget(CLK_SHADOW_RATE_VALID, MODULE_NOT_SUPPORTED);
+}
+
+/* Shadow entry of clk_id, NULL if the id is past the table: never cached */
+static struct clk_shadow *clk_shadow_get(uint32_t clk_id)
+{
+	if (clk_id >= ARRAY_SIZE(clk_shadow)) {
+		return NULL;
+	}
+
+	return &clk_shadow[clk_id];
+}
+
+void tegrabl_car_get_shadow_stats(struct tegrabl_clk_shadow_stats *stats)
+{
+	if (stats != NULL) {
+		*stats = clk_shadow_stats;
+	}
+}
+
 static tegrabl_error_t internal_tegrabl_car_set_clk_src(
 		uint32_t clk_id,
 		uint32_t clk_src)
 {
 	struct mrq_clk_request req_clk_set_src;
 	struct mrq_clk_response resp_clk_set_src;
+	struct clk_shadow *shadow;
 
 	if ((clk_id == MODULE_NOT_SUPPORTED) ||
 		(clk_src == TEGRA186_CLK_CLK_MAX)) {
@@ -724,21 +838,87 @@ static tegrabl_error_t internal_tegrabl_car_set_clk_src(
 		return TEGRABL_ERR_NOT_SUPPORTED;
 	}
 
+	shadow = clk_shadow_get(clk_id);
+	if ((shadow != NULL) &&
+		((shadow->flags & CLK_SHADOW_PARENT_VALID) != 0U) &&
+		(shadow->parent == clk_src)) {
+		clk_shadow_stats.hits++;
+		return TEGRABL_NO_ERROR;
+	}
+
 	req_clk_set_src.clk_set_parent.parent_id = clk_src;
 	req_clk_set_src.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_SET_PARENT, clk_id);
 
 	pr_debug("(%s,%d) bpmp_src: %d\n", __func__, __LINE__, clk_src);
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	clk_shadow_rate_changed();
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_set_src, &resp_clk_set_src,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
 					MRQ_CLK)) {
 		pr_error("Error in tx-rx: %s,%d\n", __func__, __LINE__);
+		if (shadow != NULL) {
+			shadow->flags &= (uint8_t)~CLK_SHADOW_PARENT_VALID;
+		}
+		return TEGRABL_ERR_INVALID;
+	}
+
+	if (shadow != NULL) {
+		shadow->parent = (uint16_t)clk_src;
+		shadow->flags |= CLK_SHADOW_PARENT_VALID;
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
+static tegrabl_error_t internal_tegrabl_car_get_parents(
+		uint32_t clk_id,
+		uint32_t *parents,
+		uint32_t *num_parents,
+		uint32_t *curr_parent)
+{
+	struct mrq_clk_request req_clk_info;
+	struct mrq_clk_response resp_clk_info;
+	struct clk_shadow *shadow;
+	uint32_t i;
+
+	if (clk_id == MODULE_NOT_SUPPORTED) {
+		return TEGRABL_ERR_NOT_SUPPORTED;
+	}
+
+	req_clk_info.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_GET_ALL_INFO, clk_id);
+
+	/* TX */
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
+					&req_clk_info, &resp_clk_info,
+					sizeof(struct mrq_clk_request),
+					sizeof(struct mrq_clk_response),
+					MRQ_CLK)) {
+		pr_error("Error in tx-rx: %s,%d\n", __func__, __LINE__);
 		return TEGRABL_ERR_INVALID;
 	}
 
+	/* RX */
+	*num_parents = resp_clk_info.clk_get_all_info.num_parents;
+	if (*num_parents > MAX_PARENTS) {
+		*num_parents = MAX_PARENTS;
+	}
+	for (i = 0; i < *num_parents; i++) {
+		parents[i] = resp_clk_info.clk_get_all_info.parents[i];
+	}
+
+	*curr_parent = resp_clk_info.clk_get_all_info.parent;
+
+	shadow = clk_shadow_get(clk_id);
+	if (shadow != NULL) {
+		shadow->parent = (uint16_t)*curr_parent;
+		shadow->flags |= CLK_SHADOW_PARENT_VALID;
+	}
+
 	return TEGRABL_NO_ERROR;
 }
 
@@ -748,15 +928,24 @@ static tegrabl_error_t internal_tegrabl_car_get_clk_rate(
 {
 	struct mrq_clk_request req_clk_get_rate;
 	struct mrq_clk_response resp_clk_get_rate;
+	struct clk_shadow *shadow;
 
 	if (clk_id == TEGRA186_CLK_CLK_MAX) {
 		return TEGRABL_ERR_NOT_SUPPORTED;
 	}
 
+	shadow = clk_shadow_get(clk_id);
+	if ((shadow != NULL) && ((shadow->flags & CLK_SHADOW_RATE_VALID) != 0U)) {
+		clk_shadow_stats.hits++;
+		*rate_khz = shadow->rate_khz;
+		return TEGRABL_NO_ERROR;
+	}
+
 	req_clk_get_rate.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_GET_RATE, clk_id);
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_get_rate, &resp_clk_get_rate,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
@@ -769,6 +958,13 @@ static tegrabl_error_t internal_tegrabl_car_get_clk_rate(
 	*rate_khz = (resp_clk_get_rate.clk_get_rate.rate)/HZ_1K;
 	pr_debug("Received data (from BPMP) %d\n", *rate_khz);
 
+	/* A clock that is not running yet reports 0; ask again next time */
+	if ((shadow != NULL) && (*rate_khz != 0U)) {
+		shadow->req_khz = 0;
+		shadow->rate_khz = *rate_khz;
+		shadow->flags |= CLK_SHADOW_RATE_VALID;
+	}
+
 	return TEGRABL_NO_ERROR;
 }
 
@@ -779,16 +975,28 @@ static tegrabl_error_t internal_tegrabl_car_set_clk_rate(
 {
 	struct mrq_clk_request req_clk_set_rate;
 	struct mrq_clk_response resp_clk_set_rate;
+	struct clk_shadow *shadow;
 
 	if (clk_id == MODULE_NOT_SUPPORTED) {
 		return TEGRABL_ERR_NOT_SUPPORTED;
 	}
 
+	shadow = clk_shadow_get(clk_id);
+	if ((shadow != NULL) &&
+		((shadow->flags & CLK_SHADOW_RATE_VALID) != 0U) &&
+		((shadow->req_khz == rate_khz) || (shadow->rate_khz == rate_khz))) {
+		clk_shadow_stats.hits++;
+		*rate_set_khz = shadow->rate_khz;
+		return TEGRABL_NO_ERROR;
+	}
+
 	req_clk_set_rate.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_SET_RATE, clk_id);
 	req_clk_set_rate.clk_set_rate.rate = rate_khz*HZ_1K;
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	clk_shadow_rate_changed();
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_set_rate, &resp_clk_set_rate,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
@@ -799,6 +1007,11 @@ static tegrabl_error_t internal_tegrabl_car_set_clk_rate(
 
 	/* RX */
 	*rate_set_khz = (resp_clk_set_rate.clk_set_rate.rate)/HZ_1K;
+	if ((shadow != NULL) && (*rate_set_khz != 0U)) {
+		shadow->req_khz = rate_khz;
+		shadow->rate_khz = *rate_set_khz;
+		shadow->flags |= CLK_SHADOW_RATE_VALID;
+	}
 
 	pr_debug("(%s,%d) Enabled rate %d for %d\n", __func__, __LINE__,
 			 *rate_set_khz, clk_id);
@@ -806,19 +1019,57 @@ static tegrabl_error_t internal_tegrabl_car_set_clk_rate(
 	return TEGRABL_NO_ERROR;
 }
 
+static tegrabl_error_t internal_tegrabl_car_round_clk_rate(
+		uint32_t clk_id,
+		uint32_t rate_khz,
+		uint32_t *rounded_khz)
+{
+	struct mrq_clk_request req_clk_round_rate;
+	struct mrq_clk_response resp_clk_round_rate;
+
+	if (clk_id == MODULE_NOT_SUPPORTED) {
+		return TEGRABL_ERR_NOT_SUPPORTED;
+	}
+
+	req_clk_round_rate.cmd_and_id =
+		BPMP_CLK_CMD(CMD_CLK_ROUND_RATE, clk_id);
+	req_clk_round_rate.clk_round_rate.rate = rate_khz*HZ_1K;
+
+	/* TX */
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
+					&req_clk_round_rate, &resp_clk_round_rate,
+					sizeof(struct mrq_clk_request),
+					sizeof(struct mrq_clk_response),
+					MRQ_CLK)) {
+		pr_error("Error in tx-rx: %s,%d\n", __func__, __LINE__);
+		return TEGRABL_ERR_INVALID;
+	}
+
+	/* RX */
+	*rounded_khz = (resp_clk_round_rate.clk_round_rate.rate)/HZ_1K;
+	pr_debug("(%s,%d) %d rounds to %d for %d\n", __func__, __LINE__,
+			 rate_khz, *rounded_khz, clk_id);
+
+	return TEGRABL_NO_ERROR;
+}
+
 static tegrabl_error_t internal_tegrabl_car_clk_enable(uint32_t clk_id)
 {
 	struct mrq_clk_request req_clk_enable;
 	struct mrq_clk_response resp_clk_enable;
+	struct clk_shadow *shadow;
 
 	if (clk_id == MODULE_NOT_SUPPORTED) {
 		return TEGRABL_ERR_NOT_SUPPORTED;
 	}
 
+	/* Every enable is a reference for BPMP, never answer it locally */
 	req_clk_enable.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_ENABLE, clk_id);
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_enable, &resp_clk_enable,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
@@ -827,6 +1078,10 @@ static tegrabl_error_t internal_tegrabl_car_clk_enable(uint32_t clk_id)
 		return TEGRABL_ERR_INVALID;
 	}
 
+	shadow = clk_shadow_get(clk_id);
+	if (shadow != NULL) {
+		shadow->flags |= CLK_SHADOW_ENABLED;
+	}
 	pr_debug("(%s,%d) Enabled - %d\n", __func__, __LINE__, clk_id);
 
 		return TEGRABL_NO_ERROR;
@@ -836,15 +1091,23 @@ static bool internal_tegrabl_car_clk_is_enabled(uint32_t clk_id)
 {
 	struct mrq_clk_request req_clk_is_enabled;
 	struct mrq_clk_response resp_clk_is_enabled;
+	struct clk_shadow *shadow;
 
 	if (clk_id == MODULE_NOT_SUPPORTED) {
 		return false;
 	}
 
+	shadow = clk_shadow_get(clk_id);
+	if ((shadow != NULL) && ((shadow->flags & CLK_SHADOW_ENABLED) != 0U)) {
+		clk_shadow_stats.hits++;
+		return true;
+	}
+
 	req_clk_is_enabled.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_IS_ENABLED, clk_id);
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_is_enabled, &resp_clk_is_enabled,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
@@ -856,6 +1119,10 @@ static bool internal_tegrabl_car_clk_is_enabled(uint32_t clk_id)
 	pr_debug("(%s,%d) clk(%d) state = %d\n", __func__, __LINE__, clk_id,
 			 resp_clk_is_enabled.clk_is_enabled.state);
 
+	if ((shadow != NULL) && (resp_clk_is_enabled.clk_is_enabled.state != 0)) {
+		shadow->flags |= CLK_SHADOW_ENABLED;
+	}
+
 	return (bool)resp_clk_is_enabled.clk_is_enabled.state;
 }
 
@@ -890,7 +1157,9 @@ static tegrabl_error_t internal_tegrabl_car_clk_disable(uint32_t clk_id)
 	req_clk_disable.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_DISABLE, clk_id);
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	clk_shadow_forget(CLK_SHADOW_ENABLED, MODULE_NOT_SUPPORTED);
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_disable, &resp_clk_disable,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
@@ -918,7 +1187,8 @@ static tegrabl_error_t internal_tegrabl_car_rst(uint32_t rst_id, uint32_t flag)
 	req_rst.reset_id = rst_id;
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_rst, &resp_rst,
 					sizeof(req_rst),
 					sizeof(resp_rst),
@@ -929,6 +1199,287 @@ static tegrabl_error_t internal_tegrabl_car_rst(uint32_t rst_id, uint32_t flag)
 	return TEGRABL_NO_ERROR;
 }
 
+/**
+ * Clock bring-up batching
+ *
+ * BPMP firmware exposes one clk/reset command per MRQ and no command-list
+ * MRQ, so a sequence cannot be packed into fewer IPC messages. What can be
+ * saved are the round trips a sequence asks for but does not need; the
+ * clock shadow answers setters that would change nothing and
+ * read-backs of state BPMP has already reported.
+ * Requests are queued with clk_batch_queue(), issued in order by
+ * clk_batch_flush() and clk_batch_end() reports the round trips saved.
+ *
+ * Completion is checked rather than waited for: BPMP answers an enable
+ * once the clock runs, so a successful reply needs no read-back, and a
+ * set-rate that came back with 0 KHz is polled with CMD_CLK_GET_RATE until
+ * CLK_BATCH_SETTLE_TIMEOUT_US. A fixed delay is only used where the caller
+ * passes a documented settle time, never for a skipped request. The first
+ * error of a batch, including one hit while flushing a full queue, is
+ * returned by clk_batch_end().
+ */
+#define CLK_BATCH_MAX_OPS 64
+#define CLK_BATCH_SETTLE_TIMEOUT_US 1000U
+
+struct clk_batch_op {
+	uint32_t mrq;		/* MRQ_CLK or MRQ_RESET */
+	uint32_t cmd;		/* CMD_CLK_* or CMD_RESET_* */
+	uint32_t id;		/* bpmp clk or reset id */
+	uint32_t arg;		/* parent id or rate in KHz */
+	uint32_t delay_us;	/* documented settle time after the request */
+	uint32_t rate_khz;	/* rate reported by BPMP */
+	uint32_t settle_us;	/* measured time until the request took effect */
+	tegrabl_error_t err;
+};
+
+static struct clk_batch {
+	const char *name;
+	struct clk_batch_op ops[CLK_BATCH_MAX_OPS];
+	uint32_t num_ops;
+	uint32_t num_issued;
+	uint32_t requested;
+	uint32_t round_trips_base;
+	uint32_t max_settle_us;
+	uint32_t max_settle_id;
+	uint32_t span;
+	tegrabl_error_t err;	/* first failure of the batch */
+} clk_batch;
+
+static void clk_batch_begin(const char *name)
+{
+	clk_batch.name = name;
+	clk_batch.num_ops = 0;
+	clk_batch.num_issued = 0;
+	clk_batch.requested = 0;
+	clk_batch.round_trips_base = clk_shadow_stats.round_trips;
+	clk_batch.max_settle_us = 0;
+	clk_batch.max_settle_id = MODULE_NOT_SUPPORTED;
+	clk_batch.err = TEGRABL_NO_ERROR;
+	clk_batch.span = tegrabl_profiler_span_begin(name, TEGRABL_MODULE_CLKRST);
+}
+
+static tegrabl_error_t clk_batch_settle(struct clk_batch_op *op, time_t start)
+{
+	time_t now = start;
+	bool done;
+
+	do {
+		/* Each poll is a request of its own, see clk_batch_end() */
+		clk_batch.requested++;
+		if (internal_tegrabl_car_get_clk_rate(op->id, &op->rate_khz) ==
+			TEGRABL_NO_ERROR) {
+			done = (op->rate_khz != 0U);
+		} else {
+			done = false;
+		}
+		now = tegrabl_get_timestamp_us();
+	} while (!done && ((now - start) < CLK_BATCH_SETTLE_TIMEOUT_US));
+
+	if (!done) {
+		pr_error("%s: clk %u did not settle in %uus\n", clk_batch.name,
+				 op->id, CLK_BATCH_SETTLE_TIMEOUT_US);
+		return TEGRABL_ERROR(TEGRABL_ERR_TIMEOUT, 0);
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
+static tegrabl_error_t clk_batch_flush(void)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	struct clk_batch_op *op;
+	time_t start;
+	uint32_t i;
+
+	for (i = clk_batch.num_issued; i < clk_batch.num_ops; i++) {
+		op = &clk_batch.ops[i];
+		start = tegrabl_get_timestamp_us();
+
+		if (op->mrq == MRQ_RESET) {
+			op->err = internal_tegrabl_car_rst(op->id, op->cmd);
+		} else if (op->cmd == CMD_CLK_ENABLE) {
+			op->err = internal_tegrabl_car_clk_enable(op->id);
+		} else if (op->cmd == CMD_CLK_SET_PARENT) {
+			op->err = internal_tegrabl_car_set_clk_src(op->id, op->arg);
+		} else {
+			op->err = internal_tegrabl_car_set_clk_rate(op->id, op->arg,
+														&op->rate_khz);
+		}
+
+		if ((op->err == TEGRABL_NO_ERROR) && (op->mrq == MRQ_CLK) &&
+			(op->cmd == CMD_CLK_SET_RATE) && (op->rate_khz == 0U)) {
+			op->err = clk_batch_settle(op, start);
+		}
+		op->settle_us = tegrabl_get_timestamp_us() - start;
+		if (op->settle_us > clk_batch.max_settle_us) {
+			clk_batch.max_settle_us = op->settle_us;
+			clk_batch.max_settle_id = op->id;
+		}
+
+		if ((op->err != TEGRABL_NO_ERROR) && (err == TEGRABL_NO_ERROR)) {
+			pr_error("%s: request %u for id %u failed\n", clk_batch.name,
+					 op->cmd, op->id);
+			err = op->err;
+		}
+
+		if (op->delay_us != 0U) {
+			tegrabl_udelay(op->delay_us);
+		}
+	}
+	clk_batch.num_issued = clk_batch.num_ops;
+
+	if (clk_batch.err == TEGRABL_NO_ERROR) {
+		clk_batch.err = err;
+	}
+
+	return err;
+}
+
+static void clk_batch_queue(uint32_t mrq, uint32_t cmd, uint32_t id,
+							uint32_t arg, uint32_t delay_us)
+{
+	struct clk_batch_op *op;
+
+	/* Nothing to send, same as the unbatched callers, and so nothing to
+	 * settle either */
+	if ((id == MODULE_NOT_SUPPORTED) ||
+		((cmd == CMD_CLK_SET_PARENT) && (arg == TEGRA186_CLK_CLK_MAX)) ||
+		((cmd == CMD_CLK_SET_RATE) && (arg == 0U))) {
+		return;
+	}
+
+	clk_batch.requested++;
+
+	/* A failure here is latched and reported by clk_batch_end() */
+	if (clk_batch.num_ops == CLK_BATCH_MAX_OPS) {
+		(void)clk_batch_flush();
+		clk_batch.num_ops = 0;
+		clk_batch.num_issued = 0;
+	}
+
+	op = &clk_batch.ops[clk_batch.num_ops++];
+	op->mrq = mrq;
+	op->cmd = cmd;
+	op->id = id;
+	op->arg = arg;
+	op->delay_us = delay_us;
+	op->rate_khz = 0;
+	op->settle_us = 0;
+	op->err = TEGRABL_NO_ERROR;
+}
+
+static bool clk_batch_is_enabled(uint32_t clk_id)
+{
+	clk_batch.requested++;
+	return internal_tegrabl_car_clk_is_enabled(clk_id);
+}
+
+static uint32_t clk_batch_settle_time(uint32_t clk_id)
+{
+	struct clk_batch_op *op;
+	uint32_t settle_us = 0;
+	uint32_t i;
+
+	for (i = 0; i < clk_batch.num_issued; i++) {
+		op = &clk_batch.ops[i];
+		if ((op->mrq == MRQ_CLK) && (op->id == clk_id)) {
+			settle_us += op->settle_us;
+		}
+	}
+
+	return settle_us;
+}
+
+static tegrabl_error_t clk_batch_get_rate(uint32_t clk_id, uint32_t *rate_khz)
+{
+	clk_batch.requested++;
+	return internal_tegrabl_car_get_clk_rate(clk_id, rate_khz);
+}
+
+static tegrabl_error_t clk_batch_end(void)
+{
+	uint32_t round_trips;
+	uint32_t saved = 0;
+
+	(void)clk_batch_flush();
+
+	round_trips = clk_shadow_stats.round_trips - clk_batch.round_trips_base;
+	if (clk_batch.requested > round_trips) {
+		saved = clk_batch.requested - round_trips;
+	}
+	pr_info("%s: %u clk requests in %u bpmp round trips (%u saved)\n",
+			clk_batch.name, clk_batch.requested, round_trips, saved);
+	pr_info("%s: slowest request took %uus (id %u)\n", clk_batch.name,
+			clk_batch.max_settle_us, clk_batch.max_settle_id);
+	tegrabl_profiler_record(clk_batch.name, 0, DETAILED);
+	tegrabl_profiler_span_end(clk_batch.span, 0);
+
+	return clk_batch.err;
+}
+
+/**
+ * Clock-init sequencer
+ *
+ * Brings up the clocks of one controller from its clk_init_seq descriptor,
+ * strictly in table order: a controller's table lists each clock after the
+ * ones it depends on, so nothing is reordered or overlapped. The requests of
+ * each clock are issued through the batch, which checks completion of every
+ * request, and are followed by the clock's documented settle time, if any.
+ * The resets are released in table order once every clock is up.
+ */
+static tegrabl_error_t clk_init_run(const struct clk_init_seq *seq)
+{
+	const struct clk_init_desc *desc;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	tegrabl_error_t status;
+	uint32_t claimed;
+	time_t start;
+	uint32_t i;
+
+	/* Settle delays may run deferred tasks, none of them may start
+	 * another sequence on the same batch */
+	claimed = tegrabl_task_claim(TEGRABL_TASK_RES_CLK);
+
+	start = tegrabl_get_timestamp_us();
+	clk_batch_begin(seq->name);
+	for (i = 0; i < seq->num_clks; i++) {
+		desc = &seq->clks[i];
+		if ((desc->flags & CLK_INIT_NO_ENABLE) == 0U) {
+			clk_batch_queue(MRQ_CLK, CMD_CLK_ENABLE, desc->id, 0, 0);
+		}
+		clk_batch_queue(MRQ_CLK, CMD_CLK_SET_PARENT, desc->id,
+						desc->parent, 0);
+		clk_batch_queue(MRQ_CLK, CMD_CLK_SET_RATE, desc->id,
+						desc->rate_khz, 0);
+		status = clk_batch_flush();
+		if (err == TEGRABL_NO_ERROR) {
+			err = status;
+		}
+		if (desc->settle_us != 0U) {
+			tegrabl_udelay(desc->settle_us);
+		}
+	}
+
+	for (i = 0; i < seq->num_rsts; i++) {
+		clk_batch_queue(MRQ_RESET, CMD_RESET_DEASSERT, seq->rsts[i].id,
+						0, seq->rsts[i].settle_us);
+	}
+	status = clk_batch_flush();
+	if (err == TEGRABL_NO_ERROR) {
+		err = status;
+	}
+
+	pr_info("%s: %u clocks, %u resets in %uus\n", seq->name, seq->num_clks,
+			seq->num_rsts, (uint32_t)(tegrabl_get_timestamp_us() - start));
+	status = clk_batch_end();
+	if (err == TEGRABL_NO_ERROR) {
+		err = status;
+	}
+	tegrabl_task_release(claimed);
+
+	return err;
+}
+
 /**
  * ------------------------NOTES------------------------
  * Please read below before using these APIs.
@@ -953,6 +1504,7 @@ tegrabl_clk_src_id_t tegrabl_car_get_clk_src(
 {
 	struct mrq_clk_request req_clk_get_src;
 	struct mrq_clk_response resp_clk_get_src;
+	struct clk_shadow *shadow;
 	int32_t clk_id;
 
 	pr_debug("(%s,%d) %d, %d\n", __func__, __LINE__,
@@ -963,10 +1515,18 @@ tegrabl_clk_src_id_t tegrabl_car_get_clk_src(
 		return TEGRABL_ERR_NOT_SUPPORTED;
 	}
 
+	shadow = clk_shadow_get((uint32_t)clk_id);
+	if ((shadow != NULL) &&
+		((shadow->flags & CLK_SHADOW_PARENT_VALID) != 0U)) {
+		clk_shadow_stats.hits++;
+		return src_clk_bpmp_to_tegrabl(shadow->parent);
+	}
+
 	req_clk_get_src.cmd_and_id = BPMP_CLK_CMD(CMD_CLK_GET_PARENT, clk_id);
 
 	/* TX */
-	if (TEGRABL_NO_ERROR != tegrabl_ccplex_bpmp_xfer(
+	clk_shadow_stats.round_trips++;
+	if (TEGRABL_NO_ERROR != tegrabl_bpmp_xfer(
 					&req_clk_get_src, &resp_clk_get_src,
 					sizeof(struct mrq_clk_request),
 					sizeof(struct mrq_clk_response),
@@ -979,6 +1539,12 @@ tegrabl_clk_src_id_t tegrabl_car_get_clk_src(
 	pr_debug("Received parent_id (from BPMP): %d\n",
 			 resp_clk_get_src.clk_get_parent.parent_id);
 
+	if ((shadow != NULL) &&
+		(resp_clk_get_src.clk_get_parent.parent_id < TEGRA186_CLK_CLK_MAX)) {
+		shadow->parent = (uint16_t)resp_clk_get_src.clk_get_parent.parent_id;
+		shadow->flags |= CLK_SHADOW_PARENT_VALID;
+	}
+
 	return src_clk_bpmp_to_tegrabl(resp_clk_get_src.clk_get_parent.parent_id);
 }
 
@@ -1065,6 +1631,8 @@ tegrabl_error_t tegrabl_car_set_clk_src_rate(
 		uint32_t rate_khz,
 		uint32_t *rate_set_khz)
 {
+	uint32_t clk_id;
+
 	pr_debug("(%s,%d) %d\n", __func__, __LINE__, src_id);
 
 	if (src_id == TEGRABL_CLK_SRC_PLLC4_MUXED) {
@@ -1074,10 +1642,9 @@ tegrabl_error_t tegrabl_car_set_clk_src_rate(
 		return TEGRABL_NO_ERROR;
 	}
 
-	return internal_tegrabl_car_set_clk_rate(
-			src_clk_tegrabl_to_bpmp(src_id),
-			rate_khz,
-			rate_set_khz);
+	clk_id = src_clk_tegrabl_to_bpmp(src_id);
+
+	return internal_tegrabl_car_set_clk_rate(clk_id, rate_khz, rate_set_khz);
 }
 /**
  * @brief - Attempts to set the current clock rate of
@@ -1097,16 +1664,223 @@ tegrabl_error_t tegrabl_car_set_clk_rate(
 		uint32_t rate_khz,
 		uint32_t *rate_set_khz)
 {
+	tegrabl_error_t err;
+	uint32_t claimed;
+
 	pr_debug("(%s,%d) %d, %d, %d\n", __func__, __LINE__,
 			 module, instance, rate_khz);
 
+	claimed = tegrabl_task_claim(TEGRABL_TASK_RES_CLK);
+
 	/* TODO - Add a condition to check if already enabled */
 	tegrabl_car_clk_enable(module, instance, NULL);
 
-	return internal_tegrabl_car_set_clk_rate(
+	err = internal_tegrabl_car_set_clk_rate(
 			tegrabl_module_to_bpmp_id(module, instance, MOD_CLK),
 			rate_khz,
 			rate_set_khz);
+
+	tegrabl_task_release(claimed);
+
+	return err;
+}
+
+/* BPMP may round up; requests lowered by the overshoot before giving up */
+#define CLK_PLAN_ROUND_TRIES 4U
+
+/**
+ * @brief - Finds the request BPMP turns into the highest rate of clk_id,
+ * from its current parent, that does not exceed max_khz.
+ *
+ * @clk_id - BPMP clock id
+ * @max_khz - Upper bound of the clock rate
+ * @req_khz - Rate to pass to CMD_CLK_SET_RATE
+ * @rate_khz - Rate BPMP reports for that request, 0 if the parent is off
+ * @return - TEGRABL_NO_ERROR if success, error-reason otherwise.
+ */
+static tegrabl_error_t clk_round_rate_max(
+		uint32_t clk_id,
+		uint32_t max_khz,
+		uint32_t *req_khz,
+		uint32_t *rate_khz)
+{
+	uint32_t req = max_khz;
+	uint32_t over;
+	uint32_t i;
+	tegrabl_error_t err;
+
+	for (i = 0; i < CLK_PLAN_ROUND_TRIES; i++) {
+		err = internal_tegrabl_car_round_clk_rate(clk_id, req, rate_khz);
+		if (err != TEGRABL_NO_ERROR) {
+			return err;
+		}
+		if (*rate_khz <= max_khz) {
+			*req_khz = req;
+			return TEGRABL_NO_ERROR;
+		}
+		over = *rate_khz - max_khz;
+		if (over >= req) {
+			break;
+		}
+		req -= over;
+	}
+
+	return TEGRABL_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief - Runs clk_id at the highest rate BPMP can give it without
+ * exceeding max_khz and enables it. Rates are rounded by BPMP itself with
+ * CMD_CLK_ROUND_RATE, which only rounds against the current parent, so each
+ * candidate parent is selected in turn. A clock that is already running is
+ * not moved between parents during the search and keeps its parent.
+ *
+ * @clk_id - BPMP clock id
+ * @max_khz - Upper bound of the clock rate
+ * @rate_set_khz - Rate set
+ * @return - TEGRABL_NO_ERROR if success, error-reason otherwise.
+ */
+static tegrabl_error_t clk_set_rate_max_locked(
+		uint32_t clk_id,
+		uint32_t max_khz,
+		uint32_t *rate_set_khz)
+{
+	uint32_t parents[MAX_PARENTS];
+	uint32_t src_khz[MAX_PARENTS];
+	uint32_t num_parents;
+	uint32_t curr_parent;
+	uint32_t best_parent = TEGRA186_CLK_CLK_MAX;
+	uint32_t best_req = 0;
+	uint32_t best_khz = 0;
+	uint32_t req_khz;
+	uint32_t rate_khz;
+	uint32_t i;
+	bool enabled;
+	tegrabl_error_t err;
+
+	err = internal_tegrabl_car_get_parents(clk_id, parents, &num_parents,
+										   &curr_parent);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
+	enabled = internal_tegrabl_car_clk_is_enabled(clk_id);
+
+	/* Read the parent rates before any switch drops the cached ones */
+	for (i = 0; i < num_parents; i++) {
+		if (internal_tegrabl_car_get_clk_rate(parents[i], &src_khz[i]) !=
+			TEGRABL_NO_ERROR) {
+			src_khz[i] = 0;
+		}
+	}
+
+	for (i = 0; i < num_parents; i++) {
+		/* Parents that are not running report 0 and are skipped */
+		if ((src_khz[i] == 0U) ||
+			(enabled && (parents[i] != curr_parent))) {
+			continue;
+		}
+
+		err = internal_tegrabl_car_set_clk_src(clk_id, parents[i]);
+		if (err != TEGRABL_NO_ERROR) {
+			return err;
+		}
+		if ((clk_round_rate_max(clk_id, max_khz, &req_khz, &rate_khz) !=
+			 TEGRABL_NO_ERROR) || (rate_khz == 0U)) {
+			continue;
+		}
+
+		/* On a tie stay on the current parent to avoid a switch */
+		if ((rate_khz > best_khz) ||
+			((rate_khz == best_khz) && (parents[i] == curr_parent))) {
+			best_parent = parents[i];
+			best_req = req_khz;
+			best_khz = rate_khz;
+		}
+	}
+
+	if (best_parent == TEGRA186_CLK_CLK_MAX) {
+		pr_error("%s: no parent of clk %u reaches %u kHz or less\n",
+				 __func__, clk_id, max_khz);
+		if (!enabled) {
+			(void)internal_tegrabl_car_set_clk_src(clk_id, curr_parent);
+		}
+		return TEGRABL_ERR_NOT_FOUND;
+	}
+
+	err = internal_tegrabl_car_set_clk_src(clk_id, best_parent);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
+
+	err = internal_tegrabl_car_clk_enable(clk_id);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
+
+	err = internal_tegrabl_car_set_clk_rate(clk_id, best_req, rate_set_khz);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
+
+	pr_debug("clk %u: parent %u, %u kHz (limit %u kHz)\n", clk_id,
+			 best_parent, *rate_set_khz, max_khz);
+
+	if (*rate_set_khz > max_khz) {
+		pr_error("%s: clk %u set to %u kHz, above %u kHz\n", __func__,
+				 clk_id, *rate_set_khz, max_khz);
+		return TEGRABL_ERR_INVALID;
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
+static tegrabl_error_t clk_set_rate_max(
+		uint32_t clk_id,
+		uint32_t max_khz,
+		uint32_t *rate_set_khz)
+{
+	tegrabl_error_t err;
+	uint32_t claimed;
+
+	/* The parent walk must not be interleaved with a deferred sequence */
+	claimed = tegrabl_task_claim(TEGRABL_TASK_RES_CLK);
+	err = clk_set_rate_max_locked(clk_id, max_khz, rate_set_khz);
+	tegrabl_task_release(claimed);
+
+	return err;
+}
+
+/**
+ * @brief - Runs the module clock at the highest rate it can reach without
+ * exceeding max_khz, switching to another parent if that gets closer and
+ * the clock is not running yet.
+ * NOTE: If the module clock is disabled when this function is called,
+ * it will also enable the clock.
+ *
+ * @module - Module ID of the module
+ * @instance - Instance of the module
+ * @max_khz - Upper bound of the module rate
+ * @rate_set_khz - Rate set
+ * @return - TEGRABL_NO_ERROR if success, error-reason otherwise.
+ */
+tegrabl_error_t tegrabl_car_set_clk_rate_max(
+		tegrabl_module_t module,
+		uint8_t instance,
+		uint32_t max_khz,
+		uint32_t *rate_set_khz)
+{
+	uint32_t clk_id;
+
+	pr_debug("(%s,%d) %d, %d, %d\n", __func__, __LINE__,
+			 module, instance, max_khz);
+
+	clk_id = tegrabl_module_to_bpmp_id(module, instance, MOD_CLK);
+	if ((clk_id == MODULE_NOT_SUPPORTED) || (rate_set_khz == NULL) ||
+		(max_khz == 0U)) {
+		return TEGRABL_ERR_NOT_SUPPORTED;
+	}
+
+	return clk_set_rate_max(clk_id, max_khz, rate_set_khz);
 }
 
 /**
@@ -1134,6 +1908,45 @@ tegrabl_error_t tegrabl_car_get_osc_freq_khz(uint32_t *freq_khz)
 			freq_khz);
 }
 
+/**
+ * @brief - PLLs are locked by BPMP, there is nothing to measure here
+ *
+ * @pll_id - PLL to query
+ * @stats - Unused
+ * @return - TEGRABL_ERR_NOT_SUPPORTED
+ */
+tegrabl_error_t tegrabl_car_get_pll_lock_stats(tegrabl_clk_pll_id_t pll_id,
+		struct tegrabl_pll_lock_stats *stats)
+{
+	TEGRABL_UNUSED(pll_id);
+	TEGRABL_UNUSED(stats);
+
+	return TEGRABL_ERR_NOT_SUPPORTED;
+}
+
+/**
+ * @brief - PLLs are locked by BPMP, there is nothing to measure here
+ *
+ * @pll_id - PLL to query
+ * @stats - Unused
+ * @return - TEGRABL_ERR_NOT_SUPPORTED
+ */
+tegrabl_error_t tegrabl_car_get_pll_freq_lock_stats(
+		tegrabl_clk_pll_id_t pll_id, struct tegrabl_pll_lock_stats *stats)
+{
+	TEGRABL_UNUSED(pll_id);
+	TEGRABL_UNUSED(stats);
+
+	return TEGRABL_ERR_NOT_SUPPORTED;
+}
+
+/**
+ * @brief - PLLs are locked by BPMP, there is nothing to print here
+ */
+void tegrabl_car_dump_pll_lock_stats(void)
+{
+}
+
 /**
  * @brief - Initializes the pll specified by pll_id.
  * Does nothing if pll already initialized
@@ -1205,6 +2018,7 @@ tegrabl_error_t tegrabl_car_clk_enable(tegrabl_module_t module,
 					void *priv_data)
 {
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	uint32_t claimed = 0;
 
 	/* Do QSPI specific init based on priv_data */
 	if ((module == TEGRABL_MODULE_QSPI) && (priv_data != NULL)) {
@@ -1212,6 +2026,7 @@ tegrabl_error_t tegrabl_car_clk_enable(tegrabl_module_t module,
 		struct qspi_clk_data *clk_data;
 
 		clk_data = (struct qspi_clk_data *)priv_data;
+		claimed = tegrabl_task_claim(TEGRABL_TASK_RES_CLK);
 
 		/* Map TEGRABL_CLK_SRC ids to bpmp-abi clk ids */
 		switch (clk_data->clk_src) {
@@ -1278,13 +2093,15 @@ tegrabl_error_t tegrabl_car_clk_enable(tegrabl_module_t module,
 			goto fail;
 		}
 
-#if defined(CONFIG_ENABLE_QSPI_QDDR_READ)
-		err = internal_tegrabl_car_clk_enable(TEGRA186_CLK_QSPI_OUT);
-		if (err != TEGRABL_NO_ERROR) {
-			goto fail;
+#if defined(CONFIG_ENABLE_QSPI)
+		if (qspi_qddr_read) {
+			err = internal_tegrabl_car_clk_enable(TEGRA186_CLK_QSPI_OUT);
+			if (err != TEGRABL_NO_ERROR) {
+				goto fail;
+			}
 		}
 #endif
-		return TEGRABL_NO_ERROR;
+		goto fail;
 	}
 
 	pr_debug("(%s,%d) %d, %d\n", __func__, __LINE__,
@@ -1294,6 +2111,7 @@ tegrabl_error_t tegrabl_car_clk_enable(tegrabl_module_t module,
 			tegrabl_module_to_bpmp_id(module, instance, MOD_CLK));
 
 fail:
+	tegrabl_task_release(claimed);
 	if (err != TEGRABL_NO_ERROR) {
 		err = TEGRABL_ERROR_HIGHEST_MODULE(err);
 	}
@@ -1301,6 +2119,33 @@ fail:
 	return err;
 }
 
+#if defined(CONFIG_ENABLE_QSPI)
+tegrabl_error_t tegrabl_car_set_qspi_qddr_read(bool enable)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	if (enable == qspi_qddr_read) {
+		return TEGRABL_NO_ERROR;
+	}
+	qspi_qddr_read = enable;
+
+	/* Otherwise applied on the next tegrabl_car_clk_enable() */
+	if (internal_tegrabl_car_clk_is_enabled(TEGRA186_CLK_QSPI)) {
+		if (enable) {
+			err = internal_tegrabl_car_clk_enable(TEGRA186_CLK_QSPI_OUT);
+		} else {
+			err = internal_tegrabl_car_clk_disable(TEGRA186_CLK_QSPI_OUT);
+		}
+	}
+
+	if (err != TEGRABL_NO_ERROR) {
+		err = TEGRABL_ERROR_HIGHEST_MODULE(err);
+	}
+
+	return err;
+}
+#endif
+
 /**
  * @brief  Disables clock for the module specified
  *
@@ -1454,45 +2299,74 @@ tegrabl_error_t tegrabl_init_utmipll(void)
 	return TEGRABL_NO_ERROR;
 }
 
+static const struct clk_init_seq usb_trk_seq = {
+	"usb tracking clocks", usb_clk_data, NUM_USB_TRK_CLKS, NULL, 0
+};
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+static bool usb_trk_clock_task_step(struct tegrabl_task *task)
+{
+	task->err = clk_init_run(&usb_trk_seq);
+
+	return true;
+}
+
+static struct tegrabl_task usb_trk_clock_task = {
+	.name = "usb tracking clocks",
+	.step = usb_trk_clock_task_step,
+	.resources = TEGRABL_TASK_RES_BPMP | TEGRABL_TASK_RES_CLK,
+	.step_us = 300U,
+};
+
+tegrabl_error_t tegrabl_usbf_tracking_clock_defer(void)
+{
+	return tegrabl_task_add(&usb_trk_clock_task);
+}
+#endif
+
 void tegrabl_usbf_program_tracking_clock(bool is_enable)
 {
-	uint32_t dummy;
 	int i;
 
-	for (i = 0; i < NUM_USB_TRK_CLKS; i++) {
-		if (is_enable == true) {
-			/* 1. Enable clks */
-			internal_tegrabl_car_clk_enable(usb_clk_data[i][NAME_INDEX]);
-			/* 2. set clk parents */
-			internal_tegrabl_car_set_clk_src(
-					usb_clk_data[i][NAME_INDEX],
-					usb_clk_data[i][USB_PARENT_INDEX]);
-			/* 3. Set clk rates */
-			internal_tegrabl_car_set_clk_rate(
-					usb_clk_data[i][NAME_INDEX],
-					usb_clk_data[i][USB_RATE_INDEX],
-				&dummy);
-		} else {
-			internal_tegrabl_car_clk_disable(usb_clk_data[i][NAME_INDEX]);
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+	if (tegrabl_task_pending(&usb_trk_clock_task)) {
+		tegrabl_task_wait(&usb_trk_clock_task);
+		if (is_enable) {
+			return;
 		}
 	}
+#endif
+
+	if (is_enable == false) {
+		for (i = 0; i < NUM_USB_TRK_CLKS; i++) {
+			internal_tegrabl_car_clk_disable(usb_clk_data[i].id);
+		}
+		return;
+	}
+
+	clk_init_run(&usb_trk_seq);
 	return;
 }
 
 tegrabl_error_t tegrabl_usbf_clock_init(void)
 {
-	uint32_t dummy;
+	static const struct clk_init_desc xusb_clk_data[] = {
+		{TEGRA186_CLK_XUSB_DEV, RATE_XUSB_DEV_KHZ, TEGRA186_CLK_PLLP_OUT0,
+			CLK_INIT_NO_ENABLE, 2},
+		{TEGRA186_CLK_XUSB_SS,  RATE_XUSB_SS_KHZ,  TEGRA186_CLK_CLK_MAX,
+			CLK_INIT_NO_ENABLE, 0},
+		{TEGRA186_CLK_XUSB_FS,  0,                 TEGRA186_CLK_PLL_U_48M,
+			CLK_INIT_NO_ENABLE, 0},
+	};
+	static const struct clk_init_seq xusb_seq = {
+		"xusb clocks", xusb_clk_data, ARRAY_SIZE(xusb_clk_data), NULL, 0
+	};
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
 
-	internal_tegrabl_car_set_clk_src(TEGRA186_CLK_XUSB_DEV,
-									 TEGRA186_CLK_PLLP_OUT0);
-	internal_tegrabl_car_set_clk_rate(TEGRA186_CLK_XUSB_DEV, RATE_XUSB_DEV_KHZ,
-									  &dummy);
-	tegrabl_udelay(2);
-	internal_tegrabl_car_set_clk_rate(TEGRA186_CLK_XUSB_SS, RATE_XUSB_SS_KHZ,
-									  &dummy);
-	internal_tegrabl_car_set_clk_src(TEGRA186_CLK_XUSB_FS,
-									 TEGRA186_CLK_PLL_U_48M);
+	err = clk_init_run(&xusb_seq);
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
 
 	/* Take XUSB - DEV, SS out of reset */
 	err = tegrabl_car_rst_clear(TEGRABL_MODULE_XUSB_DEV, 0);
@@ -1511,45 +2385,55 @@ fail:
 	return err;
 }
 
-static void tegrabl_ufs_program_clock(void)
+static tegrabl_error_t ufs_clock_enable(const struct clk_init_rst *rsts,
+									   uint32_t num_rsts)
+{
+	const struct clk_init_seq ufs_seq = {
+		"ufs clocks", ufs_clk_data, NUM_UFS_CLKS, rsts, num_rsts
+	};
+#if defined(CONFIG_ENABLE_UFS_HS_MODE)
+	uint32_t rate_khz;
+#endif
+	tegrabl_error_t err;
+
+	err = clk_init_run(&ufs_seq);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
+
+#if defined(CONFIG_ENABLE_UFS_HS_MODE)
+	/* Fastest UFSHC rate within the HS limit on the parent the sequence
+	 * picked; the clock runs now, so it is not moved to another one */
+	err = clk_set_rate_max(TEGRA186_CLK_UFSHC, UFSHC_HS_MAX_KHZ, &rate_khz);
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("ufshc: no rate up to %u kHz\n", UFSHC_HS_MAX_KHZ);
+		return err;
+	}
+	pr_info("ufshc: %u kHz\n", rate_khz);
+#endif
+
+	return TEGRABL_NO_ERROR;
+}
+
+static void ufs_clock_readback(void)
 {
-	uint32_t reg_data = 0;
 	uint32_t rate = 0;
 	uint32_t i;
 	bool enabled;
 
+	/* Read back, asking BPMP only for what it has not told */
 	for (i = 0; i < NUM_UFS_CLKS; i++) {
-		/* 1. Enable clks */
-		internal_tegrabl_car_clk_enable(ufs_clk_data[i][NAME_INDEX]);
-		tegrabl_udelay(200);
-		/* 2. set clk parents */
-		if (ufs_clk_data[i][UFS_PARENT_INDEX] != TEGRA186_CLK_CLK_MAX) {
-			internal_tegrabl_car_set_clk_src(
-					ufs_clk_data[i][NAME_INDEX],
-					ufs_clk_data[i][UFS_PARENT_INDEX]);
-		}
-		tegrabl_udelay(200);
-		/* 3. Set clk rates */
-		if (ufs_clk_data[i][UFS_RATE_INDEX] != 0) {
-			internal_tegrabl_car_set_clk_rate(
-					ufs_clk_data[i][NAME_INDEX],
-					ufs_clk_data[i][UFS_RATE_INDEX],
-				&rate);
-		}
-		tegrabl_udelay(200);
-	}
-
-	for (i = 0; i < NUM_UFS_CLKS; i++) {
-		enabled =
-			internal_tegrabl_car_clk_is_enabled(ufs_clk_data[i][NAME_INDEX]);
-		internal_tegrabl_car_get_clk_rate(ufs_clk_data[i][NAME_INDEX], &rate);
-		pr_info("index=%d enabled=%d rate=%u\n", i, enabled, rate);
+		enabled = clk_batch_is_enabled(ufs_clk_data[i].id);
+		clk_batch_get_rate(ufs_clk_data[i].id, &rate);
+		pr_info("index=%d enabled=%d rate=%u settle=%uus\n", i, enabled, rate,
+				clk_batch_settle_time(ufs_clk_data[i].id));
 	}
+}
 
-	for (i = 0; i < NUM_UFS_RSTS; i++) {
-		internal_tegrabl_car_rst(ufs_rst_data[i], CMD_RESET_DEASSERT);
-		tegrabl_udelay(200);
-	}
+/* Once the clocks are up and the resets have settled */
+static void ufs_device_enable(void)
+{
+	uint32_t reg_data = 0;
 
 	/*  Set the following PMC register bits to ‘0’ to remove
 		isolation between UFSHC AO logic inputs coming from PSW domain */
@@ -1575,6 +2459,70 @@ static void tegrabl_ufs_program_clock(void)
 	return;
 }
 
+static tegrabl_error_t tegrabl_ufs_program_clock(void)
+{
+	tegrabl_error_t err;
+
+	err = ufs_clock_enable(ufs_rst_data, NUM_UFS_RSTS);
+	ufs_clock_readback();
+	ufs_device_enable();
+
+	return err;
+}
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+/*
+ * State 0 brings up the clocks, states 1 to NUM_UFS_RSTS each release one
+ * reset and sleep its settle time if it has one, so the wait is not spent
+ * in line.
+ * Like the in-line sequence, a failure is recorded and the rest still done.
+ */
+static bool ufs_clock_task_step(struct tegrabl_task *task)
+{
+	const struct clk_init_rst *rst;
+	tegrabl_error_t err;
+
+	if (task->state == 0U) {
+		task->err = ufs_clock_enable(NULL, 0);
+		ufs_clock_readback();
+		task->state = 1;
+		return false;
+	}
+
+	if (task->state <= NUM_UFS_RSTS) {
+		rst = &ufs_rst_data[task->state - 1U];
+		err = internal_tegrabl_car_rst(rst->id, CMD_RESET_DEASSERT);
+		if ((err != TEGRABL_NO_ERROR) && (task->err == TEGRABL_NO_ERROR)) {
+			task->err = err;
+		}
+		if (rst->settle_us != 0U) {
+			tegrabl_task_sleep(task, rst->settle_us);
+		}
+		task->state++;
+		return false;
+	}
+
+	ufs_device_enable();
+
+	return true;
+}
+
+static struct tegrabl_task ufs_clock_task = {
+	.name = "ufs clocks",
+	.step = ufs_clock_task_step,
+	.resources = TEGRABL_TASK_RES_BPMP | TEGRABL_TASK_RES_CLK,
+	/* The clocks step is up to 54 BPMP round trips */
+	.step_us = 3000U,
+};
+
+tegrabl_error_t tegrabl_ufs_clock_init_defer(void)
+{
+	pr_info("Deferring ufs clocks\n");
+
+	return tegrabl_task_add(&ufs_clock_task);
+}
+#endif
+
 void tegrabl_ufs_clock_deinit(void)
 {
 	uint32_t i;
@@ -1582,7 +2530,7 @@ void tegrabl_ufs_clock_deinit(void)
 	pr_info("disabling ufs clocks\n");
 	for (i = NUM_UFS_CLKS - 1; i > 2; i--) {
 		/* 1. disable clks */
-		internal_tegrabl_car_clk_disable(ufs_clk_data[i][NAME_INDEX]);
+		internal_tegrabl_car_clk_disable(ufs_clk_data[i].id);
 	}
 
 }
@@ -1607,9 +2555,13 @@ void tegrabl_ufs_disable_device(void)
 
 tegrabl_error_t tegrabl_ufs_clock_init(void)
 {
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+	if (tegrabl_task_pending(&ufs_clock_task)) {
+		return tegrabl_task_wait(&ufs_clock_task);
+	}
+#endif
+
 	pr_info("Programming ufs clocks\n");
 	/* Configure clocks and de-assert relevant reset modules */
-	tegrabl_ufs_program_clock();
-
-	return TEGRABL_NO_ERROR;
+	return tegrabl_ufs_program_clock();
 }
@@ -242,6 +242,55 @@ tegrabl_error_t tegrabl_car_set_clk_rate(
 	return TEGRABL_NO_ERROR;
 }
 
+tegrabl_error_t tegrabl_car_set_clk_rate_max(
+		tegrabl_module_t module,
+		uint8_t instance,
+		uint32_t max_khz,
+		uint32_t *rate_set_khz)
+{
+	struct clk_info *pclk_info;
+	struct car_info *pcar_info;
+	struct module_car_info *pmodule_car_info;
+	struct clk_rate_plan plan;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	if (!module_support(module, instance) || (rate_set_khz == NULL)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 8);
+	}
+
+	/* Handle exceptions */
+	if (module == TEGRABL_MODULE_MEM) {
+		return TEGRABL_ERROR(TEGRABL_ERR_NOT_SUPPORTED, 15);
+	}
+
+	pmodule_car_info = &g_module_carinfo[module];
+	pcar_info = &pmodule_car_info->pcar_info[instance];
+	pclk_info = &pcar_info->clock_info;
+
+	err = plan_clk_rate(pclk_info, max_khz, &plan);
+	if (err != TEGRABL_NO_ERROR) {
+		CLOCK_DEBUG(module, instance, "no source reaches %u kHz or less\n",
+					max_khz);
+		return err;
+	}
+
+	/* If the clock is currently disabled, enable it */
+	if (pclk_info->clk_rate == 0) {
+		NV_CLK_RST_WRITE_OFFSET(pclk_info->clk_enb_set_reg, 0x1);
+	}
+
+	/* Program the planned divider as is; get_divider() would round to the
+	 * nearest rate, which may be above the limit */
+	update_clk_src_reg(module, instance, pclk_info, plan.div, plan.src_idx);
+
+	/* Update clock state and the actual rate set */
+	pclk_info->clk_src = plan.src;
+	pclk_info->clk_src_idx = plan.src_idx;
+	*rate_set_khz = pclk_info->clk_rate = plan.rate_khz;
+
+	return TEGRABL_NO_ERROR;
+}
+
 tegrabl_error_t tegrabl_car_get_clk_rate(
 		tegrabl_module_t module,
 		uint8_t instance,
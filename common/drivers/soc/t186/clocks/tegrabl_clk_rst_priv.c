@@ -127,6 +127,84 @@ uint32_t get_clk_rate_khz(
 	}
 }
 
+/* Smallest divider that keeps the output at or below max_rate */
+static uint32_t get_divider_floor(uint32_t src_rate, uint32_t max_rate,
+		tegrabl_clk_div_type_t divtype)
+{
+	if (src_rate <= max_rate) {
+		return 0;
+	}
+
+	if (divtype == TEGRABL_CLK_DIV_TYPE_FRACTIONAL) {
+		return DIV_CEIL(src_rate << 1, max_rate) - 2UL;
+	} else {
+		return DIV_CEIL(src_rate, max_rate) - 1UL;
+	}
+}
+
+tegrabl_error_t plan_clk_rate(
+		struct clk_info *pclk_info,
+		uint32_t max_khz,
+		struct clk_rate_plan *plan)
+{
+	tegrabl_clk_src_id_t src;
+	uint32_t src_rate_khz;
+	uint32_t div;
+	uint32_t rate_khz;
+	uint32_t i;
+	bool found = false;
+
+	if ((pclk_info == NULL) || (pclk_info->src_list == NULL) ||
+		(plan == NULL) || (max_khz == 0U)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 7);
+	}
+
+	for (i = 0; i <= MAX_SRC_ID; i++) {
+		src = pclk_info->src_list[i];
+
+		/* Without a switch only the current source is a candidate */
+		if (!pclk_info->allow_src_switch && (src != pclk_info->clk_src)) {
+			continue;
+		}
+
+		/* Same conditions tegrabl_car_set_clk_src() puts on a source */
+		if ((TEGRABL_CLK_CHECK_SRC_ID(src) == TEGRABL_CLK_SRC_INVALID) ||
+			!check_clk_src_enable(src)) {
+			continue;
+		}
+
+		if ((tegrabl_car_get_clk_src_rate(src, &src_rate_khz) !=
+			 TEGRABL_NO_ERROR) || (src_rate_khz == 0U)) {
+			continue;
+		}
+
+		/* Divisor shift is always 0, so the mask is the largest divider */
+		div = get_divider_floor(src_rate_khz, max_khz, pclk_info->div_type);
+		if (div > pclk_info->clk_div_mask) {
+			continue;
+		}
+
+		rate_khz = get_clk_rate_khz(src_rate_khz, div, pclk_info->div_type);
+
+		/* On a tie stay on the current source to avoid a mux switch */
+		if (!found || (rate_khz > plan->rate_khz) ||
+			((rate_khz == plan->rate_khz) &&
+			 (src == pclk_info->clk_src))) {
+			plan->src = src;
+			plan->src_idx = i;
+			plan->div = div;
+			plan->rate_khz = rate_khz;
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return TEGRABL_ERROR(TEGRABL_ERR_NOT_FOUND, 1);
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
 int get_src_idx(
 		tegrabl_clk_src_id_t *src_list,
 		tegrabl_clk_src_id_t clk_src)
@@ -306,6 +306,18 @@ struct clk_info {
 	bool allow_src_switch;
 };
 
+/* Result of plan_clk_rate() */
+struct clk_rate_plan {
+	/* Source giving the highest rate within the limit */
+	tegrabl_clk_src_id_t src;
+	/* Index of that source in the CLK_SOURCE register */
+	uint32_t src_idx;
+	/* Divider to program */
+	uint32_t div;
+	/* Rate the module runs at with src and div */
+	uint32_t rate_khz;
+};
+
 struct rst_info {
 	/* Addr of reset-set register */
 	uint32_t rst_set_reg;
@@ -374,6 +386,21 @@ tegrabl_error_t tegrabl_rst_set(tegrabl_module_t module,
 		uint8_t instance,
 		bool enable);
 
+/**
+ * @brief Picks the source and divider giving the highest module rate that
+ * does not exceed max_khz. Only running sources of the module's source list
+ * are considered, and only the current one if it cannot switch sources.
+ *
+ * @pclk_info - clock info of the module
+ * @max_khz - upper bound of the module rate
+ * @plan - filled with the chosen source, divider and resulting rate
+ * @return - TEGRABL_NO_ERROR if success, error-reason otherwise.
+ */
+tegrabl_error_t plan_clk_rate(
+		struct clk_info *pclk_info,
+		uint32_t max_khz,
+		struct clk_rate_plan *plan);
+
 int get_src_idx(
 		tegrabl_clk_src_id_t *src_list,
 		tegrabl_clk_src_id_t clk_src);
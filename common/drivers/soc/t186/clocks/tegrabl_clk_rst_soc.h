@@ -99,10 +99,31 @@ tegrabl_error_t tegrabl_enable_mem_clk(
  * @retval TEGRABL_NO_ERROR initialization if successful
  */
 tegrabl_error_t tegrabl_enable_qspi_clk(void *priv_data);
+
+/**
+ * @brief Selects QDDR or SDR reads for the QSPI clock at runtime,
+ * overriding CONFIG_ENABLE_QSPI_QDDR_READ. Takes effect immediately if
+ * the QSPI clock is running.
+ *
+ * @param enable true for QDDR reads
+ *
+ * @return TEGRABL_NO_ERROR if success, error-reason otherwise
+ */
+tegrabl_error_t tegrabl_car_set_qspi_qddr_read(bool enable);
 #endif
 
 tegrabl_error_t tegrabl_assert_mem_rst(bool assert);
 
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+/**
+ * @brief Queues enabling the usb tracking clocks as a deferred task;
+ * tegrabl_usbf_program_tracking_clock() completes it
+ *
+ * @return TEGRABL_NO_ERROR if queued
+ */
+tegrabl_error_t tegrabl_usbf_tracking_clock_defer(void);
+#endif
+
 tegrabl_error_t tegrabl_init_pllm(NvBootSdramParams *pdata);
 
 tegrabl_error_t tegrabl_init_pllc4(void);
@@ -130,4 +151,97 @@ tegrabl_error_t tegrabl_get_pll_freq_khz(
 
 bool check_clk_src_enable(tegrabl_clk_src_id_t clk_src);
 
+/**
+ * @brief Lock latencies of a PLL, measured from enable to lock
+ *
+ * @count - successful locks
+ * @failures - lock waits that timed out
+ * @last_us - latency of the latest lock
+ * @min_us - shortest latency
+ * @max_us - longest latency
+ * @total_us - sum of all latencies, for the average
+ */
+struct tegrabl_pll_lock_stats {
+	uint32_t count;
+	uint32_t failures;
+	uint32_t last_us;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t total_us;
+};
+
+/**
+ * @brief Returns the lock latencies recorded for a PLL started by CCPLEX
+ *
+ * @param pll_id PLL to query
+ * @param stats filled with the latencies collected since boot
+ *
+ * @return TEGRABL_NO_ERROR if success, TEGRABL_ERR_NOT_SUPPORTED where
+ *         PLLs are brought up by BPMP
+ */
+tegrabl_error_t tegrabl_car_get_pll_lock_stats(tegrabl_clk_pll_id_t pll_id,
+		struct tegrabl_pll_lock_stats *stats);
+
+/**
+ * @brief Returns the frequency lock latencies of a PLL that reaches
+ * frequency lock before phase lock; only PLLAON does. For PLLAON
+ * tegrabl_car_get_pll_lock_stats() reports the later phase lock.
+ *
+ * @param pll_id PLL to query
+ * @param stats filled with the latencies collected since boot
+ *
+ * @return TEGRABL_NO_ERROR if success, TEGRABL_ERR_NOT_SUPPORTED for other
+ *         PLLs and where PLLs are brought up by BPMP
+ */
+tegrabl_error_t tegrabl_car_get_pll_freq_lock_stats(
+		tegrabl_clk_pll_id_t pll_id, struct tegrabl_pll_lock_stats *stats);
+
+/**
+ * @brief Prints the lock latencies of every PLL which was started or
+ * failed to lock since boot. Does nothing where PLLs are brought up by BPMP.
+ */
+void tegrabl_car_dump_pll_lock_stats(void);
+
+/**
+ * @brief Runs a module clock at the highest rate it can reach without
+ * exceeding max_khz, picking among the parents the module may switch to.
+ * Storage controllers (SDMMC, UFSHC) pass their interface limit so they
+ * run at the fastest legal rate rather than at a fixed default. QSPI keeps
+ * the source and divisor from the BCT.
+ * Enables the clock if it is disabled. Behind BPMP the rates come from
+ * CMD_CLK_ROUND_RATE, and a clock that is already running keeps its parent.
+ *
+ * @param module Module ID of the module
+ * @param instance Instance of the module
+ * @param max_khz Upper bound of the module rate
+ * @param rate_set_khz Rate achieved
+ *
+ * @return TEGRABL_NO_ERROR if success, error-reason otherwise
+ */
+tegrabl_error_t tegrabl_car_set_clk_rate_max(
+		tegrabl_module_t module,
+		uint8_t instance,
+		uint32_t max_khz,
+		uint32_t *rate_set_khz);
+
+/**
+ * @brief Counters of the BPMP clock/reset state shadow
+ *
+ * @hits - requests answered without IPC
+ * @round_trips - requests sent to BPMP
+ * @invalidations - times cached state was dropped across all clocks
+ */
+struct tegrabl_clk_shadow_stats {
+	uint32_t hits;
+	uint32_t round_trips;
+	uint32_t invalidations;
+};
+
+/**
+ * @brief Returns the BPMP clock/reset shadow counters
+ *
+ * @param stats filled with the counters collected since boot
+ */
+void tegrabl_car_get_shadow_stats(struct tegrabl_clk_shadow_stats *stats);
+
 #endif /* INCLUDE_TEGRABL_CLK_RST_SOC_H */
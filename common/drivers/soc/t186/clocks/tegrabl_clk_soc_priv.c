@@ -73,11 +73,6 @@ extern struct module_car_info g_module_carinfo[TEGRABL_MODULE_NUM];
 		p = GET_DIVP(PLL_ID);								\
 	} while (0)
 
-#define CHECK_PLL_LOCK(PLLID, FIELD)								\
-	NV_DRF_VAL(CLK_RST_CONTROLLER, PLLID##_BASE,			\
-			FIELD##_LOCK,									\
-			NV_CLK_RST_READ_REG(PLLID##_BASE))
-
 #define ENABLE_PLL_LOCK(PLLID, MISC_REG)					\
 	do  { \
 		uint32_t val = NV_CLK_RST_READ_REG(MISC_REG);		\
@@ -87,8 +82,11 @@ extern struct module_car_info g_module_carinfo[TEGRABL_MODULE_NUM];
 	} while (0)
 
 #define WAIT_PLL_LOCK(PLLID, FIELD)								\
-	do {													\
-	} while (!CHECK_PLL_LOCK(PLLID, FIELD))
+	pll_wait_lock(TEGRABL_CLK_PLL_ID_##PLLID,				\
+			&pll_lock_stats[TEGRABL_CLK_PLL_ID_##PLLID],		\
+			CLK_RST_CONTROLLER_##PLLID##_BASE_0,			\
+			CLK_RST_CONTROLLER_##PLLID##_BASE_0_##FIELD##_LOCK_FIELD,	\
+			PLL_LOCK_TIMEOUT_US)
 
 #define DISABLE_IDDQ(PLLID, MISC_REG)						\
 	do {													\
@@ -136,9 +134,128 @@ extern struct module_car_info g_module_carinfo[TEGRABL_MODULE_NUM];
 #define AON_FRAC_STEP_TIMER_VAL 3
 #define AON_FRAC_STEP_VAL 0xFFF
 
-/* Max wait time for period for PLLAON lock.
+/* Max wait time for period for PLLAON lock (300 polls of 2us).
 	Value has taken from  bug 200049029 comment #84. */
-#define AON_PLL_LOCK_MAX_TIMEOUT 300
+#define AON_PLL_LOCK_MAX_TIMEOUT_US 600
+
+/* Give up on a PLL lock after this long; only hit when lock fails */
+#define PLL_LOCK_TIMEOUT_US 5000
+
+static struct tegrabl_pll_lock_stats pll_lock_stats[TEGRABL_CLK_PLL_ID_MAX];
+
+#if defined(CONFIG_ENABLE_CLOCK_PLLAON)
+/* PLLAON first waits for FREQ_LOCK and then for LOCK, kept apart */
+static struct tegrabl_pll_lock_stats pllaon_freq_lock_stats;
+#endif
+
+/* Polls until all bits of mask are set in the CAR register at offset, or
+ * timeout_us passed, and records in stats how long the PLL took to lock */
+static tegrabl_error_t pll_wait_lock(tegrabl_clk_pll_id_t pll_id,
+		struct tegrabl_pll_lock_stats *stats, uint32_t offset, uint32_t mask,
+		uint32_t timeout_us)
+{
+	time_t start = tegrabl_get_timestamp_us();
+	time_t now;
+	uint32_t latency_us;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	while (true) {
+		now = tegrabl_get_timestamp_us();
+		if ((NV_CLK_RST_READ_OFFSET(offset) & mask) == mask) {
+			break;
+		}
+		if ((now - start) >= timeout_us) {
+			err = TEGRABL_ERROR(TEGRABL_ERR_TIMEOUT, 0);
+			break;
+		}
+	}
+	latency_us = (uint32_t)(now - start);
+
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("PLL %u: no lock (mask 0x%x) after %u us\n", pll_id, mask,
+				 latency_us);
+		stats->failures++;
+		return err;
+	}
+
+	if ((stats->count == 0U) || (latency_us < stats->min_us)) {
+		stats->min_us = latency_us;
+	}
+	if (latency_us > stats->max_us) {
+		stats->max_us = latency_us;
+	}
+	stats->last_us = latency_us;
+	stats->total_us += latency_us;
+	stats->count++;
+	pr_debug("PLL %u locked in %u us\n", pll_id, latency_us);
+
+	return TEGRABL_NO_ERROR;
+}
+
+tegrabl_error_t tegrabl_car_get_pll_lock_stats(tegrabl_clk_pll_id_t pll_id,
+		struct tegrabl_pll_lock_stats *stats)
+{
+	if ((pll_id >= TEGRABL_CLK_PLL_ID_MAX) || (stats == NULL)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 9);
+	}
+
+	*stats = pll_lock_stats[pll_id];
+
+	return TEGRABL_NO_ERROR;
+}
+
+tegrabl_error_t tegrabl_car_get_pll_freq_lock_stats(
+		tegrabl_clk_pll_id_t pll_id, struct tegrabl_pll_lock_stats *stats)
+{
+	if (stats == NULL) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 10);
+	}
+
+#if defined(CONFIG_ENABLE_CLOCK_PLLAON)
+	if (pll_id == TEGRABL_CLK_PLL_ID_AON_PLL) {
+		*stats = pllaon_freq_lock_stats;
+		return TEGRABL_NO_ERROR;
+	}
+#else
+	(void)pll_id;
+#endif
+
+	return TEGRABL_ERROR(TEGRABL_ERR_NOT_SUPPORTED, 0);
+}
+
+static void pll_lock_stats_print(tegrabl_clk_pll_id_t pll_id, const char *kind,
+		const struct tegrabl_pll_lock_stats *stats)
+{
+	if ((stats->count == 0U) && (stats->failures == 0U)) {
+		return;
+	}
+
+	if (stats->count == 0U) {
+		pr_info("PLL %u %s: %u failed\n", pll_id, kind, stats->failures);
+		return;
+	}
+
+	pr_info("PLL %u %s: %u locks, %u failed, min/avg/max/last %u/%u/%u/%u us\n",
+			pll_id, kind, stats->count, stats->failures, stats->min_us,
+			stats->total_us / stats->count, stats->max_us, stats->last_us);
+}
+
+void tegrabl_car_dump_pll_lock_stats(void)
+{
+	struct tegrabl_pll_lock_stats stats;
+	uint32_t pll_id;
+
+	for (pll_id = 0; pll_id < TEGRABL_CLK_PLL_ID_MAX; pll_id++) {
+		if (tegrabl_car_get_pll_freq_lock_stats(pll_id, &stats) ==
+				TEGRABL_NO_ERROR) {
+			pll_lock_stats_print(pll_id, "freq lock", &stats);
+		}
+		if (tegrabl_car_get_pll_lock_stats(pll_id, &stats) ==
+				TEGRABL_NO_ERROR) {
+			pll_lock_stats_print(pll_id, "lock", &stats);
+		}
+	}
+}
 
 tegrabl_error_t tegrabl_get_pllref_khz(uint32_t *freq_khz)
 {
@@ -169,6 +286,8 @@ tegrabl_error_t tegrabl_enable_mem_clk(bool enable, void *priv_data)
 				if (err != TEGRABL_NO_ERROR) {
 					return err;
 				}
+				/* PLLM is the last PLL CCPLEX brings up */
+				tegrabl_car_dump_pll_lock_stats();
 			}
 		}
 #endif
@@ -224,6 +343,13 @@ tegrabl_error_t tegrabl_enable_mem_clk(bool enable, void *priv_data)
 }
 
 #if defined(CONFIG_ENABLE_QSPI)
+/* QSPI read mode; the build default until tegrabl_car_set_qspi_qddr_read() */
+#if defined(CONFIG_ENABLE_QSPI_QDDR_READ)
+static bool qspi_qddr_read = true;
+#else
+static bool qspi_qddr_read;
+#endif
+
 tegrabl_error_t tegrabl_enable_qspi_clk(void *priv_data)
 {
 	uint8_t instance = 0;
@@ -286,14 +412,25 @@ tegrabl_error_t tegrabl_enable_qspi_clk(void *priv_data)
 					   clk_data->clk_divisor, src_idx);
 
 	reg = NV_CLK_RST_READ_OFFSET(pclk_info->clk_src_reg);
-#if defined(CONFIG_ENABLE_QSPI_QDDR_READ)
 	/* configure clk for ddr mode */
-	reg |= NV_DRF_NUM(CLK_RST_CONTROLLER,
-			CLK_SOURCE_QSPI, QSPI_CLK_DIV2_SEL, 1);
-#else
-	reg |= NV_DRF_NUM(CLK_RST_CONTROLLER,
-			CLK_SOURCE_QSPI, QSPI_CLK_DIV2_SEL, 0);
-#endif
+	reg = NV_FLD_SET_DRF_NUM(CLK_RST_CONTROLLER, CLK_SOURCE_QSPI,
+			QSPI_CLK_DIV2_SEL, qspi_qddr_read ? 1 : 0, reg);
+	NV_CLK_RST_WRITE_OFFSET(pclk_info->clk_src_reg, reg);
+
+	return TEGRABL_NO_ERROR;
+}
+
+tegrabl_error_t tegrabl_car_set_qspi_qddr_read(bool enable)
+{
+	struct clk_info *pclk_info;
+	uint32_t reg;
+
+	qspi_qddr_read = enable;
+
+	pclk_info = &g_module_carinfo[TEGRABL_MODULE_QSPI].pcar_info[0].clock_info;
+	reg = NV_CLK_RST_READ_OFFSET(pclk_info->clk_src_reg);
+	reg = NV_FLD_SET_DRF_NUM(CLK_RST_CONTROLLER, CLK_SOURCE_QSPI,
+			QSPI_CLK_DIV2_SEL, enable ? 1 : 0, reg);
 	NV_CLK_RST_WRITE_OFFSET(pclk_info->clk_src_reg, reg);
 
 	return TEGRABL_NO_ERROR;
@@ -358,6 +495,7 @@ bool check_clk_src_enable(tegrabl_clk_src_id_t clk_src)
 tegrabl_error_t tegrabl_init_pllc4(void)
 {
 	uint32_t val = 0;
+	tegrabl_error_t err;
 
 	if (CHECK_PLL_ENABLE(PLLC4) != 0U) {
 		return TEGRABL_NO_ERROR;
@@ -411,7 +549,10 @@ tegrabl_error_t tegrabl_init_pllc4(void)
 
 	ENABLE_PLL_LOCK(PLLC4, PLLC4_MISC);
 	ENABLE_PLL(PLLC4);
-	WAIT_PLL_LOCK(PLLC4, PLLC4);
+	err = WAIT_PLL_LOCK(PLLC4, PLLC4);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
 
 	pr_debug("----PLLC4 ENABLED \n");
 	return TEGRABL_NO_ERROR;
@@ -430,21 +571,12 @@ static void pllaon_toggle_reset(void)
 	NV_CLK_RST_WRITE_REG(PLLAON_MISC_0, val);
 }
 
-static int32_t aon_pll_lock(uint32_t timeout, uint32_t mask)
+static tegrabl_error_t aon_pll_lock(struct tegrabl_pll_lock_stats *stats,
+									uint32_t mask)
 {
-	uint32_t val = NV_CLK_RST_READ_REG(PLLAON_BASE);
-	while (((val & mask) != mask) && timeout) {
-		tegrabl_udelay(2);
-		val = NV_CLK_RST_READ_REG(PLLAON_BASE);
-		timeout--;
-	}
-
-	if (timeout == 0U) {
-		pr_debug("AO-PLL locking failed, mask %x\n", mask);
-		return TEGRABL_ERR_LOCK_FAILED;
-	}
-
-	return TEGRABL_NO_ERROR;
+	return pll_wait_lock(TEGRABL_CLK_PLL_ID_AON_PLL, stats,
+						 CLK_RST_CONTROLLER_PLLAON_BASE_0, mask,
+						 AON_PLL_LOCK_MAX_TIMEOUT_US);
 }
 
 /* Note: Referenece to below sequence is from bug #200049029 comment #84
@@ -569,8 +701,8 @@ tegrabl_error_t tegrabl_init_pllaon(void)
 
 	/* Wait for PLL_FREQ lock */
 	val = NV_CLK_RST_READ_REG(PLLAON_BASE);
-	error = aon_pll_lock(AON_PLL_LOCK_MAX_TIMEOUT,
-					CLK_RST_CONTROLLER_PLLAON_BASE_0_PLLAON_FREQ_LOCK_FIELD);
+	error = aon_pll_lock(&pllaon_freq_lock_stats,
+				CLK_RST_CONTROLLER_PLLAON_BASE_0_PLLAON_FREQ_LOCK_FIELD);
 	if (error != TEGRABL_NO_ERROR) {
 		goto fail;
 	}
@@ -589,8 +721,8 @@ tegrabl_error_t tegrabl_init_pllaon(void)
 	NV_CLK_RST_WRITE_REG(PLLAON_MISC_3, val);
 
 	/* Wait for PLL lock */
-	error = aon_pll_lock(AON_PLL_LOCK_MAX_TIMEOUT,
-						 CLK_RST_CONTROLLER_PLLAON_BASE_0_PLLAON_LOCK_FIELD);
+	error = aon_pll_lock(&pll_lock_stats[TEGRABL_CLK_PLL_ID_AON_PLL],
+				CLK_RST_CONTROLLER_PLLAON_BASE_0_PLLAON_LOCK_FIELD);
 
 fail:
 	return error;
@@ -735,14 +867,16 @@ tegrabl_error_t tegrabl_init_plle(void)
 							 PLLE_ENABLE, ENABLE, reg);
 	NV_CLK_RST_WRITE_REG(PLLE_BASE, reg);
 
+	/* Lock detection is not reliable earlier, the poll and the recorded
+	 * latency start after this fixed wait */
 	tegrabl_udelay(500);
 
 	/* Poll to ensure PLLE is locked */
-	do {
-		reg = NV_CLK_RST_READ_REG(PLLE_MISC);
-	} while (!(reg & CLK_RST_CONTROLLER_PLLE_MISC_0_PLLE_LOCK_FIELD));
-
-	return TEGRABL_NO_ERROR;
+	return pll_wait_lock(TEGRABL_CLK_PLL_ID_PLLE,
+						 &pll_lock_stats[TEGRABL_CLK_PLL_ID_PLLE],
+						 CLK_RST_CONTROLLER_PLLE_MISC_0,
+						 CLK_RST_CONTROLLER_PLLE_MISC_0_PLLE_LOCK_FIELD,
+						 PLL_LOCK_TIMEOUT_US);
 }
 
 struct utmipll_clock_params {
@@ -800,7 +934,6 @@ static const struct usbpll_delay_params
 tegrabl_error_t tegrabl_init_utmipll(void)
 {
 	uint32_t reg_data;
-	uint32_t lock_time;
 	tegrabl_clk_osc_freq_t osc_freq = tegrabl_get_osc_freq();
 
 	/* Check if xusb boot brought up UTMI PLL */
@@ -894,17 +1027,12 @@ tegrabl_error_t tegrabl_init_utmipll(void)
 
 	/********* End Disabling all force power ups and power downs ********/
 
-	lock_time = 100; /* 100 us */
-	while (lock_time != 0U) {
-		reg_data = NV_CLK_RST_READ_REG(UTMIPLL_HW_PWRDN_CFG0);
-		if ((NV_DRF_VAL(CLK_RST_CONTROLLER, UTMIPLL_HW_PWRDN_CFG0,
-			UTMIPLL_LOCK, reg_data)) != 0U) {
-			break;
-		}
-
-		tegrabl_udelay(1);
-		lock_time--;
-	}
+	/* Bring-up continues even without lock, as it always has */
+	(void)pll_wait_lock(TEGRABL_CLK_PLL_ID_UTMI_PLL,
+				&pll_lock_stats[TEGRABL_CLK_PLL_ID_UTMI_PLL],
+				CLK_RST_CONTROLLER_UTMIPLL_HW_PWRDN_CFG0_0,
+				CLK_RST_CONTROLLER_UTMIPLL_HW_PWRDN_CFG0_0_UTMIPLL_LOCK_FIELD,
+				100);
 
 	/********** Remove power downs from UTMIP PLL Samplers bits ***********/
 
@@ -959,8 +1087,8 @@ tegrabl_error_t tegrabl_clk_start_pll(
 	uint32_t reg;
 	uint32_t pllm_kvco;
 	uint32_t pllm_kcp;
+	tegrabl_error_t err;
 
-	TEGRABL_UNUSED(stable_time);
 	TEGRABL_ASSERT(stable_time != NULL);
 
 	/* We can now handle each PLL explicitly by making each PLL its own case
@@ -989,7 +1117,7 @@ tegrabl_error_t tegrabl_clk_start_pll(
 		UPDATE_PLL_BASE(PLLM, DISABLE, ENABLE, m, n, p);
 		ENABLE_PLL(PLLM);
 
-		WAIT_PLL_LOCK(PLLM, PLLM);
+		err = WAIT_PLL_LOCK(PLLM, PLLM);
 		break;
 
 	case TEGRABL_CLK_PLL_ID_PLLMSB:
@@ -1012,13 +1140,17 @@ tegrabl_error_t tegrabl_clk_start_pll(
 		UPDATE_PLL_BASE(PLLMSB, DISABLE, ENABLE, m, n, p);
 		ENABLE_PLL(PLLMSB);
 
-		WAIT_PLL_LOCK(PLLMSB, PLLMSB);
+		err = WAIT_PLL_LOCK(PLLMSB, PLLMSB);
 		break;
 	default:
 		return TEGRABL_ERROR(TEGRABL_ERR_NOT_SUPPORTED, 0);
 	}
 
-	return TEGRABL_NO_ERROR;
+	if (err == TEGRABL_NO_ERROR) {
+		*stable_time = pll_lock_stats[pll_id].last_us;
+	}
+
+	return err;
 }
 
 tegrabl_error_t tegrabl_init_pllm(NvBootSdramParams *pdata)
@@ -1026,6 +1158,7 @@ tegrabl_error_t tegrabl_init_pllm(NvBootSdramParams *pdata)
 	uint32_t misc1;
 	uint32_t misc2;
 	uint64_t stable_time = 0;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
 
 	if (CHECK_PLL_ENABLE(PLLM) != 0U) {
 		return TEGRABL_NO_ERROR;
@@ -1050,13 +1183,17 @@ tegrabl_error_t tegrabl_init_pllm(NvBootSdramParams *pdata)
 		ENABLE_PLL_LOCK(PLLM, PLLM_MISC2);
 
 		/* Start PLLM for EMC/MC */
-		tegrabl_clk_start_pll(TEGRABL_CLK_PLL_ID_PLLM,
-							  pdata->PllMInputDivider,
-							  pdata->PllMFeedbackDivider,
-							  pdata->PllMPostDivider,
-							  misc1,
-							  misc2,
-							  &stable_time);
+		err = tegrabl_clk_start_pll(TEGRABL_CLK_PLL_ID_PLLM,
+									pdata->PllMInputDivider,
+									pdata->PllMFeedbackDivider,
+									pdata->PllMPostDivider,
+									misc1,
+									misc2,
+									&stable_time);
+		if (err != TEGRABL_NO_ERROR) {
+			pr_error("PLLM failed to start\n");
+			return err;
+		}
 	}
 
 	if (pdata->McEmemAdrCfgChannelEnable & 0xC) {
@@ -1066,13 +1203,17 @@ tegrabl_error_t tegrabl_init_pllm(NvBootSdramParams *pdata)
 		ENABLE_PLL_LOCK(PLLMSB, PLLMSB_MISC2);
 
 		/* Start PLLM for EMC/MC */
-		tegrabl_clk_start_pll(TEGRABL_CLK_PLL_ID_PLLMSB,
-							  pdata->PllMInputDivider,
-							  pdata->PllMFeedbackDivider,
-							  pdata->PllMPostDivider,
-							  misc1,
-							  misc2,
-							  &stable_time);
+		err = tegrabl_clk_start_pll(TEGRABL_CLK_PLL_ID_PLLMSB,
+									pdata->PllMInputDivider,
+									pdata->PllMFeedbackDivider,
+									pdata->PllMPostDivider,
+									misc1,
+									misc2,
+									&stable_time);
+		if (err != TEGRABL_NO_ERROR) {
+			pr_error("PLLMSB failed to start\n");
+			return err;
+		}
 	}
 
 	return TEGRABL_NO_ERROR;
@@ -21,4 +21,14 @@
 
 tegrabl_error_t tegrabl_ufs_clock_init(void);
 void tegrabl_ufs_disable_device(void);
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+/**
+ * @brief Queues the ufs clock bring-up as a deferred task, to be done
+ * during other delays; tegrabl_ufs_clock_init() completes it
+ *
+ * @return TEGRABL_NO_ERROR if queued
+ */
+tegrabl_error_t tegrabl_ufs_clock_init_defer(void);
+#endif
 #endif
@@ -14,29 +14,75 @@
 #include <tegrabl_error.h>
 #include <tegrabl_debug.h>
 #include <tegrabl_bpmp_fw_interface.h>
+#include <tegrabl_bpmp_trace.h>
+#include <tegrabl_task.h>
 #include <bpmp_abi.h>
 #include <powergate-t186.h>
 #include <tegrabl_i2c.h>
 
-void tegrabl_display_unpowergate(void)
+#define DISP_NUM_PARTITIONS \
+	(TEGRA186_POWER_DOMAIN_DISPC - TEGRA186_POWER_DOMAIN_DISP + 1U)
+
+static void display_unpowergate_partition(uint32_t i)
 {
 	struct mrq_pg_request disp_pg_request = {
 		.cmd = CMD_PG_SET_STATE,
-		.id = TEGRA186_POWER_DOMAIN_DISP,
+		.id = TEGRA186_POWER_DOMAIN_DISP + i,
 		.set_state = {
 			.state = PG_STATE_ON,
 		}
 	};
 
-	while (disp_pg_request.id <= TEGRA186_POWER_DOMAIN_DISPC) {
-		if (tegrabl_ccplex_bpmp_xfer(&disp_pg_request, NULL, sizeof(disp_pg_request),
-				0, MRQ_PG) != TEGRABL_NO_ERROR) {
-			pr_error("%s: Unable to power on - TEGRA186_POWER_DOMAIN_DISP%c\n",
-					 __func__, disp_pg_request.id - TEGRA186_POWER_DOMAIN_DISP == 0 ?
-					 ' ' : disp_pg_request.id - TEGRA186_POWER_DOMAIN_DISP + 'A');
-		}
+	if (tegrabl_bpmp_xfer(&disp_pg_request, NULL, sizeof(disp_pg_request),
+			0, MRQ_PG) != TEGRABL_NO_ERROR) {
+		pr_error("%s: Unable to power on - TEGRA186_POWER_DOMAIN_DISP%c\n",
+				 __func__, i == 0U ? ' ' : i + 'A');
+	}
+}
 
-		(disp_pg_request.id)++;
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+/* Powers on one partition per step, task->state is the next one */
+static bool display_unpowergate_step(struct tegrabl_task *task)
+{
+	display_unpowergate_partition(task->state);
+	task->state++;
+
+	if (task->state < DISP_NUM_PARTITIONS) {
+		return false;
+	}
+
+	pr_debug("%s: unpowergate done\n", __func__);
+
+	return true;
+}
+
+static struct tegrabl_task display_unpowergate_task = {
+	.name = "display unpowergate",
+	.step = display_unpowergate_step,
+	.resources = TEGRABL_TASK_RES_BPMP,
+	/* Partition power up is done by BPMP during the request */
+	.step_us = 500U,
+};
+
+tegrabl_error_t tegrabl_display_unpowergate_defer(void)
+{
+	return tegrabl_task_add(&display_unpowergate_task);
+}
+#endif
+
+void tegrabl_display_unpowergate(void)
+{
+	uint32_t i;
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+	if (tegrabl_task_pending(&display_unpowergate_task)) {
+		tegrabl_task_wait(&display_unpowergate_task);
+		return;
+	}
+#endif
+
+	for (i = 0; i < DISP_NUM_PARTITIONS; i++) {
+		display_unpowergate_partition(i);
 	}
 
 	pr_debug("%s: unpowergate done\n", __func__);
@@ -53,7 +99,7 @@ void tegrabl_display_powergate(void)
 	};
 
 	while (disp_pg_request.id <= TEGRA186_POWER_DOMAIN_DISPC) {
-		if (tegrabl_ccplex_bpmp_xfer(&disp_pg_request, NULL, sizeof(disp_pg_request),
+		if (tegrabl_bpmp_xfer(&disp_pg_request, NULL, sizeof(disp_pg_request),
 				0, MRQ_PG) != TEGRABL_NO_ERROR) {
 			pr_error("%s: Unable to power on - TEGRA194_POWER_DOMAIN_DISP%c\n",
 					 __func__, disp_pg_request.id - TEGRA186_POWER_DOMAIN_DISP == 0 ?
@@ -22,6 +22,16 @@
  */
 void tegrabl_display_unpowergate(void);
 
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+/**
+ *  @brief queue unpowergating the display partitions as a deferred task,
+ *  run during other delays; tegrabl_display_unpowergate() completes it
+ *
+ *  @return TEGRABL_NO_ERROR if queued, error code if fails.
+ */
+tegrabl_error_t tegrabl_display_unpowergate_defer(void);
+#endif
+
 /**
  *  @brief powergate display partitions
  */
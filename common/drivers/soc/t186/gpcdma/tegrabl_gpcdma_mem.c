@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_GPCDMA
+
+#include "build_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_module.h>
+#include <tegrabl_dmamap.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_dma.h>
+#include <tegrabl_malloc.h>
+#include <tegrabl_gpcdma_mem.h>
+
+#if defined(CONFIG_ENABLE_GPCDMA_MEM_BENCHMARK) && \
+	!defined(CONFIG_ENABLE_GPCDMA_MEM)
+#error "CONFIG_ENABLE_GPCDMA_MEM_BENCHMARK needs CONFIG_ENABLE_GPCDMA_MEM"
+#endif
+
+#if defined(CONFIG_ENABLE_GPCDMA_MEM)
+
+/*
+ * The GPCDMA driver behind tegrabl_dma.h is not part of this tree. This
+ * service needs from it DMA_MEM_TO_MEM, DMA_PATTERN_FILL with the .pattern
+ * transfer parameter, asynchronous transfers, tegrabl_dma_transfer_status()
+ * and tegrabl_dma_transfer_abort().
+ */
+
+/*
+ * Channels used by the IO drivers (QSPI, SPI, UART, ...) depend on the
+ * platform, so the board configuration names the first of the
+ * TEGRABL_GPCDMA_MEM_MAX_CHANNELS consecutive channels left to this service.
+ */
+#if !defined(CONFIG_GPCDMA_MEM_FIRST_CHANNEL)
+#error "CONFIG_ENABLE_GPCDMA_MEM needs CONFIG_GPCDMA_MEM_FIRST_CHANNEL"
+#endif
+#define GPCDMA_MEM_FIRST_CHANNEL	((uint32_t)CONFIG_GPCDMA_MEM_FIRST_CHANNEL)
+
+/* GPCDMA moves words, the CPU does the ends of unaligned regions */
+#define GPCDMA_MEM_ALIGN			4U
+/* Largest transfer the word count field takes */
+#define GPCDMA_MEM_MAX_XFER			0x3FFFFFFCU
+/* Stripes smaller than this do not pay for the extra channel setup */
+#define GPCDMA_MEM_MIN_STRIPE		(64U * 1024U)
+
+static tegrabl_dmadev_t gpcdma_mem_dev;
+
+static uint64_t gpcdma_mem_stripe(uint64_t left, uint32_t num_channels)
+{
+	uint64_t stripe;
+
+	stripe = (left + num_channels - 1U) / num_channels;
+	stripe = (stripe + GPCDMA_MEM_ALIGN - 1U) & ~(uint64_t)(GPCDMA_MEM_ALIGN - 1U);
+	if (stripe < GPCDMA_MEM_MIN_STRIPE) {
+		stripe = GPCDMA_MEM_MIN_STRIPE;
+	}
+	if (stripe > GPCDMA_MEM_MAX_XFER) {
+		stripe = GPCDMA_MEM_MAX_XFER;
+	}
+
+	return stripe;
+}
+
+#if defined(CONFIG_ENABLE_GPCDMA_MEM_BENCHMARK)
+#define GPCDMA_MEM_BENCHMARK_SIZE	(8U * 1024U * 1024U)
+
+/* Bytes per microsecond is MB/s */
+static uint32_t gpcdma_mem_mbps(size_t size, time_t us)
+{
+	return (us != 0U) ? (uint32_t)(size / us) : 0U;
+}
+
+/*
+ * Debug builds only: prints CPU and GPCDMA memset/memcpy throughput for 1,
+ * 2, 4 and 8 channels. Run once, when the service first brings up GPCDMA,
+ * on a scratch buffer of its own so that no boot data is touched.
+ */
+static void gpcdma_mem_benchmark(void)
+{
+	size_t size = GPCDMA_MEM_BENCHMARK_SIZE;
+	uint8_t *scratch;
+	uint8_t *dst;
+	uint8_t *src;
+	uint32_t num_channels;
+	time_t start;
+	time_t fill_us;
+	time_t copy_us;
+	tegrabl_error_t err;
+
+	scratch = tegrabl_alloc(TEGRABL_HEAP_DMA, size);
+	if (scratch == NULL) {
+		pr_warn("No scratch memory for the GPCDMA benchmark\n");
+		return;
+	}
+	dst = scratch;
+	src = dst + (size / 2U);
+
+	start = tegrabl_get_timestamp_us();
+	memset(scratch, 0, size);
+	fill_us = tegrabl_get_timestamp_us() - start;
+	start = tegrabl_get_timestamp_us();
+	memcpy(dst, src, size / 2U);
+	copy_us = tegrabl_get_timestamp_us() - start;
+	pr_info("gpcdma bench %u KB:   cpu fill %5u MB/s, copy %5u MB/s\n",
+			(uint32_t)(size / 1024U), gpcdma_mem_mbps(size, fill_us),
+			gpcdma_mem_mbps(size / 2U, copy_us));
+
+	for (num_channels = 1U; num_channels <= TEGRABL_GPCDMA_MEM_MAX_CHANNELS;
+		 num_channels *= 2U) {
+		start = tegrabl_get_timestamp_us();
+		err = tegrabl_gpcdma_memset(scratch, 0, size, num_channels);
+		fill_us = tegrabl_get_timestamp_us() - start;
+		if (err != TEGRABL_NO_ERROR) {
+			break;
+		}
+
+		start = tegrabl_get_timestamp_us();
+		err = tegrabl_gpcdma_memcpy(dst, src, size / 2U, num_channels);
+		copy_us = tegrabl_get_timestamp_us() - start;
+		if (err != TEGRABL_NO_ERROR) {
+			break;
+		}
+
+		pr_info("gpcdma bench %u KB: %u ch fill %5u MB/s, copy %5u MB/s\n",
+				(uint32_t)(size / 1024U), num_channels,
+				gpcdma_mem_mbps(size, fill_us),
+				gpcdma_mem_mbps(size / 2U, copy_us));
+	}
+
+	tegrabl_free(scratch);
+}
+#endif /* CONFIG_ENABLE_GPCDMA_MEM_BENCHMARK */
+
+/*
+ * Run a word aligned mem2mem or pattern fill transfer. Each round starts a
+ * stripe on every channel before waiting for any of them, so the channels
+ * compete only for memory bandwidth.
+ */
+static tegrabl_error_t gpcdma_mem_run(tegrabl_dmaio_t dir, uint64_t dst,
+									  uint64_t src, uint32_t pattern,
+									  uint64_t size, uint32_t num_channels)
+{
+	struct tegrabl_dma_xfer_params params[TEGRABL_GPCDMA_MEM_MAX_CHANNELS];
+	uint64_t offset = 0;
+	uint64_t stripe;
+	uint64_t chunk;
+	uint32_t busy;
+	uint32_t ch;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	tegrabl_error_t status;
+
+	if (gpcdma_mem_dev == NULL) {
+		gpcdma_mem_dev = tegrabl_dma_request(DMA_GPC);
+		if (gpcdma_mem_dev == NULL) {
+			return TEGRABL_ERROR(TEGRABL_ERR_NOT_SUPPORTED, 0);
+		}
+#if defined(CONFIG_ENABLE_GPCDMA_MEM_BENCHMARK)
+		gpcdma_mem_benchmark();
+#endif
+	}
+
+	while ((offset < size) && (err == TEGRABL_NO_ERROR)) {
+		stripe = gpcdma_mem_stripe(size - offset, num_channels);
+
+		for (busy = 0; (busy < num_channels) && (offset < size); busy++) {
+			chunk = ((size - offset) < stripe) ? (size - offset) : stripe;
+
+			memset(&params[busy], 0, sizeof(params[busy]));
+			params[busy].dst = (uintptr_t)(dst + offset);
+			params[busy].src = (dir == DMA_MEM_TO_MEM) ?
+				(uintptr_t)(src + offset) : 0U;
+			params[busy].pattern = pattern;
+			params[busy].size = (uint32_t)chunk;
+			params[busy].dir = dir;
+			params[busy].is_async_xfer = true;
+
+			err = tegrabl_dma_transfer(gpcdma_mem_dev,
+									   GPCDMA_MEM_FIRST_CHANNEL + busy,
+									   &params[busy]);
+			if (err != TEGRABL_NO_ERROR) {
+				break;
+			}
+			offset += chunk;
+		}
+
+		for (ch = 0; ch < busy; ch++) {
+			status = tegrabl_dma_transfer_status(gpcdma_mem_dev,
+												 GPCDMA_MEM_FIRST_CHANNEL + ch,
+												 &params[ch]);
+			if (status != TEGRABL_NO_ERROR) {
+				tegrabl_dma_transfer_abort(gpcdma_mem_dev,
+										   GPCDMA_MEM_FIRST_CHANNEL + ch);
+				if (err == TEGRABL_NO_ERROR) {
+					err = status;
+				}
+			}
+		}
+	}
+
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("gpcdma: mem transfer failed at 0x%llx, error 0x%x\n",
+				 (unsigned long long)(dst + offset), err);
+	}
+
+	return err;
+}
+
+static size_t gpcdma_mem_head(uintptr_t addr, size_t size)
+{
+	size_t head;
+
+	head = (GPCDMA_MEM_ALIGN - (addr & (GPCDMA_MEM_ALIGN - 1U))) &
+		(GPCDMA_MEM_ALIGN - 1U);
+
+	return (head < size) ? head : size;
+}
+
+tegrabl_error_t tegrabl_gpcdma_memcpy(void *dst, const void *src, size_t size,
+	uint32_t num_channels)
+{
+	uintptr_t d = (uintptr_t)dst;
+	uintptr_t s = (uintptr_t)src;
+	dma_addr_t dst_dma;
+	dma_addr_t src_dma;
+	size_t head;
+	size_t body;
+	tegrabl_error_t err;
+
+	if ((dst == NULL) || (src == NULL) || (num_channels == 0U) ||
+		(num_channels > TEGRABL_GPCDMA_MEM_MAX_CHANNELS)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 0);
+	}
+	/* Stripes run in parallel, so an overlap would read copied data */
+	if ((d < (s + size)) && (s < (d + size))) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 1);
+	}
+	if (((d ^ s) & (GPCDMA_MEM_ALIGN - 1U)) != 0U) {
+		return TEGRABL_ERROR(TEGRABL_ERR_NOT_SUPPORTED, 1);
+	}
+
+	head = gpcdma_mem_head(d, size);
+	body = (size - head) & ~(size_t)(GPCDMA_MEM_ALIGN - 1U);
+
+	memcpy(dst, src, head);
+	memcpy((void *)(d + head + body), (const void *)(s + head + body),
+		   size - head - body);
+	if (body == 0U) {
+		return TEGRABL_NO_ERROR;
+	}
+
+	src_dma = tegrabl_dma_map_buffer(TEGRABL_MODULE_GPCDMA, 0,
+									 (void *)(s + head), body,
+									 TEGRABL_DMA_TO_DEVICE);
+	dst_dma = tegrabl_dma_map_buffer(TEGRABL_MODULE_GPCDMA, 0,
+									 (void *)(d + head), body,
+									 TEGRABL_DMA_FROM_DEVICE);
+
+	err = gpcdma_mem_run(DMA_MEM_TO_MEM, (uint64_t)dst_dma, (uint64_t)src_dma,
+						 0U, body, num_channels);
+
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_GPCDMA, 0, (void *)(s + head),
+							 body, TEGRABL_DMA_TO_DEVICE);
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_GPCDMA, 0, (void *)(d + head),
+							 body, TEGRABL_DMA_FROM_DEVICE);
+
+	return err;
+}
+
+tegrabl_error_t tegrabl_gpcdma_memset(void *dst, uint8_t val, size_t size,
+	uint32_t num_channels)
+{
+	uintptr_t d = (uintptr_t)dst;
+	dma_addr_t dst_dma;
+	size_t head;
+	size_t body;
+	tegrabl_error_t err;
+
+	if ((dst == NULL) || (num_channels == 0U) ||
+		(num_channels > TEGRABL_GPCDMA_MEM_MAX_CHANNELS)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 2);
+	}
+
+	head = gpcdma_mem_head(d, size);
+	body = (size - head) & ~(size_t)(GPCDMA_MEM_ALIGN - 1U);
+
+	memset(dst, val, head);
+	memset((void *)(d + head + body), val, size - head - body);
+	if (body == 0U) {
+		return TEGRABL_NO_ERROR;
+	}
+
+	dst_dma = tegrabl_dma_map_buffer(TEGRABL_MODULE_GPCDMA, 0,
+									 (void *)(d + head), body,
+									 TEGRABL_DMA_FROM_DEVICE);
+
+	err = gpcdma_mem_run(DMA_PATTERN_FILL, (uint64_t)dst_dma, 0U,
+						 (uint32_t)val * 0x01010101U, body, num_channels);
+
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_GPCDMA, 0, (void *)(d + head),
+							 body, TEGRABL_DMA_FROM_DEVICE);
+
+	return err;
+}
+
+#endif /* CONFIG_ENABLE_GPCDMA_MEM */
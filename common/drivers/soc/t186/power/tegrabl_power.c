@@ -22,8 +22,12 @@
 #include <armc.h>
 #include <tegrabl_drf.h>
 #include <tegrabl_timer.h>
+#include <tegrabl_poll.h>
 #include <tegrabl_power.h>
 
+/* Partition power up sequence is a few us */
+#define APE_POWER_GATE_TIMEOUT_US 1000U
+
 #define pmc_impl_writel(reg, value) \
 	NV_WRITE32(NV_ADDRESS_MAP_PMC_BASE + PMC_IMPL_##reg##_0, value)
 
@@ -64,10 +68,16 @@ static tegrabl_error_t tegrabl_powergate_ape(void)
 
 		/* Poll until START bit is DONE */
 		pr_debug("%s: Poll until START bit is DONE\n", __func__);
-		do {
-			val = pmc_impl_readl(PART_AUD_POWER_GATE_CONTROL);
-		} while (NV_DRF_VAL(PMC_IMPL, PART_AUD_POWER_GATE_CONTROL,
-				START, val) == 1);
+		err = tegrabl_poll_while(NV_ADDRESS_MAP_PMC_BASE +
+				PMC_IMPL_PART_AUD_POWER_GATE_CONTROL_0,
+				NV_DRF_NUM(PMC_IMPL, PART_AUD_POWER_GATE_CONTROL, START,
+					0xFFFFFFFFU),
+				NV_DRF_DEF(PMC_IMPL, PART_AUD_POWER_GATE_CONTROL, START,
+					PENDING),
+				tegrabl_get_timestamp_us() + APE_POWER_GATE_TIMEOUT_US);
+		if (err != TEGRABL_NO_ERROR) {
+			goto fail;
+		}
 	}
 
 	/* Read STATUS register, check if any mismatch */
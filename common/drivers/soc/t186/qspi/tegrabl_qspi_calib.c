@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_QSPI
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_malloc.h>
+#include <tegrabl_qspi_calib.h>
+
+/* rx trimmer step of the sweep */
+#define QSPI_CALIB_TAP_STEP		4U
+/* Consecutive passing steps needed to accept a clock setting */
+#define QSPI_CALIB_MIN_WINDOW	3U
+/* Reads at the chosen setting before it is trusted */
+#define QSPI_CALIB_VERIFY_READS	4U
+
+/* Pattern bytes read per check by tegrabl_qspi_calib_run() */
+#define QSPI_CALIB_PATTERN_SIZE	4096U
+
+/* Cache word: [31:28] signature, [24] ddr, [23:16] bct_id,
+ * [15:8] rx_trim, [7:0] clk_divisor. tx_trim is not swept, so it is
+ * taken from the BCT timing on load. */
+#define QSPI_CALIB_CACHE_SIG		0xAUL
+#define QSPI_CALIB_CACHE_SIG_SHIFT	28
+#define QSPI_CALIB_CACHE_DDR		(1UL << 24)
+
+/* Registered by the QSPI driver, consumed by tegrabl_qspi_calib_run() */
+static struct tegrabl_qspi_calib_params qspi_calib_params;
+static struct tegrabl_qspi_timing qspi_calib_safe;
+static bool qspi_calib_pending;
+
+static uint32_t qspi_calib_pack(const struct tegrabl_qspi_calib_params *params,
+								const struct tegrabl_qspi_timing *timing)
+{
+	uint32_t cache;
+
+	cache = (QSPI_CALIB_CACHE_SIG << QSPI_CALIB_CACHE_SIG_SHIFT) |
+		((uint32_t)params->bct_id << 16) |
+		((uint32_t)timing->rx_trim << 8) |
+		(uint32_t)timing->clk_divisor;
+	if (timing->ddr) {
+		cache |= QSPI_CALIB_CACHE_DDR;
+	}
+
+	return cache;
+}
+
+static bool qspi_calib_load(const struct tegrabl_qspi_calib_params *params,
+							const struct tegrabl_qspi_timing *safe,
+							struct tegrabl_qspi_timing *timing)
+{
+	uint32_t cache;
+
+	if ((params->load == NULL) ||
+		(params->load(&cache, params->priv) != TEGRABL_NO_ERROR)) {
+		return false;
+	}
+
+	if ((cache >> QSPI_CALIB_CACHE_SIG_SHIFT) != QSPI_CALIB_CACHE_SIG) {
+		return false;
+	}
+
+	/* A result from another BCT is not reused */
+	if (((cache >> 16) & 0xFFU) != params->bct_id) {
+		return false;
+	}
+
+	timing->clk_divisor = (uint8_t)(cache & 0xFFU);
+	timing->rx_trim = (uint8_t)((cache >> 8) & 0xFFU);
+	timing->tx_trim = safe->tx_trim;
+	timing->ddr = ((cache & QSPI_CALIB_CACHE_DDR) != 0U);
+
+	/* Nor one outside the current limits */
+	return (timing->clk_divisor >= params->min_divisor) &&
+		(timing->clk_divisor <= safe->clk_divisor) &&
+		(timing->rx_trim <= TEGRABL_QSPI_CALIB_MAX_RX_TAP);
+}
+
+static tegrabl_error_t qspi_calib_check(
+		const struct tegrabl_qspi_calib_params *params,
+		const struct tegrabl_qspi_timing *timing,
+		const uint8_t *golden, uint8_t *test, uint32_t size, uint32_t reads)
+{
+	tegrabl_error_t err;
+	uint32_t i;
+
+	err = params->apply(timing, params->priv);
+	if (err != TEGRABL_NO_ERROR) {
+		return err;
+	}
+
+	for (i = 0; i < reads; i++) {
+		memset(test, 0, size);
+		err = params->read_pattern(test, size, params->priv);
+		if ((err != TEGRABL_NO_ERROR) || (memcmp(golden, test, size) != 0)) {
+			return TEGRABL_ERROR(TEGRABL_ERR_VERIFY_FAILED, 0);
+		}
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
+static tegrabl_error_t qspi_calib_sweep(
+		const struct tegrabl_qspi_calib_params *params,
+		struct tegrabl_qspi_timing *timing,
+		const uint8_t *golden, uint8_t *test, uint32_t size)
+{
+	tegrabl_error_t err;
+	uint32_t tap;
+	uint32_t run = 0;
+	uint32_t best_run = 0;
+	uint32_t best_end = 0;
+
+	for (tap = 0; tap <= TEGRABL_QSPI_CALIB_MAX_RX_TAP;
+		 tap += QSPI_CALIB_TAP_STEP) {
+		timing->rx_trim = (uint8_t)tap;
+		err = qspi_calib_check(params, timing, golden, test, size, 1);
+		if (err == TEGRABL_NO_ERROR) {
+			run++;
+			if (run > best_run) {
+				best_run = run;
+				best_end = tap;
+			}
+		} else if (TEGRABL_ERROR_REASON(err) == TEGRABL_ERR_VERIFY_FAILED) {
+			run = 0;
+		} else {
+			return err;
+		}
+	}
+
+	if (best_run < QSPI_CALIB_MIN_WINDOW) {
+		return TEGRABL_ERROR(TEGRABL_ERR_VERIFY_FAILED, 1);
+	}
+
+	/* Middle of the window leaves the most margin on both edges */
+	timing->rx_trim = (uint8_t)(best_end -
+								(((best_run - 1U) / 2U) * QSPI_CALIB_TAP_STEP));
+
+	return qspi_calib_check(params, timing, golden, test, size,
+							QSPI_CALIB_VERIFY_READS);
+}
+
+/* True if a reads faster than b; rate is 2 * src / (div + 2), doubled in
+ * QDDR */
+static bool qspi_calib_faster(const struct tegrabl_qspi_timing *a,
+							  const struct tegrabl_qspi_timing *b)
+{
+	uint32_t mult_a = a->ddr ? 2U : 1U;
+	uint32_t mult_b = b->ddr ? 2U : 1U;
+
+	return (mult_a * ((uint32_t)b->clk_divisor + 2U)) >
+		(mult_b * ((uint32_t)a->clk_divisor + 2U));
+}
+
+tegrabl_error_t tegrabl_qspi_calibrate(
+		const struct tegrabl_qspi_calib_params *params,
+		const struct tegrabl_qspi_timing *safe,
+		void *buf, uint32_t size,
+		struct tegrabl_qspi_timing *best)
+{
+	struct tegrabl_qspi_timing cand;
+	struct tegrabl_qspi_timing sdr;
+	struct tegrabl_qspi_timing ddr;
+	uint8_t *golden = buf;
+	uint8_t *test;
+	bool sdr_ok = true;
+	bool ddr_ok = true;
+	bool found = false;
+	time_t start;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	if ((params == NULL) || (params->apply == NULL) ||
+		(params->read_pattern == NULL) || (safe == NULL) ||
+		(buf == NULL) || (size == 0U) || (best == NULL) ||
+		(params->min_divisor > safe->clk_divisor)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 0);
+	}
+	test = golden + size;
+
+	start = tegrabl_get_timestamp_us();
+
+	/* Reference copy of the pattern, read with the known good timing */
+	err = params->apply(safe, params->priv);
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
+	err = params->read_pattern(golden, size, params->priv);
+	if (err != TEGRABL_NO_ERROR) {
+		goto fail;
+	}
+
+	if (qspi_calib_load(params, safe, &cand)) {
+		if (qspi_calib_check(params, &cand, golden, test, size,
+							 QSPI_CALIB_VERIFY_READS) == TEGRABL_NO_ERROR) {
+			*best = cand;
+			pr_info("QSPI: cached timing div %u%s rx trim %u\n",
+					cand.clk_divisor, cand.ddr ? " qddr" : "", cand.rx_trim);
+			return TEGRABL_NO_ERROR;
+		}
+		pr_warn("QSPI: cached timing failed, recalibrating\n");
+	}
+
+	/* Walk SDR and QDDR divisors together in decreasing throughput */
+	sdr = *safe;
+	sdr.ddr = false;
+	sdr.clk_divisor = params->min_divisor;
+	ddr = sdr;
+	ddr.ddr = true;
+
+	while (sdr_ok || ddr_ok) {
+		if (ddr_ok && (!sdr_ok || !qspi_calib_faster(&sdr, &ddr))) {
+			cand = ddr;
+			if (ddr.clk_divisor < safe->clk_divisor) {
+				ddr.clk_divisor++;
+			} else {
+				ddr_ok = false;
+			}
+		} else {
+			cand = sdr;
+			if (sdr.clk_divisor < safe->clk_divisor) {
+				sdr.clk_divisor++;
+			} else {
+				sdr_ok = false;
+			}
+		}
+
+		/* Nothing below this point beats the BCT setting */
+		if (!qspi_calib_faster(&cand, safe)) {
+			break;
+		}
+
+		err = qspi_calib_sweep(params, &cand, golden, test, size);
+		if (err == TEGRABL_NO_ERROR) {
+			found = true;
+			break;
+		}
+		if (TEGRABL_ERROR_REASON(err) != TEGRABL_ERR_VERIFY_FAILED) {
+			if (!cand.ddr) {
+				goto fail;
+			}
+			/* Flash or controller cannot do QDDR reads */
+			ddr_ok = false;
+		}
+		pr_debug("QSPI: div %u%s unstable\n", cand.clk_divisor,
+				 cand.ddr ? " qddr" : "");
+	}
+
+	if (!found) {
+		cand = *safe;
+		err = params->apply(&cand, params->priv);
+		if (err != TEGRABL_NO_ERROR) {
+			goto fail;
+		}
+	}
+	*best = cand;
+
+	/* The BCT timing is cached too, so the sweep is not repeated */
+	if ((params->store != NULL) &&
+		(params->store(qspi_calib_pack(params, &cand), params->priv) !=
+		 TEGRABL_NO_ERROR)) {
+		pr_warn("QSPI: could not cache calibration result\n");
+	}
+
+	pr_info("QSPI: timing div %u%s rx trim %u, calibrated in %u us\n",
+			cand.clk_divisor, cand.ddr ? " qddr" : "", cand.rx_trim,
+			(uint32_t)(tegrabl_get_timestamp_us() - start));
+
+	return TEGRABL_NO_ERROR;
+
+fail:
+	pr_error("QSPI: calibration failed, error %x\n", err);
+	(void)params->apply(safe, params->priv);
+	return err;
+}
+
+void tegrabl_qspi_calib_register(const struct tegrabl_qspi_calib_params *params,
+								 const struct tegrabl_qspi_timing *safe)
+{
+	if ((params == NULL) || (safe == NULL)) {
+		qspi_calib_pending = false;
+		return;
+	}
+
+	qspi_calib_params = *params;
+	qspi_calib_safe = *safe;
+	qspi_calib_pending = true;
+}
+
+tegrabl_error_t tegrabl_qspi_calib_run(void)
+{
+	struct tegrabl_qspi_timing best;
+	void *buf;
+	tegrabl_error_t err;
+
+	if (!qspi_calib_pending) {
+		return TEGRABL_NO_ERROR;
+	}
+	/* Once per registration, a failure leaves the BCT timing applied */
+	qspi_calib_pending = false;
+
+	buf = tegrabl_alloc(TEGRABL_HEAP_DMA, 2U * QSPI_CALIB_PATTERN_SIZE);
+	if (buf == NULL) {
+		pr_warn("QSPI: no memory for calibration, keeping BCT timing\n");
+		return TEGRABL_ERROR(TEGRABL_ERR_NO_MEMORY, 0);
+	}
+
+	err = tegrabl_qspi_calibrate(&qspi_calib_params, &qspi_calib_safe, buf,
+								 QSPI_CALIB_PATTERN_SIZE, &best);
+
+	tegrabl_free(buf);
+
+	return err;
+}
@@ -14,9 +14,12 @@ MODULE := $(LOCAL_DIR)
 
 GLOBAL_INCLUDES += \
 	$(LOCAL_DIR)/../../../../common/include \
-	$(LOCAL_DIR)/../../../../common/include/drivers
+	$(LOCAL_DIR)/../../../../common/include/drivers \
+	$(LOCAL_DIR)/../../../../common/include/lib
 
 MODULE_SRCS += \
-	$(LOCAL_DIR)/tegrabl_timer.c
+	$(LOCAL_DIR)/tegrabl_timer.c \
+	$(LOCAL_DIR)/tegrabl_arch_timer.c \
+	$(LOCAL_DIR)/tegrabl_poll.c
 
 include make/module.mk
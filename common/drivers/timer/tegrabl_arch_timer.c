@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_NO_MODULE
+
+#include "build_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_cpu_arch.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_arch_timer.h>
+#include <tegrabl_task.h>
+
+#if defined(CONFIG_ENABLE_ARCH_TIMER_UDELAY)
+
+#if !defined(__aarch64__)
+#error "CONFIG_ENABLE_ARCH_TIMER_UDELAY needs the ARMv8 generic timer"
+#endif
+
+/* Event stream fields, same in CNTKCTL_EL1 and CNTHCTL_EL2 */
+#define ARCH_TIMER_CTL_EVNTEN		(1UL << 2)
+#define ARCH_TIMER_CTL_EVNTDIR		(1UL << 3)
+#define ARCH_TIMER_CTL_EVNTI_SHIFT	4U
+#define ARCH_TIMER_CTL_EVNTI_MASK	(0xFUL << ARCH_TIMER_CTL_EVNTI_SHIFT)
+#define ARCH_TIMER_EVNTI_MAX		15U
+
+/* WFE wakes up on an event stream tick at least this often */
+#define ARCH_TIMER_EVENT_PERIOD_NS	1000U
+
+#define arch_timer_read_sysreg(reg, val) \
+	__asm__ volatile("mrs %0, " #reg : "=r" (val) : : "memory")
+
+#define arch_timer_write_sysreg(reg, val) \
+	__asm__ volatile("msr " #reg ", %0\n\tisb" : : "r" (val) : "memory")
+
+static uint64_t arch_timer_freq;
+/* Counter ticks between two event stream events */
+static uint64_t arch_timer_event_ticks;
+/* Event stream control as found, put back by tegrabl_arch_timer_stop() */
+static uint64_t arch_timer_saved_ctl;
+static bool arch_timer_at_el2;
+static bool arch_timer_stopped;
+
+static inline uint64_t arch_timer_ticks(void)
+{
+	uint64_t val;
+
+	/* isb keeps the read from being done ahead of the code before it */
+	__asm__ volatile("isb\n\tmrs %0, cntpct_el0" : "=r" (val) : : "memory");
+
+	return val;
+}
+
+static bool arch_timer_init(void)
+{
+	uint64_t current_el;
+	uint64_t target;
+	uint64_t ctl;
+	uint32_t evnti = 0;
+
+	if (arch_timer_freq != 0U) {
+		return true;
+	}
+	if (arch_timer_stopped) {
+		return false;
+	}
+
+	arch_timer_read_sysreg(cntfrq_el0, arch_timer_freq);
+	if (arch_timer_freq == 0U) {
+		return false;
+	}
+
+	/* An event is sent each time counter bit EVNTI goes from 0 to 1, i.e.
+	 * every 2^(EVNTI + 1) ticks; take the longest period within target */
+	target = (arch_timer_freq * ARCH_TIMER_EVENT_PERIOD_NS) / 1000000000U;
+	while ((evnti < ARCH_TIMER_EVNTI_MAX) && ((2ULL << (evnti + 1U)) <= target)) {
+		evnti++;
+	}
+	arch_timer_event_ticks = 2ULL << evnti;
+
+	/* EL2 gets its events from CNTPCT through CNTHCTL_EL2, EL1 from
+	 * CNTVCT through CNTKCTL_EL1 */
+	arch_timer_read_sysreg(CurrentEL, current_el);
+	arch_timer_at_el2 = (((current_el >> 2) & 0x3U) == 2U);
+	if (arch_timer_at_el2) {
+		arch_timer_read_sysreg(cnthctl_el2, ctl);
+	} else {
+		arch_timer_read_sysreg(cntkctl_el1, ctl);
+	}
+	arch_timer_saved_ctl = ctl;
+	ctl &= ~(ARCH_TIMER_CTL_EVNTI_MASK | ARCH_TIMER_CTL_EVNTDIR);
+	ctl |= ARCH_TIMER_CTL_EVNTEN | ((uint64_t)evnti << ARCH_TIMER_CTL_EVNTI_SHIFT);
+	if (arch_timer_at_el2) {
+		arch_timer_write_sysreg(cnthctl_el2, ctl);
+	} else {
+		arch_timer_write_sysreg(cntkctl_el1, ctl);
+	}
+
+	pr_debug("arch timer: %u Hz, event every %u ticks\n",
+			 (uint32_t)arch_timer_freq, (uint32_t)arch_timer_event_ticks);
+
+	return true;
+}
+
+void tegrabl_arch_timer_udelay(time_t usec)
+{
+	uint64_t start = arch_timer_ticks();
+	uint64_t ticks;
+	uint64_t elapsed;
+
+	if (!arch_timer_init()) {
+		tegrabl_tscus_udelay(usec);
+		return;
+	}
+
+	/* Round up, a delay must never be short */
+	ticks = (((uint64_t)usec * arch_timer_freq) + 999999U) / 1000000U;
+
+	elapsed = arch_timer_ticks() - start;
+	while (elapsed < ticks) {
+		/* Deferred work that fits in what is left of the delay */
+		tegrabl_task_yield(((ticks - elapsed) * 1000000U) / arch_timer_freq);
+		elapsed = arch_timer_ticks() - start;
+		/* The last event period is spun, so WFE never sleeps past the end */
+		if ((elapsed < ticks) && ((ticks - elapsed) > arch_timer_event_ticks)) {
+			__asm__ volatile("wfe" : : : "memory");
+		}
+		tegrabl_yield();
+		elapsed = arch_timer_ticks() - start;
+	}
+}
+
+void tegrabl_arch_timer_stop(void)
+{
+	arch_timer_stopped = true;
+	if (arch_timer_freq == 0U) {
+		return;
+	}
+
+	if (arch_timer_at_el2) {
+		arch_timer_write_sysreg(cnthctl_el2, arch_timer_saved_ctl);
+	} else {
+		arch_timer_write_sysreg(cntkctl_el1, arch_timer_saved_ctl);
+	}
+	arch_timer_freq = 0;
+
+	pr_debug("arch timer: event stream control restored\n");
+}
+
+#if defined(CONFIG_ENABLE_ARCH_TIMER_SELFTEST)
+#define SELFTEST_ITERATIONS		8U
+/* Window for checking CNTFRQ_EL0 against TSCUS */
+#define SELFTEST_FREQ_WINDOW_US	10000U
+/* Allowed CNTFRQ_EL0 error in 1/1000 */
+#define SELFTEST_FREQ_TOLERANCE	10U
+
+struct selftest_result {
+	uint32_t min_ns;
+	uint32_t max_ns;
+	uint64_t total_ns;
+	uint32_t num_short;
+};
+
+static const uint32_t selftest_delays_us[] = {
+	1, 2, 5, 10, 20, 50, 100, 500, 1000, 5000,
+};
+
+static void selftest_measure(void (*delay)(time_t), uint32_t usec,
+							 struct selftest_result *res)
+{
+	uint64_t start;
+	uint64_t ns;
+	uint32_t over;
+	uint32_t i;
+
+	res->min_ns = UINT32_MAX;
+	res->max_ns = 0;
+	res->total_ns = 0;
+	res->num_short = 0;
+
+	for (i = 0; i < SELFTEST_ITERATIONS; i++) {
+		start = arch_timer_ticks();
+		delay(usec);
+		ns = ((arch_timer_ticks() - start) * 1000000000U) / arch_timer_freq;
+
+		if (ns < ((uint64_t)usec * 1000U)) {
+			res->num_short++;
+			over = 0;
+		} else {
+			over = (uint32_t)(ns - ((uint64_t)usec * 1000U));
+		}
+		if (over < res->min_ns) {
+			res->min_ns = over;
+		}
+		if (over > res->max_ns) {
+			res->max_ns = over;
+		}
+		res->total_ns += over;
+	}
+}
+
+/* Count CNTPCT ticks over a TSCUS window to check CNTFRQ_EL0 */
+static bool selftest_check_freq(void)
+{
+	uint64_t start;
+	uint64_t measured;
+	uint64_t diff;
+	time_t t0;
+
+	t0 = tegrabl_get_timestamp_us();
+	while (tegrabl_get_timestamp_us() == t0) {
+	}
+	t0 = tegrabl_get_timestamp_us();
+	start = arch_timer_ticks();
+	while ((tegrabl_get_timestamp_us() - t0) < SELFTEST_FREQ_WINDOW_US) {
+	}
+	measured = ((arch_timer_ticks() - start) * 1000000U) /
+		SELFTEST_FREQ_WINDOW_US;
+
+	diff = (measured > arch_timer_freq) ? (measured - arch_timer_freq) :
+		(arch_timer_freq - measured);
+	pr_info("arch timer: CNTFRQ %u Hz, measured %u Hz\n",
+			(uint32_t)arch_timer_freq, (uint32_t)measured);
+
+	return (diff * 1000U) <= (arch_timer_freq * SELFTEST_FREQ_TOLERANCE);
+}
+
+tegrabl_error_t tegrabl_arch_timer_selftest(void)
+{
+	struct selftest_result arch;
+	struct selftest_result tscus;
+	uint32_t num_short = 0;
+	uint32_t i;
+	bool freq_ok;
+
+	if (!arch_timer_init()) {
+		pr_error("arch timer: CNTFRQ_EL0 is not set\n");
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+	}
+
+	freq_ok = selftest_check_freq();
+
+	pr_info("udelay overshoot in ns, min/avg/max of %u:\n",
+			SELFTEST_ITERATIONS);
+	for (i = 0; i < (sizeof(selftest_delays_us) / sizeof(selftest_delays_us[0]));
+		 i++) {
+		selftest_measure(tegrabl_arch_timer_udelay, selftest_delays_us[i],
+						 &arch);
+		selftest_measure(tegrabl_tscus_udelay, selftest_delays_us[i], &tscus);
+		num_short += arch.num_short;
+
+		pr_info("  %5u us: cntpct+wfe %6u/%6u/%6u  tscus %6u/%6u/%6u%s\n",
+				selftest_delays_us[i], arch.min_ns,
+				(uint32_t)(arch.total_ns / SELFTEST_ITERATIONS), arch.max_ns,
+				tscus.min_ns,
+				(uint32_t)(tscus.total_ns / SELFTEST_ITERATIONS), tscus.max_ns,
+				(arch.num_short != 0U) ? "  SHORT" : "");
+	}
+
+	if (!freq_ok || (num_short != 0U)) {
+		pr_error("arch timer: self-test failed, %u short delays%s\n",
+				 num_short, freq_ok ? "" : ", CNTFRQ_EL0 off");
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 1);
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+#endif /* CONFIG_ENABLE_ARCH_TIMER_SELFTEST */
+
+#endif /* CONFIG_ENABLE_ARCH_TIMER_UDELAY */
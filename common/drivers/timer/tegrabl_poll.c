@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_NO_MODULE
+
+#include "build_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_io.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_poll.h>
+#include <tegrabl_task.h>
+
+#if defined(CONFIG_ENABLE_POLL_STATS)
+/* Distinct call sites tracked; polls from further sites are only counted */
+#define POLL_MAX_SITES		48U
+
+struct poll_site {
+	uintptr_t pc;
+	uint32_t calls;
+	uint32_t timeouts;
+	uint32_t iterations;
+	uint32_t max_iterations;
+	uint32_t total_us;
+	uint32_t max_us;
+};
+
+static struct poll_site poll_sites[POLL_MAX_SITES];
+static uint32_t poll_num_sites;
+static uint32_t poll_untracked;
+
+static void poll_account(uintptr_t pc, uint32_t iterations, uint32_t us,
+						 bool timeout)
+{
+	struct poll_site *site = NULL;
+	uint32_t i;
+
+	for (i = 0; i < poll_num_sites; i++) {
+		if (poll_sites[i].pc == pc) {
+			site = &poll_sites[i];
+			break;
+		}
+	}
+	if (site == NULL) {
+		if (poll_num_sites == POLL_MAX_SITES) {
+			poll_untracked++;
+			return;
+		}
+		site = &poll_sites[poll_num_sites++];
+		site->pc = pc;
+	}
+
+	site->calls++;
+	site->iterations += iterations;
+	site->total_us += us;
+	if (iterations > site->max_iterations) {
+		site->max_iterations = iterations;
+	}
+	if (us > site->max_us) {
+		site->max_us = us;
+	}
+	if (timeout) {
+		site->timeouts++;
+	}
+}
+#endif
+
+static tegrabl_error_t poll_until(uintptr_t pc, uintptr_t reg, uint32_t mask,
+								  uint32_t value, bool equal, time_t deadline,
+								  time_t max_delay_us)
+{
+	time_t now = tegrabl_get_timestamp_us();
+	/* Elapsed time is compared, so a wrap of the 32 bit counter is harmless */
+	uint32_t start = (uint32_t)now;
+	uint32_t timeout_us = 0;
+	uint32_t elapsed = 0;
+	uint32_t iterations = 0;
+	time_t delay_us = 1;
+	bool done;
+
+	/* A deadline already passed gets a single look at the register */
+	if (deadline > now) {
+		timeout_us = ((deadline - now) > UINT32_MAX) ? UINT32_MAX :
+			(uint32_t)(deadline - now);
+	}
+
+	/* The hardware is in the middle of something, do not run
+	 * deferred tasks from the backoff delay */
+	tegrabl_task_no_yield_begin();
+	do {
+		done = (((NV_READ32(reg) & mask) == value) == equal);
+		iterations++;
+		if (done) {
+			break;
+		}
+		elapsed = (uint32_t)tegrabl_get_timestamp_us() - start;
+		if (elapsed >= timeout_us) {
+			/* Last look, the wait may have been cut short by preemption */
+			done = (((NV_READ32(reg) & mask) == value) == equal);
+			break;
+		}
+		if (max_delay_us != 0U) {
+			if (delay_us > (timeout_us - elapsed)) {
+				delay_us = timeout_us - elapsed;
+			}
+			tegrabl_udelay(delay_us);
+			if (delay_us < max_delay_us) {
+				delay_us *= 2U;
+			}
+			if (delay_us > max_delay_us) {
+				delay_us = max_delay_us;
+			}
+		}
+	} while (true);
+	tegrabl_task_no_yield_end();
+
+#if defined(CONFIG_ENABLE_POLL_STATS)
+	poll_account(pc, iterations,
+				 (uint32_t)tegrabl_get_timestamp_us() - start, !done);
+#else
+	(void)pc;
+	(void)iterations;
+#endif
+
+	if (!done) {
+		pr_error("poll of 0x%08lx (mask 0x%08x value 0x%08x) from %p timed "
+				 "out after %uus\n", (unsigned long)reg, mask, value,
+				 (void *)pc, elapsed);
+		return TEGRABL_ERROR(TEGRABL_ERR_TIMEOUT, 0);
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
+tegrabl_error_t tegrabl_poll_until(uintptr_t reg, uint32_t mask,
+	uint32_t value, time_t deadline)
+{
+	return poll_until((uintptr_t)__builtin_return_address(0), reg, mask,
+					  value, true, deadline, 0);
+}
+
+tegrabl_error_t tegrabl_poll_while(uintptr_t reg, uint32_t mask,
+	uint32_t value, time_t deadline)
+{
+	return poll_until((uintptr_t)__builtin_return_address(0), reg, mask,
+					  value, false, deadline, 0);
+}
+
+tegrabl_error_t tegrabl_poll_until_backoff(uintptr_t reg, uint32_t mask,
+	uint32_t value, time_t deadline, time_t max_delay_us)
+{
+	return poll_until((uintptr_t)__builtin_return_address(0), reg, mask,
+					  value, true, deadline, max_delay_us);
+}
+
+void tegrabl_poll_stats_dump(void)
+{
+#if defined(CONFIG_ENABLE_POLL_STATS)
+	struct poll_site tmp;
+	uint32_t total_us = 0;
+	uint32_t i;
+	uint32_t j;
+
+	/* Few sites, insertion sort by time spent */
+	for (i = 1; i < poll_num_sites; i++) {
+		tmp = poll_sites[i];
+		for (j = i; (j > 0U) && (poll_sites[j - 1U].total_us < tmp.total_us);
+			 j--) {
+			poll_sites[j] = poll_sites[j - 1U];
+		}
+		poll_sites[j] = tmp;
+	}
+
+	for (i = 0; i < poll_num_sites; i++) {
+		total_us += poll_sites[i].total_us;
+	}
+	pr_info("Register polls: %u sites, %u us\n", poll_num_sites, total_us);
+	pr_info("  site               calls  t/o    iters max_iters  total_us"
+			" max_us\n");
+	for (i = 0; i < poll_num_sites; i++) {
+		pr_info("  %p %6u %4u %8u %9u %9u %6u\n",
+				(void *)poll_sites[i].pc, poll_sites[i].calls,
+				poll_sites[i].timeouts, poll_sites[i].iterations,
+				poll_sites[i].max_iterations, poll_sites[i].total_us,
+				poll_sites[i].max_us);
+	}
+	if (poll_untracked != 0U) {
+		pr_info("  %u polls from other sites not tabled\n", poll_untracked);
+	}
+#endif
+}
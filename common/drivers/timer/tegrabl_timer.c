@@ -12,6 +12,8 @@
 #include <tegrabl_addressmap.h>
 #include <tegrabl_cpu_arch.h>
 #include <tegrabl_timer.h>
+#include <tegrabl_arch_timer.h>
+#include <tegrabl_task.h>
 #include <tegrabl_io.h>
 #include <stdbool.h>
 
@@ -32,7 +34,7 @@ time_t tegrabl_get_timestamp_ms(void)
 	return tegrabl_get_timestamp_us()/1000U;
 }
 
-void tegrabl_udelay(time_t usec)
+void tegrabl_tscus_udelay(time_t usec)
 {
 	uint32_t i = 0;
 	time_t t0;
@@ -51,6 +53,7 @@ void tegrabl_udelay(time_t usec)
 				tegrabl_nop();
 			}
 			tegrabl_yield();
+			tegrabl_task_yield(usec - ASMLOOP_DELAY_US - (t1 - t0));
 		}
 	}
 	t1 = tegrabl_get_timestamp_us();
@@ -61,6 +64,15 @@ void tegrabl_udelay(time_t usec)
 	}
 }
 
+void tegrabl_udelay(time_t usec)
+{
+#if defined(CONFIG_ENABLE_ARCH_TIMER_UDELAY)
+	tegrabl_arch_timer_udelay(usec);
+#else
+	tegrabl_tscus_udelay(usec);
+#endif
+}
+
 void tegrabl_mdelay(time_t msec)
 {
 	tegrabl_udelay(msec * 1000U);
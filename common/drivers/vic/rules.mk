@@ -18,6 +18,7 @@ GLOBAL_INCLUDES += \
 	$(LOCAL_DIR)../../include/drivers
 
 MODULE_SRCS += \
-			   $(LOCAL_DIR)/tegrabl_vic.c
+			   $(LOCAL_DIR)/tegrabl_vic.c \
+			   $(LOCAL_DIR)/tegrabl_vic_bulk.c
 
 include make/module.mk
@@ -8,8 +8,11 @@
  * license agreement from NVIDIA CORPORATION is strictly prohibited.
  */
 
+#include <string.h>
 #include <tegrabl_error.h>
 #include <tegrabl_debug.h>
+#include <tegrabl_module.h>
+#include <tegrabl_dmamap.h>
 #include <nvcommon.h>
 #include <vic/dev_vic_csb.h>
 #include <vic/vic_enums.h>
@@ -17,12 +20,45 @@
 #include <vic/vic_fce_ucode.h>
 #include <tegrabl_vic.h>
 #include <tegrabl_timer.h>
+#include <tegrabl_poll.h>
 #include <tegrabl_clock.h>
 #include <tegrabl_io.h>
+#if defined(CONFIG_ENABLE_GPCDMA_MEM)
+#include <tegrabl_gpcdma_mem.h>
+#endif
 
 #define CB_VIC_PRIV_WR(off, data)	\
 	NV_WRITE32((NV_ADDRESS_MAP_VIC_BASE + off), (data))
 
+static bool vic_initialized;
+static struct cb_vic_scrub_stats vic_scrub_stats;
+
+enum vic_job_state {
+	VIC_JOB_FREE = 0,
+	VIC_JOB_QUEUED,
+	VIC_JOB_DONE,
+};
+
+struct vic_job {
+	enum vic_job_state state;
+	uint32_t token;
+	bool detached;
+	uint64_t dst;
+	uint64_t src;
+	uint64_t size;
+	/* Bytes already handed to VIC */
+	uint64_t offset;
+	tegrabl_error_t err;
+};
+
+static struct vic_job vic_jobs[CB_VIC_QUEUE_DEPTH];
+static uint32_t vic_next_token = 1;
+/* Job whose chunk VIC is working on, NULL if VIC is idle */
+static struct vic_job *vic_busy_job;
+static uint32_t vic_busy_chunk;
+static time_t vic_busy_start;
+static time_t vic_busy_timeout;
+
 static void cb_vic_priv_write_extended(uint32_t adr, uint32_t data)
 {
 	/*
@@ -66,13 +102,13 @@ static void cb_vic_boot(void)
 	pr_debug("cb_vic_boot Successfull\n");
 }
 
-static tegrabl_error_t cb_vic_copy(uint64_t dst, uint64_t src, uint32_t size)
+/*
+ * Pixel geometry of a surface of size bytes, a VIC_SCRUB_GRANULE multiple
+ * below 1MB or a 1MB multiple from there on
+ */
+static void cb_vic_surface_geometry(uint32_t size,
+									struct cb_vic_surface *surface)
 {
-	uint32_t width;
-	uint32_t height;
-	uint32_t block_height;
-	uint32_t size_alignment;
-
 	/*
 	 * Size = (Width * Height)
 	 * Width = (n * 64B) and Height = (m * X) (Refer http://nvbugs/200223979)
@@ -86,9 +122,8 @@ static tegrabl_error_t cb_vic_copy(uint64_t dst, uint64_t src, uint32_t size)
 		 * So Height comes as 16K Bytes (m * X)
 		 * Width = Size / Height, Width must also be aligned to 16 Bytes
 		 */
-		height = VIC_SCRUB_HEIGHT1;
-		size_alignment = VIC_SIZE_ALIGN_MASK1;
-		block_height = VIC_BLOCK_HEIGHT1;
+		surface->height = VIC_SCRUB_HEIGHT1;
+		surface->block_height = VIC_BLOCK_HEIGHT1;
 	} else {
 		/*
 		 * X = 8 * 2 ^ _BLK_HEIGHT, with _BLK_HEIGHT as 0, we have X = 8 in this
@@ -96,21 +131,8 @@ static tegrabl_error_t cb_vic_copy(uint64_t dst, uint64_t src, uint32_t size)
 		 * So Height comes as 64 Bytes (m * X)
 		 * Width = Size / Height, Width must also be aligned to 16 Bytes
 		*/
-		height = VIC_SCRUB_HEIGHT2;
-		size_alignment = VIC_SIZE_ALIGN_MASK2;
-		block_height = VIC_BLOCK_HEIGHT2;
-	}
-
-	/*
-	 * Max size, Min Size and size alignment are restricted by Height, Width
-	 * requirements described above
-	*/
-	if ((size > VIC_SRUB_SIZE_MAX) || (size < VIC_SRUB_SIZE_MIN) ||
-		(size & size_alignment)) {
-		pr_error("%s Size %d not valid,Max = 0x%x,Min = 0x%x or not aligned ",
-				__func__, size, VIC_SRUB_SIZE_MAX, VIC_SRUB_SIZE_MIN);
-		pr_error("%d bytes\n", (size_alignment + 1));
-		return TEGRABL_ERR_BAD_PARAMETER;
+		surface->height = VIC_SCRUB_HEIGHT2;
+		surface->block_height = VIC_BLOCK_HEIGHT2;
 	}
 
 	/*
@@ -118,13 +140,16 @@ static tegrabl_error_t cb_vic_copy(uint64_t dst, uint64_t src, uint32_t size)
 	 * Width_in_pixels = (Size_in_Pixels) / (Height_in_Pixel_rows)
 	 * Size_in_pixels = (Size / CB_VIC_BYTES_PER_PIXEL)
 	*/
-	width  = ((size / CB_VIC_BYTES_PER_PIXEL) / height);
+	surface->size = size;
+	surface->width = (size / CB_VIC_BYTES_PER_PIXEL) / surface->height;
+}
 
-	if (width % 16) {
-		/* Width must also be aligned to 16 Pixels as Width = n * 16 Pixels */
-		pr_error("%s Width %d not aligned to 16 bytes\n", __func__, width);
-		return TEGRABL_ERR_BAD_ADDRESS;
-	}
+static void cb_vic_blit(uint64_t dst, uint64_t src,
+						const struct cb_vic_surface *surface)
+{
+	uint32_t width = surface->width;
+	uint32_t height = surface->height;
+	uint32_t block_height = surface->block_height;
 
 	CB_VIC_DBG("%s:Width = 0x%x, Height = 0x%x, Src = 0x%llx, Dst = 0x%llx\n",
 			   __func__, width, height, src, dst);
@@ -270,26 +295,59 @@ static tegrabl_error_t cb_vic_copy(uint64_t dst, uint64_t src, uint32_t size)
 	/* Init value of bl_config with trigger enabled */
 	cb_vic_priv_write_extended(NV_CVIC_BL_CONFIG, CB_CVIC_BL_CONFIG);
 	cb_vic_priv_write_extended(NV_CVIC_FC_COMPOSE, CB_CVIC_FC_COMPOSE);
+}
+
+static tegrabl_error_t cb_vic_copy(uint64_t dst, uint64_t src, uint32_t size)
+{
+	struct cb_vic_surface surface;
+	uint32_t size_alignment;
+
+	size_alignment = (size >= SIZE_1M) ? VIC_SIZE_ALIGN_MASK1 :
+		VIC_SIZE_ALIGN_MASK2;
+
+	/*
+	 * Max size, Min Size and size alignment are restricted by Height, Width
+	 * requirements described in cb_vic_surface_geometry()
+	*/
+	if ((size > VIC_SRUB_SIZE_MAX) || (size < VIC_SRUB_SIZE_MIN) ||
+		(size & size_alignment)) {
+		pr_error("%s Size %d not valid,Max = 0x%x,Min = 0x%x or not aligned ",
+				__func__, size, VIC_SRUB_SIZE_MAX, VIC_SRUB_SIZE_MIN);
+		pr_error("%d bytes\n", (size_alignment + 1));
+		return TEGRABL_ERR_BAD_PARAMETER;
+	}
+
+	cb_vic_surface_geometry(size, &surface);
+
+	if (surface.width % 16) {
+		/* Width must also be aligned to 16 Pixels as Width = n * 16 Pixels */
+		pr_error("%s Width %d not aligned to 16 bytes\n", __func__,
+				 surface.width);
+		return TEGRABL_ERR_BAD_ADDRESS;
+	}
+
+	cb_vic_blit(dst, src, &surface);
 
 	return TEGRABL_NO_ERROR;
 }
 
 static tegrabl_error_t cb_dram_ecc_vic_scrub_wait_for_complete(void)
 {
-	uint32_t timeout_count = 0;
+	tegrabl_error_t err;
 
 	/*
 	 * Incase of ASYNC transfer, while we come back for checking transfer
 	 * complete, it is possible that trasnfer is already complete, for which
-	 * we don't have to wait. So wait only based on transfer status
+	 * we don't have to wait. So wait only based on transfer status.
+	 * Short blits finish within a few us, so the delay between reads starts
+	 * small and grows to the old 50us step.
 	*/
-	while (NV_READ32(NV_ADDRESS_MAP_VIC_BASE + NV_PVIC_FALCON_IDLESTATE) != 0) {
-		tegrabl_udelay(50);
-		timeout_count++;
-		if (timeout_count >= VIC_POLL_DELAY_COUNT) {
-			return TEGRABL_ERR_TIMEOUT;
-		}
-	};
+	err = tegrabl_poll_until_backoff(
+			NV_ADDRESS_MAP_VIC_BASE + NV_PVIC_FALCON_IDLESTATE, 0xFFFFFFFFU, 0U,
+			tegrabl_get_timestamp_us() + (VIC_POLL_DELAY_COUNT * 50), 50);
+	if (err != TEGRABL_NO_ERROR) {
+		return TEGRABL_ERR_TIMEOUT;
+	}
 
 	return TEGRABL_NO_ERROR;
 }
@@ -317,6 +375,7 @@ tegrabl_error_t cb_vic_scrub(uint32_t instance, uint32_t cmd, void *p_buf)
 
 		if (err != TEGRABL_NO_ERROR)
 			goto fail;
+		vic_scrub_stats.bytes_scrubbed += p_vic_transfer_config->size;
 		break;
 	}
 	case CB_VIC_WAIT_FOR_TRANSFER_COMPLETE: {
@@ -342,6 +401,310 @@ fail:
 	return err;
 }
 
+void cb_vic_plan_surface(uint64_t dst, uint64_t src, uint64_t size,
+						 struct cb_vic_surface *surface)
+{
+	uint64_t bytes;
+	uint64_t room;
+
+	if ((((dst | src) & VIC_ADDR_ALIGN_MASK1) == 0) && (size >= SIZE_1M)) {
+		/* Both 1MB aligned: the largest 1MB multiple VIC takes */
+		bytes = size & ~(uint64_t)VIC_SIZE_ALIGN_MASK1;
+		if (bytes > VIC_SRUB_SIZE_MAX)
+			bytes = VIC_SRUB_SIZE_MAX;
+	} else {
+		/* Below 1MB, up to the nearer 1MB boundary of dst and src */
+		bytes = SIZE_1M - (dst & VIC_ADDR_ALIGN_MASK1);
+		room = SIZE_1M - (src & VIC_ADDR_ALIGN_MASK1);
+		if (room < bytes)
+			bytes = room;
+		if (bytes > size)
+			bytes = size;
+	}
+
+	cb_vic_surface_geometry((uint32_t)bytes, surface);
+}
+
+void cb_vic_plan_region(uint64_t base, uint64_t size, struct cb_vic_plan *plan)
+{
+	struct cb_vic_surface surface;
+	uint64_t head;
+	uint64_t offset;
+
+	head = (VIC_SCRUB_GRANULE - (base & (VIC_SCRUB_GRANULE - 1))) &
+		(VIC_SCRUB_GRANULE - 1);
+	if (head > size)
+		head = size;
+
+	plan->head_size = head;
+	plan->vic_base = base + head;
+	plan->vic_size = (size - head) & ~(uint64_t)(VIC_SCRUB_GRANULE - 1);
+	plan->tail_base = plan->vic_base + plan->vic_size;
+	plan->tail_size = size - head - plan->vic_size;
+
+	plan->num_surfaces = 0;
+	for (offset = 0; offset < plan->vic_size; offset += surface.size) {
+		cb_vic_plan_surface(plan->vic_base + offset, plan->vic_base + offset,
+							plan->vic_size - offset, &surface);
+		plan->num_surfaces++;
+	}
+}
+
+/* Zero a piece VIC cannot take and write it back to DRAM */
+static void cb_vic_cpu_scrub(uint64_t base, uint64_t size)
+{
+	if (size == 0)
+		return;
+
+	memset((void *)(uintptr_t)base, 0, size);
+	tegrabl_dma_map_buffer(TEGRABL_MODULE_VIC, 0, (void *)(uintptr_t)base,
+						   size, TEGRABL_DMA_TO_DEVICE);
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_VIC, 0, (void *)(uintptr_t)base,
+							 size, TEGRABL_DMA_TO_DEVICE);
+}
+
+tegrabl_error_t cb_vic_scrub_region(uint64_t base, uint64_t size)
+{
+	struct cb_vic_plan plan;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	uint32_t token;
+
+	cb_vic_plan_region(base, size, &plan);
+	CB_VIC_DBG("%s: 0x%llx+0x%llx in %u surfaces, cpu %llu+%llu bytes\n",
+			   __func__, base, size, plan.num_surfaces, plan.head_size,
+			   plan.tail_size);
+
+	/* Write back dirty lines first, so none lands on top of the zeroes */
+	if (plan.vic_size != 0) {
+		tegrabl_dma_map_buffer(TEGRABL_MODULE_VIC, 0,
+							   (void *)(uintptr_t)plan.vic_base, plan.vic_size,
+							   TEGRABL_DMA_FROM_DEVICE);
+		err = cb_vic_queue_submit(plan.vic_base, plan.vic_base, plan.vic_size,
+								  &token);
+	}
+
+	/* The CPU pieces are done while VIC works on the rest */
+	cb_vic_cpu_scrub(base, plan.head_size);
+	cb_vic_cpu_scrub(plan.tail_base, plan.tail_size);
+
+	if ((plan.vic_size != 0) && (err == TEGRABL_NO_ERROR))
+		err = cb_vic_queue_wait(token);
+
+#if defined(CONFIG_ENABLE_GPCDMA_MEM)
+	/* VIC powergated or hung: clear the body with GPCDMA instead */
+	if (err != TEGRABL_NO_ERROR) {
+		pr_warn("%s: VIC scrub failed (0x%x), using GPCDMA\n", __func__, err);
+		err = tegrabl_gpcdma_memset((void *)(uintptr_t)plan.vic_base, 0,
+									plan.vic_size,
+									TEGRABL_GPCDMA_MEM_DEFAULT_CHANNELS);
+	}
+#endif
+
+	/* Drop lines speculatively fetched while VIC was writing */
+	if (plan.vic_size != 0)
+		tegrabl_dma_unmap_buffer(TEGRABL_MODULE_VIC, 0,
+								 (void *)(uintptr_t)plan.vic_base,
+								 plan.vic_size, TEGRABL_DMA_FROM_DEVICE);
+
+	return err;
+}
+
+static struct vic_job *cb_vic_queue_find(uint32_t token)
+{
+	uint32_t i;
+
+	for (i = 0; i < CB_VIC_QUEUE_DEPTH; i++) {
+		if ((vic_jobs[i].state != VIC_JOB_FREE) &&
+			(vic_jobs[i].token == token))
+			return &vic_jobs[i];
+	}
+
+	return NULL;
+}
+
+static struct vic_job *cb_vic_queue_oldest(void)
+{
+	struct vic_job *oldest = NULL;
+	uint32_t i;
+
+	/* Distance from the next token keeps the order across wrap-around */
+	for (i = 0; i < CB_VIC_QUEUE_DEPTH; i++) {
+		if (vic_jobs[i].state != VIC_JOB_QUEUED)
+			continue;
+		if ((oldest == NULL) ||
+			((vic_next_token - vic_jobs[i].token) >
+			 (vic_next_token - oldest->token)))
+			oldest = &vic_jobs[i];
+	}
+
+	return oldest;
+}
+
+static void cb_vic_queue_complete(struct vic_job *job, tegrabl_error_t err)
+{
+	job->err = err;
+	job->state = job->detached ? VIC_JOB_FREE : VIC_JOB_DONE;
+	if (err != TEGRABL_NO_ERROR)
+		pr_error("%s: VIC job %u failed at 0x%llx, error 0x%x\n", __func__,
+				 job->token, job->dst + job->offset, err);
+}
+
+/*
+ * VIC stopped making progress: hold it in reset so that it cannot write
+ * DRAM behind a CPU or GPCDMA fallback, and fail the jobs still queued
+ * instead of feeding them to a hung engine. The next submit brings VIC
+ * back up.
+ */
+static void cb_vic_queue_abort(void)
+{
+	struct vic_job *job;
+
+	if (cb_vic_exit() != TEGRABL_NO_ERROR)
+		pr_error("%s: VIC could not be put in reset\n", __func__);
+	vic_initialized = false;
+
+	for (job = cb_vic_queue_oldest(); job != NULL;
+		 job = cb_vic_queue_oldest())
+		cb_vic_queue_complete(job, TEGRABL_ERR_TIMEOUT);
+}
+
+bool cb_vic_queue_poll(void)
+{
+	struct cb_vic_surface surface;
+	struct vic_job *job;
+
+	if (vic_busy_job != NULL) {
+		job = vic_busy_job;
+		if (NV_READ32(NV_ADDRESS_MAP_VIC_BASE + NV_PVIC_FALCON_IDLESTATE) !=
+			0) {
+			if ((tegrabl_get_timestamp_us() - vic_busy_start) <
+				vic_busy_timeout)
+				return true;
+			vic_busy_job = NULL;
+			cb_vic_queue_complete(job, TEGRABL_ERR_TIMEOUT);
+			cb_vic_queue_abort();
+			return false;
+		}
+
+		vic_busy_job = NULL;
+		vic_scrub_stats.bytes_scrubbed += vic_busy_chunk;
+		job->offset += vic_busy_chunk;
+		if (job->offset == job->size)
+			cb_vic_queue_complete(job, TEGRABL_NO_ERROR);
+	}
+
+	/* Start the next surface right away, so VIC only idles for the time
+	 * the caller takes to come back here */
+	job = cb_vic_queue_oldest();
+	if (job == NULL)
+		return false;
+
+	cb_vic_plan_surface(job->dst + job->offset, job->src + job->offset,
+						job->size - job->offset, &surface);
+	cb_vic_blit(job->dst + job->offset, job->src + job->offset, &surface);
+
+	vic_busy_job = job;
+	vic_busy_chunk = surface.size;
+	vic_busy_start = tegrabl_get_timestamp_us();
+	/* The old per transfer limit, for every scrub block of the surface */
+	vic_busy_timeout = (VIC_POLL_DELAY_COUNT * 50) *
+		((surface.size + SCRUB_BLOCK_SIZE - 1) / SCRUB_BLOCK_SIZE);
+
+	return true;
+}
+
+tegrabl_error_t cb_vic_queue_submit(uint64_t dst, uint64_t src, uint64_t size,
+									uint32_t *token)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	struct vic_job *job = NULL;
+	uint32_t i;
+
+	if (((dst & (VIC_SCRUB_GRANULE - 1)) != 0) ||
+		((src & (VIC_SCRUB_GRANULE - 1)) != 0) ||
+		((size & (VIC_SCRUB_GRANULE - 1)) != 0) || (size == 0))
+		return TEGRABL_ERR_BAD_PARAMETER;
+
+	if (!vic_initialized) {
+		err = cb_vic_init();
+		if (err != TEGRABL_NO_ERROR)
+			return err;
+	}
+
+	while (job == NULL) {
+		for (i = 0; i < CB_VIC_QUEUE_DEPTH; i++) {
+			if (vic_jobs[i].state == VIC_JOB_FREE) {
+				job = &vic_jobs[i];
+				break;
+			}
+		}
+		if (job != NULL)
+			break;
+		/* Full: let VIC work through the queue until a slot frees up */
+		if ((vic_busy_job == NULL) && (cb_vic_queue_oldest() == NULL)) {
+			pr_error("%s: queue full of uncollected tokens\n", __func__);
+			return TEGRABL_ERR_OVERFLOW;
+		}
+		cb_vic_queue_poll();
+	}
+
+	job->dst = dst;
+	job->src = src;
+	job->size = size;
+	job->offset = 0;
+	job->err = TEGRABL_NO_ERROR;
+	job->detached = (token == NULL);
+	job->token = vic_next_token++;
+	if (vic_next_token == CB_VIC_TOKEN_INVALID)
+		vic_next_token++;
+	job->state = VIC_JOB_QUEUED;
+
+	if (token != NULL)
+		*token = job->token;
+
+	/* Kick VIC if it is idle */
+	if (vic_busy_job == NULL)
+		cb_vic_queue_poll();
+
+	return TEGRABL_NO_ERROR;
+}
+
+tegrabl_error_t cb_vic_queue_wait(uint32_t token)
+{
+	struct vic_job *job;
+	tegrabl_error_t err;
+
+	job = cb_vic_queue_find(token);
+	if ((job == NULL) || job->detached)
+		return TEGRABL_ERR_NOT_FOUND;
+
+	while (job->state == VIC_JOB_QUEUED)
+		cb_vic_queue_poll();
+
+	err = job->err;
+	job->state = VIC_JOB_FREE;
+
+	return err;
+}
+
+void cb_vic_queue_drain(void)
+{
+	while (cb_vic_queue_poll())
+		;
+}
+
+void cb_vic_scrub_defer(uint64_t size)
+{
+	vic_scrub_stats.bytes_deferred += size;
+}
+
+void cb_vic_get_scrub_stats(struct cb_vic_scrub_stats *stats)
+{
+	TEGRABL_ASSERT(stats);
+
+	*stats = vic_scrub_stats;
+}
+
 static tegrabl_error_t cb_vic_clock_enable(void)
 {
 	uint32_t vic_clk_set;
@@ -391,6 +754,7 @@ tegrabl_error_t cb_vic_init(void)
 
 	/* Load VIC Code at the VIC base address */
 	cb_vic_boot();
+	vic_initialized = true;
 
 	pr_debug("VIC FW Initialized\n");
 	return TEGRABL_NO_ERROR;
@@ -416,6 +780,7 @@ tegrabl_error_t cb_vic_exit(void)
 	if (err != TEGRABL_NO_ERROR)
 		goto fail;
 
+	vic_initialized = false;
 	pr_debug("VIC FC closed\n");
 fail:
 	if (err != TEGRABL_NO_ERROR)
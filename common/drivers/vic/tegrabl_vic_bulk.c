@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_module.h>
+#include <tegrabl_dmamap.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_vic.h>
+#if defined(CONFIG_ENABLE_GPCDMA_MEM)
+#include <tegrabl_gpcdma_mem.h>
+#endif
+
+/* Fill jobs kept in flight by cb_vic_memset() */
+#define VIC_BULK_FILL_TOKENS	(CB_VIC_QUEUE_DEPTH / 2)
+
+/*
+ * Offsets of dst and src from the previous VIC_SCRUB_GRANULE boundary must
+ * match, so that after a CPU head both are aligned for VIC
+ */
+static bool cb_vic_bulk_aligned(uintptr_t dst, uintptr_t src)
+{
+	return ((dst - src) & (VIC_SCRUB_GRANULE - 1)) == 0;
+}
+
+/*
+ * VIC goes through a job one surface at a time in increasing address order,
+ * but in no defined order within a surface, and surfaces go up to
+ * VIC_SRUB_SIZE_MAX. An overlapping copy is therefore safe on VIC only
+ * towards a lower address and in pieces no longer than src - dst: no piece
+ * then overwrites its own source or that of a later piece. Returns the piece
+ * length, 0 if the copy has to stay on the CPU.
+ */
+static size_t cb_vic_bulk_piece(uintptr_t dst, uintptr_t src, size_t size)
+{
+	if ((dst >= (src + size)) || (src >= (dst + size)))
+		return size;
+
+	if ((dst < src) && ((src - dst) >= CB_VIC_BULK_THRESHOLD))
+		return src - dst;
+
+	return 0;
+}
+
+void cb_vic_memcpy(void *dst, const void *src, size_t size)
+{
+	uintptr_t d = (uintptr_t)dst;
+	uintptr_t s = (uintptr_t)src;
+	struct cb_vic_plan plan;
+	dma_addr_t dst_dma;
+	dma_addr_t src_dma;
+	size_t head;
+	size_t body;
+	size_t piece = 0;
+	size_t done;
+	uint32_t token;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+
+	if ((size >= CB_VIC_BULK_THRESHOLD) && cb_vic_bulk_aligned(d, s))
+		piece = cb_vic_bulk_piece(d, s, size);
+	if (piece == 0) {
+		memmove(dst, src, size);
+		return;
+	}
+
+	cb_vic_plan_region((uint64_t)d, (uint64_t)size, &plan);
+	head = (size_t)plan.head_size;
+	body = (size_t)plan.vic_size;
+
+	memcpy(dst, src, head);
+
+	src_dma = tegrabl_dma_map_buffer(TEGRABL_MODULE_VIC, 0,
+									 (void *)(s + head), body,
+									 TEGRABL_DMA_TO_DEVICE);
+	dst_dma = tegrabl_dma_map_buffer(TEGRABL_MODULE_VIC, 0,
+									 (void *)(d + head), body,
+									 TEGRABL_DMA_FROM_DEVICE);
+
+	for (done = 0; done < body; done += piece) {
+		if (piece > (body - done))
+			piece = body - done;
+		err = cb_vic_queue_submit((uint64_t)dst_dma + done,
+								  (uint64_t)src_dma + done, piece, &token);
+		if (err == TEGRABL_NO_ERROR)
+			err = cb_vic_queue_wait(token);
+		if (err != TEGRABL_NO_ERROR)
+			break;
+	}
+
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_VIC, 0, (void *)(s + head), body,
+							 TEGRABL_DMA_TO_DEVICE);
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_VIC, 0, (void *)(d + head), body,
+							 TEGRABL_DMA_FROM_DEVICE);
+
+#if defined(CONFIG_ENABLE_GPCDMA_MEM)
+	/* GPCDMA splits the copy across channels, so not if what is left
+	 * overlaps */
+	if ((err != TEGRABL_NO_ERROR) &&
+		(cb_vic_bulk_piece(d + head + done, s + head + done, body - done) ==
+		 (body - done))) {
+		pr_warn("%s: VIC copy failed (0x%x), using GPCDMA\n", __func__, err);
+		err = tegrabl_gpcdma_memcpy((void *)(d + head + done),
+									(const void *)(s + head + done),
+									body - done,
+									TEGRABL_GPCDMA_MEM_DEFAULT_CHANNELS);
+	}
+#endif
+	/* Pieces before a failed one are in place and wrote below the source
+	 * still to be copied, so only the rest is redone */
+	if (err != TEGRABL_NO_ERROR) {
+		pr_warn("%s: copy failed (0x%x), copying on CPU\n", __func__, err);
+		memmove((void *)(d + head + done), (const void *)(s + head + done),
+				body - done);
+	}
+
+	/* The tail may sit on source the body copy still had to read */
+	memcpy((void *)(d + head + body), (const void *)(s + head + body),
+		   size - head - body);
+}
+
+void cb_vic_memset(void *dst, uint8_t val, size_t size)
+{
+	uintptr_t d = (uintptr_t)dst;
+	struct cb_vic_plan plan;
+	uint32_t tokens[VIC_BULK_FILL_TOKENS];
+	uint32_t num_tokens = 0;
+	uint32_t next = 0;
+	dma_addr_t body_dma;
+	size_t head;
+	size_t body;
+	size_t seed;
+	size_t filled;
+	size_t chunk;
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	tegrabl_error_t wait_err;
+
+	if (size < CB_VIC_BULK_THRESHOLD) {
+		memset(dst, val, size);
+		return;
+	}
+
+	cb_vic_plan_region((uint64_t)d, (uint64_t)size, &plan);
+	head = (size_t)plan.head_size;
+	body = (size_t)plan.vic_size;
+
+	/* Head, tail and the first granule of the body are set on the CPU */
+	memset(dst, val, head + VIC_SCRUB_GRANULE);
+	memset((void *)(d + head + body), val, size - head - body);
+
+	tegrabl_dma_map_buffer(TEGRABL_MODULE_VIC, 0, (void *)(d + head),
+						   VIC_SCRUB_GRANULE, TEGRABL_DMA_TO_DEVICE);
+	body_dma = tegrabl_dma_map_buffer(TEGRABL_MODULE_VIC, 0,
+									  (void *)(d + head), body,
+									  TEGRABL_DMA_FROM_DEVICE);
+
+	/* Double the filled part up to a scrub block; each copy reads what the
+	 * previous one wrote, so these are waited for one by one */
+	seed = VIC_SCRUB_GRANULE;
+	while ((seed < SCRUB_BLOCK_SIZE) && (seed < body)) {
+		chunk = ((body - seed) < seed) ? (body - seed) : seed;
+		err = cb_vic_queue_submit((uint64_t)body_dma + seed,
+								  (uint64_t)body_dma, chunk, &tokens[0]);
+		if (err == TEGRABL_NO_ERROR)
+			err = cb_vic_queue_wait(tokens[0]);
+		if (err != TEGRABL_NO_ERROR)
+			goto done;
+		seed += chunk;
+	}
+
+	/* The seed does not change any more, so the copies of it can overlap;
+	 * a ring of tokens keeps the queue busy and still catches errors */
+	for (filled = seed; filled < body; filled += chunk) {
+		chunk = ((body - filled) < seed) ? (body - filled) : seed;
+		if (num_tokens == VIC_BULK_FILL_TOKENS) {
+			wait_err = cb_vic_queue_wait(tokens[next]);
+			num_tokens--;
+			if (wait_err != TEGRABL_NO_ERROR) {
+				err = wait_err;
+				break;
+			}
+		}
+		err = cb_vic_queue_submit((uint64_t)body_dma + filled,
+								  (uint64_t)body_dma, chunk, &tokens[next]);
+		if (err != TEGRABL_NO_ERROR)
+			break;
+		next = (next + 1) % VIC_BULK_FILL_TOKENS;
+		num_tokens++;
+	}
+
+	/* Collect what is still in flight, oldest first */
+	while (num_tokens != 0) {
+		wait_err = cb_vic_queue_wait(
+			tokens[(next + VIC_BULK_FILL_TOKENS - num_tokens) %
+				   VIC_BULK_FILL_TOKENS]);
+		if (err == TEGRABL_NO_ERROR)
+			err = wait_err;
+		num_tokens--;
+	}
+
+done:
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_VIC, 0, (void *)(d + head),
+							 VIC_SCRUB_GRANULE, TEGRABL_DMA_TO_DEVICE);
+	tegrabl_dma_unmap_buffer(TEGRABL_MODULE_VIC, 0, (void *)(d + head), body,
+							 TEGRABL_DMA_FROM_DEVICE);
+
+#if defined(CONFIG_ENABLE_GPCDMA_MEM)
+	if (err != TEGRABL_NO_ERROR) {
+		pr_warn("%s: VIC fill failed (0x%x), using GPCDMA\n", __func__, err);
+		err = tegrabl_gpcdma_memset((void *)(d + head), val, body,
+									TEGRABL_GPCDMA_MEM_DEFAULT_CHANNELS);
+	}
+#endif
+	if (err != TEGRABL_NO_ERROR) {
+		pr_warn("%s: fill failed (0x%x), filling on CPU\n", __func__, err);
+		memset((void *)(d + head), val, body);
+	}
+}
+
+#if defined(CONFIG_ENABLE_VIC_BULK_BENCHMARK)
+void cb_vic_bulk_benchmark(void *scratch, size_t size)
+{
+	uint8_t *dst = scratch;
+	uint8_t *src = dst + (size / 2);
+	size_t len;
+	time_t start;
+	time_t cpu_us;
+	time_t vic_us;
+
+	for (len = CB_VIC_BULK_THRESHOLD / 4; len <= (size / 2); len *= 4) {
+		start = tegrabl_get_timestamp_us();
+		memcpy(dst, src, len);
+		cpu_us = tegrabl_get_timestamp_us() - start;
+
+		start = tegrabl_get_timestamp_us();
+		cb_vic_memcpy(dst, src, len);
+		vic_us = tegrabl_get_timestamp_us() - start;
+
+		pr_info("bulk copy %8u KB: cpu %7u us, vic %7u us\n",
+				(uint32_t)(len / 1024), (uint32_t)cpu_us, (uint32_t)vic_us);
+
+		start = tegrabl_get_timestamp_us();
+		memset(dst, 0, len);
+		cpu_us = tegrabl_get_timestamp_us() - start;
+
+		start = tegrabl_get_timestamp_us();
+		cb_vic_memset(dst, 0, len);
+		vic_us = tegrabl_get_timestamp_us() - start;
+
+		pr_info("bulk fill %8u KB: cpu %7u us, vic %7u us\n",
+				(uint32_t)(len / 1024), (uint32_t)cpu_us, (uint32_t)vic_us);
+	}
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_ARCH_TIMER_H
+#define TEGRABL_ARCH_TIMER_H
+
+#include <stdint.h>
+#include <tegrabl_error.h>
+#include <tegrabl_timer.h>
+
+/**
+ * @brief Busy waits on the TSCUS counter, the default tegrabl_udelay()
+ * backend. Calibrated for BPMP/R5, so it overshoots on CCPLEX.
+ *
+ * @param usec microseconds to wait
+ */
+void tegrabl_tscus_udelay(time_t usec);
+
+#if defined(CONFIG_ENABLE_ARCH_TIMER_UDELAY)
+/**
+ * @brief Waits on the ARMv8 generic timer (CNTPCT_EL0), sleeping in WFE
+ * between the timer event stream ticks. Used by tegrabl_udelay() when
+ * CONFIG_ENABLE_ARCH_TIMER_UDELAY is set, CCPLEX (AArch64) only.
+ *
+ * The event stream is enabled on the first call and stays on until
+ * tegrabl_arch_timer_stop().
+ *
+ * @param usec microseconds to wait
+ */
+void tegrabl_arch_timer_udelay(time_t usec);
+
+/**
+ * @brief Puts the timer event stream control (CNTHCTL_EL2 or CNTKCTL_EL1)
+ * back as it was before the first tegrabl_arch_timer_udelay(). Called before
+ * the kernel is started, which must not inherit the event stream; later
+ * delays fall back to tegrabl_tscus_udelay().
+ */
+void tegrabl_arch_timer_stop(void);
+
+#if defined(CONFIG_ENABLE_ARCH_TIMER_SELFTEST)
+/**
+ * @brief Measures tegrabl_arch_timer_udelay() and tegrabl_tscus_udelay()
+ * against CNTPCT for delays from 1us to 5ms and prints min/avg/max
+ * overshoot of each. Also checks CNTFRQ_EL0 against TSCUS.
+ *
+ * Takes about 120ms.
+ *
+ * @return TEGRABL_NO_ERROR if no arch timer delay was short and CNTFRQ_EL0
+ * matches the counter rate, TEGRABL_ERR_INVALID otherwise
+ */
+tegrabl_error_t tegrabl_arch_timer_selftest(void);
+#endif
+#endif
+
+#endif /* TEGRABL_ARCH_TIMER_H */
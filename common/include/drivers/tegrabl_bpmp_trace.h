@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_BPMP_TRACE_H
+#define TEGRABL_BPMP_TRACE_H
+
+#include <stdint.h>
+#include <tegrabl_error.h>
+
+/**
+ * @brief Sends a request to BPMP and waits for the response, same as
+ * tegrabl_ccplex_bpmp_xfer(). With CONFIG_ENABLE_BPMP_IPC_TRACE the
+ * request is also traced: MRQ, sub-command, clock/reset/domain ID, sizes
+ * and round-trip time.
+ *
+ * @param req request payload
+ * @param resp response buffer, may be NULL
+ * @param req_sz size of the payload
+ * @param resp_sz size of the response buffer
+ * @param mrq MRQ number of the request
+ *
+ * @return status of the transfer
+ */
+tegrabl_error_t tegrabl_bpmp_xfer(void *req, void *resp, uint32_t req_sz,
+	uint32_t resp_sz, uint32_t mrq);
+
+/**
+ * @brief Prints the per MRQ/sub-command latency table and the slowest
+ * recent requests. Nothing is printed without CONFIG_ENABLE_BPMP_IPC_TRACE.
+ */
+void tegrabl_bpmp_trace_dump(void);
+
+#endif /* TEGRABL_BPMP_TRACE_H */
@@ -214,6 +214,20 @@ tegrabl_error_t tegrabl_fuse_query_size(uint32_t type, uint32_t *size);
 tegrabl_error_t tegrabl_fuse_read(
 	fuse_type_t type, uint32_t *buffer, uint32_t size);
 
+/**
+ * @brief Reads all fuses served by tegrabl_fuse_read() in one visibility
+ * window and keeps them in memory. Secret keys (SBK, KEKs, EK) are left
+ * out and are read from the fuses on each request. Done on the first
+ * tegrabl_fuse_read() if not called before.
+ */
+void tegrabl_fuse_snapshot_init(void);
+
+/**
+ * @brief Drops the fuse snapshot, so the next read refreshes it. Needed
+ * after fuses are burnt.
+ */
+void tegrabl_fuse_snapshot_invalidate(void);
+
 /**
  * @brief Sets fuse value to new value
  *
@@ -267,6 +281,25 @@ void tegrabl_fuse_program_mirroring(bool is_enable);
 tegrabl_error_t tegrabl_fuse_write(
 	uint32_t fuse_type, uint32_t *buffer, uint32_t size);
 
+/**
+ * @brief Starts a fuse burning batch. Fuse programming is set up once
+ * here. tegrabl_fuse_write() calls that follow only burn their words;
+ * they are neither sensed nor verified individually.
+ *
+ * @return TEGRABL_NO_ERROR if successful else appropriate error.
+ */
+tegrabl_error_t tegrabl_fuse_write_batch_begin(void);
+
+/**
+ * @brief Ends a fuse burning batch: programming is torn down and the
+ * fuses are sensed once, so the burnt values can be read back for
+ * verification.
+ *
+ * @return TEGRABL_NO_ERROR if successful, the sense error otherwise; the
+ * programming window is closed either way.
+ */
+tegrabl_error_t tegrabl_fuse_write_batch_end(void);
+
 /**
  * @brief set ps18_latch_set bit in pmc_fuse_control register
  *
@@ -288,9 +321,13 @@ uint32_t tegrabl_fuse_get_bootrom_patch_version(void);
 /*
  * @brief reads ft revision for given address
  *
- * @return ft revision value
+ * @param addr fuse row to read
+ * @param val receives the row, untouched on error
+ *
+ * @return TEGRABL_NO_ERROR if successful, TEGRABL_ERR_TIMEOUT if the fuse
+ * controller did not complete the read
  */
-uint32_t tegrabl_fuserdata_read(uint32_t addr);
+tegrabl_error_t tegrabl_fuserdata_read(uint32_t addr, uint32_t *val);
 
 /**
  * @brief Determines if the production_mode fuse is burned or not.
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_GPCDMA_MEM_H
+#define TEGRABL_GPCDMA_MEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <tegrabl_error.h>
+
+/* Channels a single memcpy/memset can be striped across */
+#define TEGRABL_GPCDMA_MEM_MAX_CHANNELS		8U
+/* Channels used when VIC work falls back to GPCDMA */
+#define TEGRABL_GPCDMA_MEM_DEFAULT_CHANNELS	4U
+
+/*
+ * Built with CONFIG_ENABLE_GPCDMA_MEM. The board configuration has to set
+ * CONFIG_GPCDMA_MEM_FIRST_CHANNEL to the first of
+ * TEGRABL_GPCDMA_MEM_MAX_CHANNELS channels no IO driver uses.
+ */
+
+/**
+ * @brief Copies size bytes from src to dst with GPCDMA and waits for it
+ *
+ * The region is split into equal stripes, one per channel, all running at
+ * the same time. Unaligned ends are copied by the CPU. Cache maintenance
+ * is done here.
+ *
+ * @param dst destination, must not overlap src
+ * @param src source, with the same offset from a word boundary as dst
+ * @param size bytes to copy
+ * @param num_channels 1 to TEGRABL_GPCDMA_MEM_MAX_CHANNELS
+ *
+ * @return TEGRABL_NO_ERROR on success; on failure dst is left partly copied
+ */
+tegrabl_error_t tegrabl_gpcdma_memcpy(void *dst, const void *src, size_t size,
+	uint32_t num_channels);
+
+/**
+ * @brief Fills size bytes at dst with val using GPCDMA pattern fill
+ *
+ * Striped across channels as tegrabl_gpcdma_memcpy().
+ *
+ * @param dst region to fill
+ * @param val byte value
+ * @param size bytes to fill
+ * @param num_channels 1 to TEGRABL_GPCDMA_MEM_MAX_CHANNELS
+ *
+ * @return TEGRABL_NO_ERROR on success
+ */
+tegrabl_error_t tegrabl_gpcdma_memset(void *dst, uint8_t val, size_t size,
+	uint32_t num_channels);
+
+#endif /* TEGRABL_GPCDMA_MEM_H */
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_POLL_H
+#define TEGRABL_POLL_H
+
+#include <stdint.h>
+#include <tegrabl_error.h>
+#include <tegrabl_timer.h>
+
+/**
+ * @brief Polls a register until (value of reg & mask) == value or the
+ * deadline passes
+ *
+ * With CONFIG_ENABLE_POLL_STATS, iterations and time spent are accounted to
+ * the caller's return address, see tegrabl_poll_stats_dump().
+ *
+ * @param reg address of the register
+ * @param mask bits compared
+ * @param value expected value of the masked bits
+ * @param deadline tegrabl_get_timestamp_us() value to give up at
+ *
+ * @return TEGRABL_NO_ERROR once the register matches, TEGRABL_ERR_TIMEOUT
+ * if it did not by the deadline
+ */
+tegrabl_error_t tegrabl_poll_until(uintptr_t reg, uint32_t mask,
+	uint32_t value, time_t deadline);
+
+/**
+ * @brief Same as tegrabl_poll_until(), but waits between reads, starting
+ * at 1us and doubling up to max_delay_us
+ *
+ * For waits of many microseconds, where polling the register back to back
+ * only adds bus traffic.
+ */
+tegrabl_error_t tegrabl_poll_until_backoff(uintptr_t reg, uint32_t mask,
+	uint32_t value, time_t deadline, time_t max_delay_us);
+
+/**
+ * @brief Polls a register while (value of reg & mask) == value, i.e. until
+ * the masked bits change, or the deadline passes
+ */
+tegrabl_error_t tegrabl_poll_while(uintptr_t reg, uint32_t mask,
+	uint32_t value, time_t deadline);
+
+/**
+ * @brief Prints calls, timeouts, iterations and time per polling site,
+ * costliest first. Sites are caller addresses, to be looked up in the
+ * bootloader ELF. Nothing is printed without CONFIG_ENABLE_POLL_STATS.
+ */
+void tegrabl_poll_stats_dump(void);
+
+#endif /* TEGRABL_POLL_H */
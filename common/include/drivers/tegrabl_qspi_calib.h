@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_QSPI_CALIB_H
+#define TEGRABL_QSPI_CALIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <tegrabl_error.h>
+
+/* Highest rx_clk_tap_delay tried during the sweep */
+#define TEGRABL_QSPI_CALIB_MAX_RX_TAP	63U
+
+/**
+ * @brief QSPI read timing: clock divisor, read mode and trimmers
+ *
+ * @clk_divisor - CLK_SOURCE_QSPI divisor, as in the MB1 BCT (7.1)
+ * @ddr - QDDR read mode
+ * @rx_trim - rx_clk_tap_delay
+ * @tx_trim - tx_clk_tap_delay, not swept
+ */
+struct tegrabl_qspi_timing {
+	uint8_t clk_divisor;
+	bool ddr;
+	uint8_t rx_trim;
+	uint8_t tx_trim;
+};
+
+/**
+ * @brief Hooks of the QSPI driver used by the calibration
+ *
+ * @apply - reprograms the controller and its clock with timing. Returns
+ *          TEGRABL_ERR_NOT_SUPPORTED if the flash cannot do QDDR reads.
+ * @read_pattern - reads size bytes of the known pattern in the BCT region
+ * @load - fetches the cached result, optional
+ * @store - saves a new result, optional
+ * @priv - passed back to the hooks
+ * @min_divisor - smallest divisor the controller/flash may be run at
+ * @bct_id - identifies the BCT the safe timing comes from, e.g. its version
+ *           or a hash of its QSPI parameters. A cached result stored under
+ *           another bct_id is ignored.
+ */
+struct tegrabl_qspi_calib_params {
+	tegrabl_error_t (*apply)(const struct tegrabl_qspi_timing *timing,
+							 void *priv);
+	tegrabl_error_t (*read_pattern)(void *buf, uint32_t size, void *priv);
+	tegrabl_error_t (*load)(uint32_t *cache, void *priv);
+	tegrabl_error_t (*store)(uint32_t cache, void *priv);
+	void *priv;
+	uint8_t min_divisor;
+	uint8_t bct_id;
+};
+
+/**
+ * @brief Finds the fastest stable QSPI read timing.
+ * A cached result from the same bct_id is used once four verification
+ * reads of the pattern pass. Otherwise clock
+ * divisors from min_divisor up to the one in safe are swept, with and
+ * without QDDR, fastest first. For each, rx trimmers are swept and the
+ * middle of the widest passing window is taken. The first setting that
+ * passes is applied and cached; if none does, safe is applied.
+ *
+ * @param params driver hooks and limits
+ * @param safe timing known to work, normally the one from the MB1 BCT
+ * @param buf scratch buffer of 2 * size bytes
+ * @param size number of pattern bytes read per check
+ * @param best returns the timing applied
+ *
+ * @return TEGRABL_NO_ERROR if the controller is left working with best,
+ *         error code otherwise
+ */
+tegrabl_error_t tegrabl_qspi_calibrate(
+		const struct tegrabl_qspi_calib_params *params,
+		const struct tegrabl_qspi_timing *safe,
+		void *buf, uint32_t size,
+		struct tegrabl_qspi_timing *best);
+
+/**
+ * @brief Hands the driver hooks and the BCT timing over for calibration.
+ * Called by the QSPI driver once the controller and the flash work with
+ * safe; both are copied. Passing NULL cancels a pending calibration.
+ *
+ * @param params driver hooks and limits
+ * @param safe timing the controller was initialized with
+ */
+void tegrabl_qspi_calib_register(const struct tegrabl_qspi_calib_params *params,
+								 const struct tegrabl_qspi_timing *safe);
+
+/**
+ * @brief Runs tegrabl_qspi_calibrate() once with the registered hooks and
+ * a scratch buffer of its own. Called with no QSPI transfer in flight.
+ *
+ * @return TEGRABL_NO_ERROR if nothing was registered or the calibration
+ *         succeeded, error code otherwise
+ */
+tegrabl_error_t tegrabl_qspi_calib_run(void);
+
+#endif /* TEGRABL_QSPI_CALIB_H */
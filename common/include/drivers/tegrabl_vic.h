@@ -11,6 +11,8 @@
 #ifndef TEGRABL_VIC_H
 #define TEGRABL_VIC_H
 
+#include <stddef.h>
+
 #ifdef CB_VIC_DEBUG
 #define CB_VIC_DBG(fmt, args...)	pr_debug(fmt, ##args)
 #else
@@ -50,6 +52,36 @@ struct vic_transfer_config {
 	uint64_t dest_addr_phy;
 };
 
+/**
+ * Bytes of DRAM scrubbed by VIC and bytes whose scrubbing was left to the OS
+ */
+struct cb_vic_scrub_stats {
+	uint64_t bytes_scrubbed;
+	uint64_t bytes_deferred;
+};
+
+/**
+ * Geometry of one VIC surface, in A8R8G8B8 pixels
+ */
+struct cb_vic_surface {
+	uint32_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t block_height;
+};
+
+/**
+ * Split of a DRAM region into a CPU head, a VIC_SCRUB_GRANULE aligned body
+ * handed to VIC as num_surfaces surfaces, and a CPU tail
+ */
+struct cb_vic_plan {
+	uint64_t head_size;
+	uint64_t vic_base;
+	uint64_t vic_size;
+	uint64_t tail_base;
+	uint64_t tail_size;
+	uint32_t num_surfaces;
+};
 
 #define SIZE_1M									(1 * 1024 * 1024)
 
@@ -64,8 +96,16 @@ struct vic_transfer_config {
 #define VIC_SRUB_SIZE_MAX						0x40000000
 #define VIC_SRUB_SIZE_MIN						0x400
 
+/* Smallest size below 1MB giving a 16 pixel aligned width at height 64 */
+#define VIC_SCRUB_GRANULE						0x1000
+
 #define VIC_POLL_DELAY_COUNT					3000
 
+/* Jobs that can be queued before submit has to wait for one */
+#define CB_VIC_QUEUE_DEPTH						32
+/* Token value never handed out by cb_vic_queue_submit() */
+#define CB_VIC_TOKEN_INVALID					0
+
 #define MAX_VIC_CONTROLLERS						1
 
 #define VIC_CLK_FREQUENCY_VAL					800000
@@ -110,6 +150,102 @@ struct vic_transfer_config {
 */
 tegrabl_error_t cb_vic_scrub(uint32_t instance, uint32_t cmd, void *p_buf);
 
+/**
+ * Scrub a DRAM region and wait for completion
+ *
+ * The VIC_SCRUB_GRANULE aligned body goes to VIC as planned by
+ * cb_vic_plan_region(), initializing VIC first if needed; an unaligned head
+ * and tail are zeroed and cleaned by the CPU meanwhile. The body is
+ * cleaned and invalidated from the CPU caches around the VIC transfer.
+ */
+tegrabl_error_t cb_vic_scrub_region(uint64_t base, uint64_t size);
+
+/**
+ * Plan base/size into the fewest surfaces VIC can take plus CPU pieces
+ *
+ * Surfaces are picked greedily by cb_vic_plan_surface(): once the body
+ * reaches a 1MB boundary it is covered by 1MB multiple surfaces of up to
+ * VIC_SRUB_SIZE_MAX, before that by one surface up to the boundary.
+ */
+void cb_vic_plan_region(uint64_t base, uint64_t size, struct cb_vic_plan *plan);
+
+/**
+ * Largest legal surface for a transfer of size bytes from src to dst
+ *
+ * dst, src and size must be VIC_SCRUB_GRANULE aligned. 1MB surfaces need
+ * both dst and src 1MB aligned; smaller ones stop at the nearer 1MB
+ * boundary, so the next surface can be a large one.
+ */
+void cb_vic_plan_surface(uint64_t dst, uint64_t src, uint64_t size,
+						 struct cb_vic_surface *surface);
+
+/**
+ * Queue a VIC copy of size bytes from src to dst and return without waiting
+ *
+ * dst, src and size must be VIC_SCRUB_GRANULE aligned; src == dst scrubs
+ * the region. Jobs are split into legal transfers and run on VIC in
+ * submission order. A chunk is started on submit if VIC is idle, after
+ * that whenever cb_vic_queue_poll(), _wait() or _drain() runs, so callers
+ * should poll between other work. Cache maintenance for the regions is
+ * the caller's responsibility. CB_VIC_TRANSFER must not be used while
+ * jobs are queued.
+ *
+ * token returns the token to wait on. If NULL, nobody waits and the slot
+ * is released as soon as the job completes.
+ */
+tegrabl_error_t cb_vic_queue_submit(uint64_t dst, uint64_t src, uint64_t size,
+									uint32_t *token);
+
+/**
+ * Retire the transfer VIC has finished, if any, and start the next one
+ *
+ * Never waits for VIC. Returns true while jobs remain queued or running.
+ * If VIC overruns its time for a transfer it is put in reset and every
+ * queued job fails with TEGRABL_ERR_TIMEOUT.
+ */
+bool cb_vic_queue_poll(void);
+
+/* Run the queue until the job of token completes and release the token */
+tegrabl_error_t cb_vic_queue_wait(uint32_t token);
+
+/* Run the queue until every queued job has completed */
+void cb_vic_queue_drain(void);
+
+/* Copies and fills smaller than this are left to the CPU */
+#define CB_VIC_BULK_THRESHOLD					(256 * 1024)
+
+/**
+ * memmove() that hands the bulk of large copies to VIC
+ *
+ * Below CB_VIC_BULK_THRESHOLD, when dst and src are not at the same offset
+ * within VIC_SCRUB_GRANULE, or for overlapping buffers unless dst is at
+ * least CB_VIC_BULK_THRESHOLD below src, the CPU does the copy. Otherwise
+ * the CPU copies the unaligned head and tail and VIC the granule aligned
+ * body, an overlapping one in pieces of src - dst; caches are
+ * cleaned/invalidated around it. If VIC fails, the rest of the body is
+ * copied on the CPU.
+ */
+void cb_vic_memcpy(void *dst, const void *src, size_t size);
+
+/**
+ * memset() that hands the bulk of large fills to VIC
+ *
+ * The CPU sets the head, the tail and one granule of the body. VIC then
+ * replicates that granule over the rest of the body.
+ */
+void cb_vic_memset(void *dst, uint8_t val, size_t size);
+
+#if defined(CONFIG_ENABLE_VIC_BULK_BENCHMARK)
+/* Print CPU vs VIC copy and fill times for sizes up to half of scratch */
+void cb_vic_bulk_benchmark(void *scratch, size_t size);
+#endif
+
+/* Account bytes handed over to the OS unscrubbed */
+void cb_vic_scrub_defer(uint64_t size);
+
+/* Get the eager vs deferred scrub byte counts */
+void cb_vic_get_scrub_stats(struct cb_vic_scrub_stats *stats);
+
 /**
  * VIC (Video Image Compositor) initialization
  *
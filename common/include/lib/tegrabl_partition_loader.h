@@ -83,6 +83,45 @@ tegrabl_error_t tegrabl_load_binary(tegrabl_binary_type_t bin_type,
 tegrabl_error_t tegrabl_load_binary_bdev(tegrabl_binary_type_t bin_type, void **load_address,
 										 uint32_t *binary_length,  tegrabl_bdev_t *bdev);
 
+#if defined(CONFIG_ENABLE_BINARY_PREFETCH)
+/**
+ * @brief Start reading specified binary copy into its load address in the
+ * background. The load address is resolved and reserved right away. A later
+ * tegrabl_load_binary_copy() for the same binary only waits for completion.
+ *
+ * @param bin_type Type of binary to be prefetched
+ * @param binary_copy primary or recovery copy which needs to be read
+ *
+ * @return TEGRABL_NO_ERROR if the read was queued, otherwise an appropriate
+ *		   error value. On error the binary is simply read on demand.
+ */
+tegrabl_error_t tegrabl_prefetch_binary_copy(tegrabl_binary_type_t bin_type,
+	tegrabl_binary_copy_t binary_copy);
+
+/**
+ * @brief Same as tegrabl_prefetch_binary_copy() with the copy selected the
+ * way tegrabl_load_binary() selects it.
+ *
+ * @param bin_type Type of binary to be prefetched
+ *
+ * @return TEGRABL_NO_ERROR if the read was queued, otherwise an appropriate
+ *		   error value.
+ */
+tegrabl_error_t tegrabl_prefetch_binary(tegrabl_binary_type_t bin_type);
+#endif
+
+union tegrabl_bootimg_header;
+
+/**
+ * @brief Bytes read for an Android boot image: the header page and the
+ * page aligned kernel, ramdisk, second stage and signature.
+ *
+ * @param hdr Header of the boot image
+ *
+ * @return Size of the image as the loader reads it
+ */
+uint64_t tegrabl_bootimg_load_size(const union tegrabl_bootimg_header *hdr);
+
 /**
  * @brief Updates the location of recovery image blob downloaded
  * in recovery for flashing or rcm boot.
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_PROFILER_SPAN_H
+#define TEGRABL_PROFILER_SPAN_H
+
+#include <stdint.h>
+#include <tegrabl_module.h>
+#include <tegrabl_profiler_span_log.h>
+
+/* Deepest nesting tracked; deeper spans are dropped */
+#define TEGRABL_PROF_SPAN_MAX_DEPTH		16U
+
+/* Handle never returned for a recorded span */
+#define TEGRABL_PROF_SPAN_NONE			0U
+
+/* Module of spans not tied to a controller, e.g. DT patching */
+#define TEGRABL_PROF_SPAN_NO_MODULE		TEGRABL_MODULE_NUM
+
+/**
+ * @brief Opens a span nested in the innermost open one
+ *
+ * Nothing is recorded without CONFIG_ENABLE_PROFILER_SPANS.
+ *
+ * @param name span name, copied into the log
+ * @param module module the span works on
+ *
+ * @return handle for tegrabl_profiler_span_end(), TEGRABL_PROF_SPAN_NONE if
+ * the span was not recorded
+ */
+uint32_t tegrabl_profiler_span_begin(const char *name, tegrabl_module_t module);
+
+/**
+ * @brief Closes a span and any spans still open inside it
+ *
+ * @param span handle from tegrabl_profiler_span_begin()
+ * @param bytes bytes the span processed, 0 if not meaningful
+ */
+void tegrabl_profiler_span_end(uint32_t span, uint64_t bytes);
+
+/**
+ * @brief Address and size of the span log
+ *
+ * The log lives in cboot memory, which the kernel reuses; it has to be
+ * copied to reserved memory to be handed over.
+ *
+ * @param size returns the size of the log
+ *
+ * @return address of the log, 0 if no span was recorded
+ */
+uint64_t tegrabl_profiler_span_log(uint32_t *size);
+
+#endif /* TEGRABL_PROFILER_SPAN_H */
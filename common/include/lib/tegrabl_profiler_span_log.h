@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_PROFILER_SPAN_LOG_H
+#define TEGRABL_PROFILER_SPAN_LOG_H
+
+#include <stdint.h>
+
+/*
+ * Span log layout. The log is kept in cboot's own memory while it boots and
+ * copied into a reserved-memory carveout for the kernel, which gets it as
+ * bl_prof_spanptr=<size>@<address>. All fields are little endian.
+ * common/lib/tegrabl_profiler_span/tools/tegrabl_span_decode.c turns a dump
+ * of it into a trace on the host.
+ *
+ *   0                      struct tegrabl_prof_span_header
+ *   32                     struct tegrabl_prof_span_record[num_records]
+ *   ...                    free
+ *   str_offset .. size     NUL terminated span names, added downwards
+ *
+ * Every BEGIN record is matched by an END record at the same depth; space
+ * for the END records of all open spans is kept, so the log stays balanced
+ * when it fills up and further spans are only counted in dropped.
+ * Timestamps are tegrabl_get_timestamp_us() truncated to 32 bits.
+ */
+
+/* Bytes of the log, header included */
+#define TEGRABL_PROF_SPAN_LOG_SIZE		(64U * 1024U)
+
+/* "SPAN" */
+#define TEGRABL_PROF_SPAN_MAGIC			0x4E415053U
+#define TEGRABL_PROF_SPAN_VERSION		1U
+
+#define TEGRABL_PROF_SPAN_BEGIN			1U
+#define TEGRABL_PROF_SPAN_END			2U
+
+/* Record module of spans not tied to a controller */
+#define TEGRABL_PROF_SPAN_REC_NO_MODULE	0xFFFFU
+
+struct tegrabl_prof_span_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;
+	/* Bytes of the log, header included */
+	uint32_t size;
+	uint32_t num_records;
+	/* Offset of the lowest name in the string table */
+	uint32_t str_offset;
+	/* Spans not recorded because the log was full or too deep */
+	uint32_t dropped;
+	uint64_t reserved;
+};
+
+struct tegrabl_prof_span_record {
+	uint32_t timestamp_us;
+	/* TEGRABL_PROF_SPAN_BEGIN or _END */
+	uint8_t type;
+	/* 0 for top level spans */
+	uint8_t depth;
+	/* tegrabl_module_t the span works on, or TEGRABL_PROF_SPAN_REC_NO_MODULE */
+	uint16_t module;
+	/* Offset of the span name from the log start, 0 if it did not fit */
+	uint16_t name;
+	uint16_t reserved;
+	/* END only: bytes loaded, verified or written by the span */
+	uint32_t bytes;
+};
+
+#endif /* TEGRABL_PROFILER_SPAN_LOG_H */
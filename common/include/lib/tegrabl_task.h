@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef TEGRABL_TASK_H
+#define TEGRABL_TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <tegrabl_error.h>
+#include <tegrabl_compiler.h>
+#include <tegrabl_timer.h>
+
+/*
+ * Deferred init work
+ *
+ * Independent init work can be queued as a task instead of being done in
+ * line. A task is a resumable step function: each call does a short piece
+ * of work, advances task->state and returns false, or returns true once the
+ * task is complete. Instead of waiting in line, a step asks with
+ * tegrabl_task_sleep() not to be called again before some time has passed.
+ *
+ * Steps run from tegrabl_udelay() of other code, when the remaining delay
+ * is at least the longest step of the task seen so far, and from
+ * tegrabl_task_wait(). A step never runs inside another step, nor inside
+ * a no-yield section: a timing critical hardware window such as fuse
+ * programming, or a register poll.
+ *
+ * Hardware or driver state a task shares with other code is named in
+ * task->resources; code using it claims it with tegrabl_task_claim() while
+ * it is in the middle of something, and tasks needing it are held back.
+ */
+
+/* CCPLEX-BPMP IPC channel, claimed by tegrabl_bpmp_xfer() */
+#define TEGRABL_TASK_RES_BPMP		(1U << 0)
+/* Clock sequences of the clock driver: clk_init_run() and its batch, the
+ * rate search and the multi-request set-rate/QSPI paths */
+#define TEGRABL_TASK_RES_CLK		(1U << 1)
+
+/* Step time assumed for a task until one of its steps has been timed */
+#define TEGRABL_TASK_DEFAULT_STEP_US	50U
+
+struct tegrabl_task;
+
+/**
+ * @brief Runs the next piece of a task
+ *
+ * @param task the task, task->state tells where to resume
+ *
+ * @return true once the task is complete, its result in task->err
+ */
+typedef bool (*tegrabl_task_step_t)(struct tegrabl_task *task);
+
+struct tegrabl_task {
+	const char *name;
+	tegrabl_task_step_t step;
+	/* TEGRABL_TASK_RES_* the steps use */
+	uint32_t resources;
+	/* Expected step time, raised to the longest step seen; 0 for default */
+	uint32_t step_us;
+	/* For step(), 0 when the task is added */
+	uint32_t state;
+	/* Result of the task, set by step() */
+	tegrabl_error_t err;
+
+	/* Private to the scheduler */
+	struct tegrabl_task *next;
+	bool queued;
+	bool done;
+	uint32_t wake_us;
+	uint32_t steps;
+	uint32_t delay_steps;
+	uint32_t busy_us;
+	uint32_t delay_us;
+	uint32_t sleep_us;
+	uint32_t wait_us;
+};
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+/**
+ * @brief Queues a task; its first step can run from the next delay
+ *
+ * @param task task with name, step and resources set; must stay valid
+ * until it is complete
+ *
+ * @return TEGRABL_NO_ERROR if queued, TEGRABL_ERR_INVALID if already queued
+ */
+tegrabl_error_t tegrabl_task_add(struct tegrabl_task *task);
+
+/**
+ * @brief From a step: do not run the next step before usec have passed
+ */
+void tegrabl_task_sleep(struct tegrabl_task *task, uint32_t usec);
+
+/**
+ * @brief Whether a task is queued and not yet complete
+ */
+bool tegrabl_task_pending(const struct tegrabl_task *task);
+
+/**
+ * @brief Runs a task to completion, other ready tasks run while it sleeps
+ *
+ * @param task queued or completed task
+ *
+ * @return result of the task, TEGRABL_ERR_NOT_STARTED if it was never
+ * queued, TEGRABL_ERR_INVALID if called from a step or with a resource
+ * of the task claimed
+ */
+tegrabl_error_t tegrabl_task_wait(struct tegrabl_task *task);
+
+/**
+ * @brief Runs all queued tasks to completion
+ *
+ * @return first error of the tasks waited for
+ */
+tegrabl_error_t tegrabl_task_wait_all(void);
+
+/**
+ * @brief Runs one step of a ready task that fits in budget_us.
+ * Called by the delay loops.
+ */
+void tegrabl_task_yield(time_t budget_us);
+
+/**
+ * @brief Marks resources as in use, holding back tasks that need them
+ *
+ * @return the resources that were not claimed yet, to be passed to
+ * tegrabl_task_release()
+ */
+uint32_t tegrabl_task_claim(uint32_t resources);
+
+/**
+ * @brief Releases what tegrabl_task_claim() returned
+ */
+void tegrabl_task_release(uint32_t resources);
+
+/**
+ * @brief Starts a section in which delays run no task steps. Sections nest.
+ */
+void tegrabl_task_no_yield_begin(void);
+
+/**
+ * @brief Ends what tegrabl_task_no_yield_begin() started
+ */
+void tegrabl_task_no_yield_end(void);
+
+/**
+ * @brief Prints the steps, busy, sleep and wait time of every task added
+ * so far and the wall time saved by running them inside other delays
+ */
+void tegrabl_task_trace_dump(void);
+#else
+
+static inline void tegrabl_task_yield(time_t budget_us)
+{
+	TEGRABL_UNUSED(budget_us);
+}
+
+static inline uint32_t tegrabl_task_claim(uint32_t resources)
+{
+	TEGRABL_UNUSED(resources);
+
+	return 0;
+}
+
+static inline void tegrabl_task_release(uint32_t resources)
+{
+	TEGRABL_UNUSED(resources);
+}
+
+static inline void tegrabl_task_no_yield_begin(void)
+{
+}
+
+static inline void tegrabl_task_no_yield_end(void)
+{
+}
+
+#endif /* CONFIG_ENABLE_DEFERRED_TASKS */
+
+#endif /* TEGRABL_TASK_H */
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2020, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Best-fit allocator over the free DRAM extents. Private to
+ * linuxboot_helper.c and kept free of target dependencies so that
+ * tests/linuxboot_dram_arena_test.c can build it on the host. Include after
+ * the headers providing stdint/stdbool, inttypes, memmove(), pr_error(),
+ * pr_debug(), PAGE_SIZE, tegrabl_error_t with TEGRABL_ERROR() and
+ * struct tegrabl_linuxboot_memblock.
+ */
+
+#ifndef INCLUDED_LINUXBOOT_DRAM_ARENA_H
+#define INCLUDED_LINUXBOOT_DRAM_ARENA_H
+
+/*
+ * Unallocated extents are kept in free[] sorted by (size, base) so that a
+ * best-fit lookup is a binary search. The allocations themselves are only
+ * tracked to be able to free and shrink them. Each allocation splits at
+ * most one free extent into two, so free[] needs room for the initial
+ * extents plus max_allocs.
+ */
+struct dram_arena {
+	struct tegrabl_linuxboot_memblock *free;
+	uint32_t free_count;
+	uint32_t max_free;
+	struct tegrabl_linuxboot_memblock *allocs;
+	uint32_t alloc_count;
+	uint32_t max_allocs;
+	/* Called on a range before it is handed out, NULL if nothing to do */
+	tegrabl_error_t (*prepare)(uint64_t base, uint64_t size);
+};
+
+static inline uint64_t dram_arena_align(uint64_t x, uint64_t align)
+{
+	return (x + align - 1U) & ~(align - 1U);
+}
+
+static inline bool dram_extent_is_before(
+		const struct tegrabl_linuxboot_memblock *a, uint64_t size,
+		uint64_t base)
+{
+	return (a->size < size) || ((a->size == size) && (a->base < base));
+}
+
+/* Index of the first extent not ordered before (size, base) */
+static inline uint32_t dram_extent_lower_bound(const struct dram_arena *arena,
+											   uint64_t size, uint64_t base)
+{
+	uint32_t lo = 0;
+	uint32_t hi = arena->free_count;
+	uint32_t mid;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / 2U);
+		if (dram_extent_is_before(&arena->free[mid], size, base)) {
+			lo = mid + 1U;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static inline void dram_extent_remove(struct dram_arena *arena, uint32_t idx)
+{
+	memmove(&arena->free[idx], &arena->free[idx + 1U],
+			(arena->free_count - idx - 1U) * sizeof(arena->free[0]));
+	arena->free_count--;
+}
+
+static inline tegrabl_error_t dram_extent_insert(struct dram_arena *arena,
+												 uint64_t base, uint64_t size)
+{
+	uint32_t idx;
+
+	if (size == 0U) {
+		return TEGRABL_NO_ERROR;
+	}
+
+	if (arena->free_count == arena->max_free) {
+		return TEGRABL_ERROR(TEGRABL_ERR_OVERFLOW, 0);
+	}
+
+	idx = dram_extent_lower_bound(arena, size, base);
+	memmove(&arena->free[idx + 1U], &arena->free[idx],
+			(arena->free_count - idx) * sizeof(arena->free[0]));
+	arena->free[idx].base = base;
+	arena->free[idx].size = size;
+	arena->free_count++;
+
+	return TEGRABL_NO_ERROR;
+}
+
+/* Reset the arena to the given free regions, dropping all allocations */
+static inline void dram_arena_init(struct dram_arena *arena,
+								   const struct tegrabl_linuxboot_memblock
+								   regions[], uint32_t count)
+{
+	uint32_t i;
+
+	arena->free_count = 0;
+	arena->alloc_count = 0;
+
+	for (i = 0; i < count; i++) {
+		(void)dram_extent_insert(arena, regions[i].base, regions[i].size);
+	}
+}
+
+/*
+ * Carve [addr, addr + size) out of free extent idx and record it as
+ * allocated. The range must lie within that extent. Every check, and the
+ * prepare hook, runs before the extent list is touched so that a failure
+ * leaves the arena unchanged.
+ */
+static inline tegrabl_error_t dram_arena_carve(struct dram_arena *arena,
+											   uint32_t idx, uint64_t addr,
+											   uint64_t size)
+{
+	struct tegrabl_linuxboot_memblock extent;
+	uint64_t head, tail;
+	uint32_t pieces;
+	tegrabl_error_t err;
+
+	if (arena->alloc_count == arena->max_allocs) {
+		pr_error("Too many dram allocations\n");
+		return TEGRABL_ERROR(TEGRABL_ERR_OVERFLOW, 1);
+	}
+
+	extent = arena->free[idx];
+	head = addr - extent.base;
+	tail = extent.base + extent.size - addr - size;
+
+	/* The extent is replaced by its non-empty head and tail */
+	pieces = ((head != 0U) ? 1U : 0U) + ((tail != 0U) ? 1U : 0U);
+	if ((arena->free_count - 1U + pieces) > arena->max_free) {
+		pr_error("Too many free dram extents\n");
+		return TEGRABL_ERROR(TEGRABL_ERR_OVERFLOW, 2);
+	}
+
+	if (arena->prepare != NULL) {
+		err = arena->prepare(addr, size);
+		if (err != TEGRABL_NO_ERROR) {
+			return err;
+		}
+	}
+
+	dram_extent_remove(arena, idx);
+	(void)dram_extent_insert(arena, extent.base, head);
+	(void)dram_extent_insert(arena, addr + size, tail);
+
+	arena->allocs[arena->alloc_count].base = addr;
+	arena->allocs[arena->alloc_count].size = size;
+	arena->alloc_count++;
+
+	return TEGRABL_NO_ERROR;
+}
+
+/*
+ * Best-fit allocation of size bytes aligned to align (a power of two), which
+ * ends at or below limit. Returns 0 if no free extent can hold it. The size
+ * is rounded up to whole pages, so that extents stay page aligned.
+ */
+static inline uint64_t dram_arena_alloc(struct dram_arena *arena,
+										uint64_t size, uint64_t align,
+										uint64_t limit)
+{
+	struct tegrabl_linuxboot_memblock *extent;
+	uint64_t addr;
+	uint32_t i;
+
+	if ((size == 0U) || (align == 0U) || ((align & (align - 1U)) != 0U) ||
+		(dram_arena_align(size, PAGE_SIZE) < size)) {
+		return 0;
+	}
+	size = dram_arena_align(size, PAGE_SIZE);
+
+	/* Smallest extent which fits, skip those that fail only due to padding */
+	for (i = dram_extent_lower_bound(arena, size, 0); i < arena->free_count;
+		 i++) {
+		extent = &arena->free[i];
+		addr = dram_arena_align(extent->base, align);
+		if ((addr < extent->base) || (addr + size < addr) ||
+			(addr + size > extent->base + extent->size) ||
+			(addr + size > limit)) {
+			continue;
+		}
+
+		if (dram_arena_carve(arena, i, addr, size) != TEGRABL_NO_ERROR) {
+			return 0;
+		}
+
+		return addr;
+	}
+
+	return 0;
+}
+
+/* Allocate exactly [addr, addr + size) if it is entirely free */
+static inline bool dram_arena_claim(struct dram_arena *arena, uint64_t addr,
+									uint64_t size)
+{
+	struct tegrabl_linuxboot_memblock *extent;
+	uint32_t i;
+
+	for (i = 0; i < arena->free_count; i++) {
+		extent = &arena->free[i];
+		if ((addr >= extent->base) &&
+			(addr + size <= extent->base + extent->size)) {
+			return dram_arena_carve(arena, i, addr, size) == TEGRABL_NO_ERROR;
+		}
+	}
+
+	return false;
+}
+
+/* Return [base, base + size) to the free extents, merging with neighbours */
+static inline void dram_arena_release(struct dram_arena *arena, uint64_t base,
+									  uint64_t size)
+{
+	uint32_t i = 0;
+
+	while (i < arena->free_count) {
+		if (arena->free[i].base + arena->free[i].size == base) {
+			base = arena->free[i].base;
+			size += arena->free[i].size;
+			dram_extent_remove(arena, i);
+		} else if (arena->free[i].base == base + size) {
+			size += arena->free[i].size;
+			dram_extent_remove(arena, i);
+		} else {
+			i++;
+		}
+	}
+
+	(void)dram_extent_insert(arena, base, size);
+}
+
+/* Free the allocation at addr; unknown addresses are ignored */
+static inline void dram_arena_free(struct dram_arena *arena, uint64_t addr)
+{
+	struct tegrabl_linuxboot_memblock block;
+	uint32_t i;
+
+	for (i = 0; i < arena->alloc_count; i++) {
+		if (arena->allocs[i].base == addr) {
+			break;
+		}
+	}
+	if (i == arena->alloc_count) {
+		return;
+	}
+
+	block = arena->allocs[i];
+	arena->allocs[i] = arena->allocs[arena->alloc_count - 1U];
+	arena->alloc_count--;
+
+	dram_arena_release(arena, block.base, block.size);
+}
+
+/* Give back the tail of the allocation at addr beyond new_size bytes */
+static inline void dram_arena_shrink(struct dram_arena *arena, uint64_t addr,
+									 uint64_t new_size)
+{
+	uint64_t slack;
+	uint32_t i;
+
+	new_size = dram_arena_align(new_size, PAGE_SIZE);
+	for (i = 0; i < arena->alloc_count; i++) {
+		if (arena->allocs[i].base != addr) {
+			continue;
+		}
+		if ((new_size == 0U) || (new_size >= arena->allocs[i].size)) {
+			return;
+		}
+		slack = arena->allocs[i].size - new_size;
+		arena->allocs[i].size = new_size;
+		dram_arena_release(arena, addr + new_size, slack);
+		pr_debug("Released 0x%"PRIx64" bytes at 0x%"PRIx64"\n", slack,
+				 addr + new_size);
+		return;
+	}
+}
+
+#endif /* INCLUDED_LINUXBOOT_DRAM_ARENA_H */
@@ -47,6 +47,26 @@
 #include <tegrabl_partition_loader.h>
 #include <tegrabl_gpt.h>
 #include <tegrabl_sigheader.h>
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB)
+#include <tegrabl_vic.h>
+#endif
+#if defined(CONFIG_ENABLE_BPMP_IPC_TRACE)
+#include <tegrabl_bpmp_trace.h>
+#endif
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+#include <tegrabl_profiler_span.h>
+#endif
+#if defined(CONFIG_ENABLE_POLL_STATS)
+#include <tegrabl_poll.h>
+#endif
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+#include <tegrabl_task.h>
+#endif
+#if defined(CONFIG_ENABLE_ARCH_TIMER_UDELAY)
+#include <tegrabl_arch_timer.h>
+#endif
+#include "linuxboot_memmap.h"
+#include "linuxboot_dram_arena.h"
 
 #define SDRAM_START_ADDRESS			0x80000000
 
@@ -71,8 +91,15 @@
 
 #endif
 
+/*
+ * With lazy scrubbing only DRAM handed out by the load address allocator is
+ * scrubbed by the bootloader, the rest is reported to the kernel.
+ */
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB) && !defined(CONFIG_DYNAMIC_LOAD_ADDRESS)
+#error "CONFIG_ENABLE_LAZY_DRAM_SCRUB requires CONFIG_DYNAMIC_LOAD_ADDRESS"
+#endif
+
 extern struct tboot_cpubl_params *boot_params;
-static struct tegrabl_linuxboot_memblock *update_bad_page(void);
 struct tegrabl_carveout_info *p_carveout = NULL;
 
 static int add_tegraid(char *cmdline, int len, char *param, void *priv)
@@ -449,6 +476,26 @@ static int add_profiler_carveout(char *cmdline, int len,
 	return ret;
 }
 
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+static uint64_t profiler_span_carveout(uint32_t *size);
+
+static int add_profiler_span_log(char *cmdline, int len,
+								 char *param, void *priv)
+{
+	uint64_t addr;
+	uint32_t size = 0;
+	TEGRABL_UNUSED(priv);
+
+	addr = profiler_span_carveout(&size);
+	if (addr == 0U) {
+		return 0;
+	}
+
+	return tegrabl_snprintf(cmdline, len, "%s=0x%" PRIx32 "@0x%08" PRIx64 " ",
+							param, size, addr);
+}
+#endif
+
 static int tegrabl_linuxboot_add_nvdec_enabled_info(char *cmdline, int len,
 	char *param, void *priv)
 {
@@ -537,6 +584,9 @@ static struct tegrabl_linuxboot_param extra_params[] = {
 	{ "vpr", tegrabl_linuxboot_add_vpr_info, NULL },
 	{ "vpr_resize", tegrabl_linuxboot_add_vprresize_info, NULL },
 	{ "bl_prof_dataptr", add_profiler_carveout, NULL},
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+	{ "bl_prof_spanptr", add_profiler_span_log, NULL},
+#endif
 	{ "sdhci_tegra.en_boot_part_access", tegrabl_linuxboot_add_string, "1" },
 	{ "nvdec_enabled", tegrabl_linuxboot_add_nvdec_enabled_info, NULL },
 	{ NULL, NULL, NULL},
@@ -904,156 +954,65 @@ fail:
 	return err;
 }
 
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+static uint32_t dt_patch_span = TEGRABL_PROF_SPAN_NONE;
+
+static tegrabl_error_t add_profiler_span_carveout(void *fdt, int nodeoffset);
+#endif
+
+#if defined(CONFIG_DRAM_BAD_PAGES_IN_RESERVED_MEMORY)
+static tegrabl_error_t add_dram_bad_page_info(void *fdt, int nodeoffset);
+#endif
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB)
+static tegrabl_error_t add_dram_scrub_info(void *fdt, int nodeoffset);
+#endif
+
+static tegrabl_error_t linuxboot_pre_handoff(void *fdt, int nodeoffset);
+
 static struct tegrabl_linuxboot_dtnode_info extra_nodes[] = {
 	{ "chosen", add_pmc_reset_info},
 	{ "chosen", add_pmic_reset_info},
 	{ "chosen", add_ecid_info},
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB)
+	{ "chosen", add_dram_scrub_info},
+#endif
 	{ "cpus" , disable_floorswept_cpus },
 	{ "reserved-memory", update_vpr_info},
 	{ "reserved-memory", update_ramoops_info},
 	{ "reserved-memory", update_gamedata_info},
+#if defined(CONFIG_DRAM_BAD_PAGES_IN_RESERVED_MEMORY)
+	{ "reserved-memory", add_dram_bad_page_info},
+#endif
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+	{ "reserved-memory", add_profiler_span_carveout},
+#endif
+	/* Must stay last, see linuxboot_pre_handoff() */
+	{ "chosen", linuxboot_pre_handoff},
 	{ NULL, NULL},
 };
 
-static int bom_compare(const uint32_t a, const uint32_t b)
-{
-	p_carveout = (struct tegrabl_carveout_info *)(boot_params->global_data.carveout);
-
-	if (p_carveout[a].base < p_carveout[b].base)
-		return -1;
-	else if (p_carveout[a].base > p_carveout[b].base)
-		return 1;
-	else
-		return 0;
-}
-
-static void sort(uint32_t array[], int32_t count)
-{
-	uint32_t val;
-	int32_t i;
-	int32_t j;
-
-	if (count < 2)
-		return;
-
-	for (i = 1; i < count; i++) {
-		val = array[i];
-
-		for (j = (i - 1);
-				 (j >= 0) && (bom_compare(val, array[j]) < 0);
-				 j--) {
-			array[j + 1] = array[j];
-		}
-
-		array[j + 1] = val;
-	}
-}
-
-static void sort_array(uint64_t arr[], uint64_t count)
-{
-	uint64_t i, j, temp;
-
-	if (count == 0)
-		return;
-
-	for (i = 0; i < count-1; i++) {
-		for (j = 0; j < count - i - 1; j++) {
-			if (arr[j] > arr[j+1]) {
-				temp = arr[j];
-				arr[j] = arr[j+1];
-				arr[j+1] = temp;
-			}
-		}
-	}
-}
-
-static struct tegrabl_linuxboot_memblock free_block[CARVEOUT_NUM + 1];
 static struct tegrabl_linuxboot_memblock free_dram_block[CARVEOUT_NUM + NUM_DRAM_BAD_PAGES + 1];
-static uint32_t free_dram_block_count;
-
-static struct tegrabl_linuxboot_memblock *update_bad_page()
-{
-	uint64_t *bad_page_arr = NULL;
-	uint64_t bad_page_count = 0;
-	uint64_t chunk_idx, page_idx, rgn, temp_size;
-
-	bad_page_arr = (uint64_t *)(boot_params->global_data.dram_bad_pages);
-	bad_page_count = boot_params->global_data.valid_dram_bad_page_count;
-
-	if (bad_page_count > 1)
-		sort_array(bad_page_arr, bad_page_count);
-
-	chunk_idx = 0;
-	rgn = 0;
-
-	for (page_idx = 0; page_idx < bad_page_count; page_idx++) {
-		while (chunk_idx < free_dram_block_count) {
-			/*
-			 * free_dram_block is 0 initialized in BSS
-			 * if the free_dram_block was split due to a bad page,
-			 * free_dram_block would be non zero
-			 */
-			if ((free_dram_block[rgn].base == 0) &&
-					(free_dram_block[rgn].size == 0)) {
-				free_dram_block[rgn].base = free_block[chunk_idx].base;
-				free_dram_block[rgn].size = free_block[chunk_idx].size;
-			}
-			if (bad_page_arr[page_idx] == free_dram_block[rgn].base) {
-				free_dram_block[rgn].base = free_dram_block[rgn].base + PAGE_SIZE;
-				free_dram_block[rgn].size = free_dram_block[rgn].size - PAGE_SIZE;
-				break;
-			}
-			if (bad_page_arr[page_idx] ==
-					free_dram_block[rgn].base + free_dram_block[rgn].size - PAGE_SIZE) {
-				free_dram_block[rgn].size = free_dram_block[rgn].size - PAGE_SIZE;
-				break;
-			}
-			if (bad_page_arr[page_idx] > free_dram_block[rgn].base &&
-			    bad_page_arr[page_idx] < free_dram_block[rgn].base + free_dram_block[rgn].size) {
-				temp_size = free_dram_block[rgn].size;
-				free_dram_block[rgn].size = bad_page_arr[page_idx] - free_dram_block[rgn].base;
-
-				rgn += 1;
-				free_dram_block[rgn].base =
-					free_dram_block[rgn - 1].base + free_dram_block[rgn - 1].size + PAGE_SIZE;
-				free_dram_block[rgn].size = temp_size - free_dram_block[rgn - 1].size - PAGE_SIZE;
-				break;
-			}
-			chunk_idx++;
-			rgn++;
-		}
-	}
-	/* If there was at least one bad page, move to next chunk and rgn */
-	if (bad_page_count > 0) {
-		chunk_idx++;
-		rgn++;
-	}
-	/* Add rest of the memory chunks */
-	while (chunk_idx < free_dram_block_count) {
-		free_dram_block[rgn].base = free_block[chunk_idx].base;
-		free_dram_block[rgn].size = free_block[chunk_idx].size;
-		chunk_idx++;
-		rgn++;
-	}
-
-	free_dram_block_count = rgn;
-	return free_dram_block;
-}
+static struct tegrabl_linuxboot_memblock dram_region_block[CARVEOUT_NUM + 1];
+static struct linuxboot_memmap dram_map = {
+	.free = free_dram_block,
+	.region = dram_region_block,
+};
 
 static uint32_t calculate_free_dram_regions(struct tegrabl_linuxboot_memblock
 		**free_dram_regions)
 {
 	carve_out_type_t cotype;
-	int32_t i, rgn;
-	int32_t count;
-	uint64_t cur_start, cur_end, sdram_size;
-	uint32_t perm_carveouts[CARVEOUT_NUM];
+	uint32_t count;
+	uint64_t sdram_size;
+	uint64_t *bad_page_arr = NULL;
+	uint64_t bad_page_count = 0;
+	struct tegrabl_linuxboot_memblock perm_carveouts[CARVEOUT_NUM];
 
 	if (p_carveout != NULL) {
 		/* We calculate all free DRAM regions at once,
 		 * If called again, just return*/
-		*free_dram_regions = free_dram_block;
-		return free_dram_block_count;
+		*free_dram_regions = dram_map.free;
+		return dram_map.free_count;
 	}
 
 	p_carveout = (struct tegrabl_carveout_info *)(boot_params->global_data.carveout);
@@ -1077,48 +1036,183 @@ static uint32_t calculate_free_dram_regions(struct tegrabl_linuxboot_memblock
 		case CARVEOUT_BO_MTS_PACKAGE:
 			break;
 		default:
-			perm_carveouts[count] = (uint32_t)cotype;
+			perm_carveouts[count].base = p_carveout[cotype].base;
+			perm_carveouts[count].size = p_carveout[cotype].size;
 			count++;
 			break;
 		}
 	}
 
-	/* Sort the carveouts in increasing order of their base */
-	sort(perm_carveouts, count);
-
-	/* Determine the free regions */
-	cur_start = SDRAM_START_ADDRESS;
-	rgn = 0;
-
-	for (i = 0; i < count; i++) {
-		cur_end = p_carveout[perm_carveouts[i]].base;
-		if (cur_end > cur_start) {
-			pr_debug("[%d] START: 0x%"PRIx64", END: 0x%"PRIx64"\n",
-					 rgn, cur_start, cur_end);
-			free_block[rgn].base = cur_start;
-			free_block[rgn].size = cur_end - cur_start;
-			rgn++;
-		}
-		cur_start = p_carveout[perm_carveouts[i]].base +
-			p_carveout[perm_carveouts[i]].size;
+	bad_page_arr = (uint64_t *)(boot_params->global_data.dram_bad_pages);
+	bad_page_count = boot_params->global_data.valid_dram_bad_page_count;
+	if (bad_page_count > NUM_DRAM_BAD_PAGES) {
+		pr_warn("Invalid bad page count %"PRIu64", clamping\n", bad_page_count);
+		bad_page_count = NUM_DRAM_BAD_PAGES;
 	}
 
 	sdram_size = NV_READ32(NV_ADDRESS_MAP_MCB_BASE + MC_EMEM_CFG_0);
 	sdram_size = sdram_size << 20;
-	cur_end = SDRAM_START_ADDRESS + sdram_size;
-	if (cur_end > cur_start) {
-		pr_debug("[%d] START: 0x%"PRIx64", END: 0x%"PRIx64"\n",
-				 rgn, cur_start, cur_end);
-		free_block[rgn].base = cur_start;
-		free_block[rgn].size = cur_end - cur_start;
-		rgn++;
-	}
-	free_dram_block_count = rgn;
-	*free_dram_regions = update_bad_page();
-
-	return free_dram_block_count;
+
+	/* Sorts the carveouts and the bad page list in place */
+	build_memmap(&dram_map, SDRAM_START_ADDRESS,
+				 SDRAM_START_ADDRESS + sdram_size, perm_carveouts, count,
+				 bad_page_arr, bad_page_count);
+
+	*free_dram_regions = dram_map.free;
+
+	return dram_map.free_count;
 }
 
+#if defined(CONFIG_DRAM_BAD_PAGES_IN_RESERVED_MEMORY)
+/* Max number of ranges bad pages are exported as under reserved-memory */
+#define DRAM_BAD_PAGE_MAX_RANGES	16U
+
+/*
+ * Bad pages closer than this are reserved together with the good pages
+ * between them; the distance is doubled up to the max to fit the ranges,
+ * so at most a few good pages are lost per range.
+ */
+#define DRAM_BAD_PAGE_MERGE_GAP		PAGE_SIZE
+#define DRAM_BAD_PAGE_MAX_MERGE_GAP	(4U * PAGE_SIZE)
+
+/*
+ * Number of ranges the bad pages merge into at the smallest gap, up to
+ * DRAM_BAD_PAGE_MAX_MERGE_GAP, at which they fit in
+ * DRAM_BAD_PAGE_MAX_RANGES; more than that if they do not fit at all.
+ * Expects calculate_free_dram_regions() to have run.
+ */
+static uint32_t plan_bad_page_ranges(uint64_t *gap)
+{
+	uint64_t *bad_page_arr;
+	uint64_t bad_page_count;
+	uint32_t count;
+
+	bad_page_arr = (uint64_t *)(boot_params->global_data.dram_bad_pages);
+	bad_page_count = boot_params->global_data.valid_dram_bad_page_count;
+	if (bad_page_count > NUM_DRAM_BAD_PAGES) {
+		bad_page_count = NUM_DRAM_BAD_PAGES;
+	}
+
+	*gap = DRAM_BAD_PAGE_MERGE_GAP;
+	count = merge_bad_pages(&dram_map, bad_page_arr, bad_page_count, *gap,
+							NULL, 0);
+	while ((count > DRAM_BAD_PAGE_MAX_RANGES) &&
+		   (*gap < DRAM_BAD_PAGE_MAX_MERGE_GAP)) {
+		*gap <<= 1;
+		count = merge_bad_pages(&dram_map, bad_page_arr, bad_page_count, *gap,
+							NULL, 0);
+	}
+
+	return count;
+}
+
+/* Whether the bad pages fit in the reserved-memory node */
+static bool dram_bad_pages_reservable(void)
+{
+	uint64_t gap;
+
+	return plan_bad_page_ranges(&gap) <= DRAM_BAD_PAGE_MAX_RANGES;
+}
+
+/* Set once the dram-bad-pages node is in the kernel DT */
+static bool dram_bad_pages_reserved;
+
+/*
+ * Export bad pages as a single no-map node under reserved-memory. Nearby bad
+ * pages are merged so that the kernel sees a handful of reserved ranges
+ * instead of one memblock split per bad page. If they do not fit even at
+ * the largest merge distance, no node is added and the memory map carves
+ * the bad pages out instead.
+ */
+static tegrabl_error_t add_dram_bad_page_info(void *fdt, int nodeoffset)
+{
+	static uint64_t reg[2U * DRAM_BAD_PAGE_MAX_RANGES];
+	struct tegrabl_linuxboot_memblock *free_dram_regions = NULL;
+	uint64_t *bad_page_arr;
+	uint64_t bad_page_count;
+	uint64_t gap;
+	uint32_t count;
+	int node;
+	int dterr;
+
+	if (dram_bad_pages_reserved) {
+		return TEGRABL_NO_ERROR;
+	}
+
+	/* Sorts the bad page list as a side effect */
+	calculate_free_dram_regions(&free_dram_regions);
+
+	count = plan_bad_page_ranges(&gap);
+	if (count == 0U) {
+		return TEGRABL_NO_ERROR;
+	}
+	if (count > DRAM_BAD_PAGE_MAX_RANGES) {
+		pr_error("Bad pages need %u ranges at merge gap 0x%"PRIx64", more "
+				 "than %u; carved out of the memory map instead\n", count, gap,
+				 DRAM_BAD_PAGE_MAX_RANGES);
+		return TEGRABL_ERROR(TEGRABL_ERR_OVERFLOW, 0);
+	}
+
+	bad_page_arr = (uint64_t *)(boot_params->global_data.dram_bad_pages);
+	bad_page_count = boot_params->global_data.valid_dram_bad_page_count;
+	if (bad_page_count > NUM_DRAM_BAD_PAGES) {
+		bad_page_count = NUM_DRAM_BAD_PAGES;
+	}
+	merge_bad_pages(&dram_map, bad_page_arr, bad_page_count, gap, reg,
+					DRAM_BAD_PAGE_MAX_RANGES);
+
+	node = tegrabl_add_subnode_if_absent(fdt, nodeoffset, "dram-bad-pages");
+	if (node < 0) {
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 0);
+	}
+
+	dterr = fdt_setprop(fdt, node, "reg", reg, count * 2U * sizeof(uint64_t));
+	if (dterr < 0) {
+		pr_error("Failed to set reg for dram-bad-pages node: %s\n",
+				 fdt_strerror(dterr));
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 1);
+	}
+
+	dterr = fdt_setprop(fdt, node, "no-map", NULL, 0);
+	if (dterr < 0) {
+		pr_error("Failed to set no-map for dram-bad-pages node: %s\n",
+				 fdt_strerror(dterr));
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 2);
+	}
+
+	pr_info("Reserved %"PRIu64" bad pages as %u ranges (merge gap 0x%"PRIx64")\n",
+			bad_page_count, count, gap);
+
+	dram_bad_pages_reserved = true;
+
+	return TEGRABL_NO_ERROR;
+}
+
+/*
+ * The memory map is asked for before the reserved-memory fixups run, so
+ * write the node up front; the unsplit map is only handed out once it is
+ * there.
+ */
+static void reserve_dram_bad_pages_early(void)
+{
+	void *fdt;
+	int node;
+
+	if (dram_bad_pages_reserved || !dram_bad_pages_reservable()) {
+		return;
+	}
+	if (tegrabl_dt_get_fdt_handle(TEGRABL_DT_KERNEL, &fdt) !=
+		TEGRABL_NO_ERROR) {
+		return;
+	}
+	if (tegrabl_dt_get_node_with_path(fdt, "/reserved-memory", &node) !=
+		TEGRABL_NO_ERROR) {
+		return;
+	}
+	(void)add_dram_bad_page_info(fdt, node);
+}
+#endif
+
 uint32_t get_free_dram_regions_info(struct tegrabl_linuxboot_memblock
 		**free_dram_regions)
 {
@@ -1126,152 +1220,213 @@ uint32_t get_free_dram_regions_info(struct tegrabl_linuxboot_memblock
 }
 
 #if defined(CONFIG_DYNAMIC_LOAD_ADDRESS)
-/* Structure used for accounting free dram region allocation */
-struct dram_alloc {
-	void *start;
-	uint64_t size;
-	struct dram_alloc *next;
-};
+/* Max number of outstanding allocations from the free dram regions */
+#define DRAM_ARENA_MAX_ALLOCS		32U
 
-/* Base of linked list used for keeping track of used free dram region */
-static struct dram_alloc dram_alloc_base;
+/* Each allocation splits at most one free extent into two */
+#define DRAM_ARENA_MAX_EXTENTS		(CARVEOUT_NUM + NUM_DRAM_BAD_PAGES + 1U + \
+									 DRAM_ARENA_MAX_ALLOCS)
 
-/*
- * Returns true if provided addr region can be used as is.
- * Returns false if addr is already allocated. available_addr will be updated
- * with an address that is not allocated.
- */
-static bool is_dram_address_free(void *addr, uint64_t size, void **available_addr)
-{
-	struct dram_alloc *ptr_alloc = &dram_alloc_base;
-	void *alloc_addr_start;
-	void *alloc_addr_end;
-	void *addr_end;
-	bool ret = true;
+static struct tegrabl_linuxboot_memblock dram_free_extents[DRAM_ARENA_MAX_EXTENTS];
+static struct tegrabl_linuxboot_memblock dram_allocs[DRAM_ARENA_MAX_ALLOCS];
 
-	/* Loop through all allocated regions */
-	while (ptr_alloc) {
-		alloc_addr_start = ptr_alloc->start;
-		alloc_addr_end = alloc_addr_start + ptr_alloc->size;
-		addr_end = addr + size;
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB)
+/* The boot-time scrub skipped free DRAM, clean it before first use */
+static tegrabl_error_t dram_arena_scrub(uint64_t base, uint64_t size)
+{
+	tegrabl_error_t err;
 
-		/*
-		 * Check if the addresses overlap
-		 * 1. Is allocated address region overlapping with input range
-		 * 2. Is input region part of any allocated address region
-		 */
-		if ((((alloc_addr_start >= addr) && (alloc_addr_start <= addr_end)) ||
-				((alloc_addr_end >= addr) && (alloc_addr_end <= addr_end)))	||
-		    (((addr >= alloc_addr_start) && (addr <= alloc_addr_end))		||
-				((addr_end >= alloc_addr_start) && (addr_end <= alloc_addr_end)))) {
-			ret = false;
-			/* If addr is allocated, suggest next page after this region */
-			addr = alloc_addr_end + PAGE_SIZE;
-		}
-		ptr_alloc = ptr_alloc->next;
+	err = cb_vic_scrub_region(base, size);
+	if (err != TEGRABL_NO_ERROR) {
+		pr_error("Failed to scrub 0x%"PRIx64"@0x%"PRIx64"\n", size, base);
 	}
-	if (available_addr != NULL) {
-		*available_addr = addr;
+
+	return err;
+}
+#endif
+
+/* Allocator over free_dram_block, see linuxboot_dram_arena.h */
+static struct dram_arena dram_arena = {
+	.free = dram_free_extents,
+	.max_free = DRAM_ARENA_MAX_EXTENTS,
+	.allocs = dram_allocs,
+	.max_allocs = DRAM_ARENA_MAX_ALLOCS,
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB)
+	/* Page-aligned allocations are scrubbed by VIC rather than the CPU */
+	.prepare = dram_arena_scrub,
+#endif
+};
+static bool dram_arena_ready;
+
+/* Reset the allocator to the full set of free dram regions */
+static void dram_arena_reset(void)
+{
+	struct tegrabl_linuxboot_memblock *regions = NULL;
+	uint32_t count;
+
+	count = calculate_free_dram_regions(&regions);
+	dram_arena_init(&dram_arena, regions, count);
+	dram_arena_ready = true;
+}
+
+/* The allocator, set up on first use */
+static struct dram_arena *dram_arena_get(void)
+{
+	if (!dram_arena_ready) {
+		dram_arena_reset();
 	}
 
-	return ret;
+	return &dram_arena;
 }
 
-/* Add dram address range to a sorted linked list */
-static void alloc_dram_free_region(void *addr, uint64_t size)
+/* Aligned allocation, preferring memory addressable by 32-bit loaders */
+static uint64_t dram_alloc_aligned(uint64_t size, uint64_t align)
 {
-	struct dram_alloc *ptr_alloc = &dram_alloc_base;
-	struct dram_alloc *ptr_temp = NULL;
+	uint64_t addr;
 
-	if (dram_alloc_base.start != NULL) {
-		/* Find the right position in sorted list */
-		while ((addr > (ptr_alloc->start + ptr_alloc->size)) && (ptr_alloc->next)) {
-			ptr_alloc = ptr_alloc->next;
-		}
-		ptr_temp = ptr_alloc->next;
-		ptr_alloc->next = tegrabl_malloc(sizeof(struct dram_alloc));
-		ptr_alloc = ptr_alloc->next;
+	addr = dram_arena_alloc(dram_arena_get(), size, align, U_BOOT_TOP);
+	if (addr == 0U) {
+		addr = dram_arena_alloc(dram_arena_get(), size, align, UINT64_MAX);
 	}
-	ptr_alloc->start = addr;
-	ptr_alloc->size = size;
-	ptr_alloc->next = ptr_temp;
+
+	return addr;
 }
 
 uint64_t tegrabl_get_free_dram_address(uint64_t size)
 {
-	void *address = NULL;
-	uint64_t i;
+	return dram_alloc_aligned(size, PAGE_SIZE);
+}
 
-	for (i = 0; i < free_dram_block_count; i++) {
-		if (free_dram_block[i].size >= size) {
-			/*
-			 * Check if free dram block is unallocated.
-			 * If not update address with free region available
-			 */
-			if (is_dram_address_free((void *)free_dram_block[i].base, size, &address)) {
-				alloc_dram_free_region((void *)address, size);
-				break;
-			} else {
-				/*
-				 * If free region updated in address is within
-				 * same free dram block, use it
-				 */
-				if ((address + size) < (void *)(free_dram_block[i].base + free_dram_block[i].size)) {
-					alloc_dram_free_region((void *)address, size);
-					break;
-				} else {
-					address = NULL;
-				}
-			}
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+static uint64_t prof_span_carveout;
+static uint32_t prof_span_carveout_size;
+
+/*
+ * Memory the span log is copied to for the kernel. The log itself lives in
+ * cboot memory, and no shared carveout has room for it.
+ */
+static uint64_t profiler_span_carveout(uint32_t *size)
+{
+	uint32_t log_size = 0;
+
+	if (prof_span_carveout == 0U) {
+		if (tegrabl_profiler_span_log(&log_size) == 0U) {
+			return 0;
+		}
+		prof_span_carveout = dram_alloc_aligned(log_size, PAGE_SIZE);
+		if (prof_span_carveout == 0U) {
+			pr_warn("No memory to hand the span log to the kernel\n");
+			return 0;
 		}
+		prof_span_carveout_size = log_size;
 	}
-	return (uint64_t)address;
+
+	*size = prof_span_carveout_size;
+	return prof_span_carveout;
 }
 
-/* Free memory allocations made while allocating dram free region */
-void tegrabl_dealloc_free_dram_region(void)
+static tegrabl_error_t add_profiler_span_carveout(void *fdt, int nodeoffset)
 {
-	struct dram_alloc *ptr_alloc = dram_alloc_base.next;
+	uint64_t reg[2];
+	uint64_t addr;
+	uint32_t size = 0;
+	int node;
+	int dterr;
+
+	addr = profiler_span_carveout(&size);
+	if (addr == 0U) {
+		return TEGRABL_NO_ERROR;
+	}
+
+	reg[0] = cpu_to_fdt64(addr);
+	reg[1] = cpu_to_fdt64((uint64_t)size);
+
+	node = tegrabl_add_subnode_if_absent(fdt, nodeoffset, "profiler-spans");
+	if (node < 0) {
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 3);
+	}
 
-	while (ptr_alloc) {
-		tegrabl_free(ptr_alloc);
-		ptr_alloc = ptr_alloc->next;
+	dterr = fdt_setprop(fdt, node, "reg", reg, sizeof(reg));
+	if (dterr < 0) {
+		pr_error("Failed to set reg for profiler-spans node: %s\n",
+				 fdt_strerror(dterr));
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 4);
 	}
+
+	return TEGRABL_NO_ERROR;
 }
+#endif
 
-void tegrabl_dealloc_dram_address(uint64_t addr)
+#if defined(CONFIG_ENABLE_LAZY_DRAM_SCRUB)
+/*
+ * Report the DRAM never handed out by the allocator, and hence never
+ * scrubbed, as chosen/dram-scrub/needs-scrub so that the kernel can scrub it
+ * lazily before use.
+ */
+static tegrabl_error_t add_dram_scrub_info(void *fdt, int nodeoffset)
 {
-	struct dram_alloc *ptr_alloc = &dram_alloc_base;
-	struct dram_alloc *ptr_prev = NULL;
-	void *address = (void *)addr;
-
-	while (ptr_alloc) {
-		if (ptr_alloc->start == address) {
-			if (ptr_prev != NULL) {
-				ptr_prev->next = ptr_alloc->next;
-				tegrabl_free(ptr_alloc);
-			} else {
-				if (ptr_alloc->next != NULL) {
-					dram_alloc_base.start = ptr_alloc->next->start;
-					dram_alloc_base.size = ptr_alloc->next->size;
-					dram_alloc_base.next = ptr_alloc->next->next;
-					tegrabl_free(ptr_alloc->next);
-				} else {
-					dram_alloc_base.start = NULL;
-					dram_alloc_base.size = 0;
-					dram_alloc_base.next = NULL;
-				}
-			}
-			break;
+	static struct tegrabl_linuxboot_memblock extents[DRAM_ARENA_MAX_EXTENTS];
+	struct cb_vic_scrub_stats stats;
+	struct dram_arena *arena;
+	uint64_t *reg = (uint64_t *)extents;
+	uint64_t deferred = 0;
+	uint32_t count;
+	uint32_t i;
+	int node;
+	int dterr;
+
+	arena = dram_arena_get();
+	count = arena->free_count;
+	memcpy(extents, arena->free, count * sizeof(extents[0]));
+	sort_memblocks(extents, count);
+
+	/* Convert in place, each memblock is exactly one base/size pair */
+	for (i = 0; i < count; i++) {
+		deferred += extents[i].size;
+		reg[2U * i] = cpu_to_fdt64(extents[i].base);
+		reg[(2U * i) + 1U] = cpu_to_fdt64(extents[i].size);
 	}
-	ptr_prev = ptr_alloc;
-	ptr_alloc = ptr_alloc->next;
+
+	node = tegrabl_add_subnode_if_absent(fdt, nodeoffset, "dram-scrub");
+	if (node < 0) {
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 0);
 	}
+
+	dterr = fdt_setprop(fdt, node, "needs-scrub", reg,
+						count * 2U * sizeof(uint64_t));
+	if (dterr < 0) {
+		pr_error("Failed to set needs-scrub: %s\n", fdt_strerror(dterr));
+		return TEGRABL_ERROR(TEGRABL_ERR_ADD_FAILED, 1);
+	}
+
+	cb_vic_scrub_defer(deferred);
+	cb_vic_get_scrub_stats(&stats);
+	pr_info("DRAM scrub: %"PRIu64" KB eager, %"PRIu64" KB deferred to OS\n",
+			stats.bytes_scrubbed >> 10, stats.bytes_deferred >> 10);
+	/* Byte counts go in the aux field of the profiler records */
+	tegrabl_profiler_record("DRAM scrub eager", stats.bytes_scrubbed,
+							DETAILED);
+	tegrabl_profiler_record("DRAM scrub deferred", stats.bytes_deferred,
+							DETAILED);
+
+	return TEGRABL_NO_ERROR;
+}
+#endif
+
+/* Drop all allocations made from the free dram regions */
+void tegrabl_dealloc_free_dram_region(void)
+{
+	dram_arena_reset();
+}
+
+void tegrabl_dealloc_dram_address(uint64_t addr)
+{
+	dram_arena_free(dram_arena_get(), addr);
 }
 
 tegrabl_error_t tegrabl_alloc_u_boot_top(uint64_t size)
 {
-	uint64_t block = free_dram_block_count;
+	uint64_t block = dram_map.free_count;
 	uint64_t block_size = 0;
 	uint64_t block_base = 0;
 	tegrabl_error_t err = TEGRABL_ERR_NO_MEMORY;
@@ -1279,7 +1434,7 @@ tegrabl_error_t tegrabl_alloc_u_boot_top(uint64_t size)
 
 	/* align size to 2MB */
 	size += MEM_SZ_2MB;
-	for (i = 0; i < free_dram_block_count; i++) {
+	for (i = 0; i < dram_map.free_count; i++) {
 		if (free_dram_block[i].base > U_BOOT_TOP) {
 			if (i > 0) {
 				block = i - 1;
@@ -1295,11 +1450,10 @@ tegrabl_error_t tegrabl_alloc_u_boot_top(uint64_t size)
 			break;
 		}
 	}
-	if ((block < free_dram_block_count) && (block_size > size)) {
+	if ((block < dram_map.free_count) && (block_size > size)) {
 		/* Add memory region to used regions list */
-		if (is_dram_address_free((void *)block_base, size, NULL)) {
+		if (dram_arena_claim(dram_arena_get(), block_base, size)) {
 			err = TEGRABL_NO_ERROR;
-			alloc_dram_free_region((void *)block_base, size);
 			pr_info("Reserved memory at 0x%lx for U-Boot relocation\n", block_base);
 		}
 	}
@@ -1307,6 +1461,61 @@ tegrabl_error_t tegrabl_alloc_u_boot_top(uint64_t size)
 }
 #endif /* CONFIG_DYNAMIC_LOAD_ADDRESS */
 
+/*
+ * Pre-handoff hook: the last code run from the linuxboot path before the
+ * jump to the kernel. linuxboot offers no call of its own at that point, so
+ * it is the last entry of extra_nodes, after every DT fixup. The steps run
+ * in this order:
+ * 1. close the DT patching span, so it covers the fixups only;
+ * 2. finish the deferred tasks, which may still talk to BPMP and poll;
+ * 3. print the BPMP IPC and polling summaries, now that both are complete;
+ * 4. copy the span log to its carveout; later spans are not seen by the
+ *    kernel;
+ * 5. stop the arch timer udelay, since the steps above may still delay.
+ */
+static tegrabl_error_t linuxboot_pre_handoff(void *fdt, int nodeoffset)
+{
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+	uint64_t log;
+	uint64_t addr;
+	uint32_t size = 0;
+#endif
+
+	TEGRABL_UNUSED(fdt);
+	TEGRABL_UNUSED(nodeoffset);
+
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+	tegrabl_profiler_span_end(dt_patch_span, fdt_totalsize(fdt));
+	dt_patch_span = TEGRABL_PROF_SPAN_NONE;
+#endif
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+	tegrabl_task_wait_all();
+	tegrabl_task_trace_dump();
+#endif
+
+#if defined(CONFIG_ENABLE_BPMP_IPC_TRACE)
+	tegrabl_bpmp_trace_dump();
+#endif
+#if defined(CONFIG_ENABLE_POLL_STATS)
+	tegrabl_poll_stats_dump();
+#endif
+
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+	log = tegrabl_profiler_span_log(&size);
+	addr = profiler_span_carveout(&size);
+	if ((log != 0U) && (addr != 0U)) {
+		memcpy((void *)(uintptr_t)addr, (void *)(uintptr_t)log, size);
+	}
+#endif
+
+#if defined(CONFIG_ENABLE_ARCH_TIMER_UDELAY)
+	tegrabl_arch_timer_stop();
+#endif
+
+	return TEGRABL_NO_ERROR;
+}
+
 tegrabl_error_t tegrabl_linuxboot_helper_get_info(
 					tegrabl_linux_boot_info_t info,
 					const void *in_data, void *out_data)
@@ -1314,6 +1523,7 @@ tegrabl_error_t tegrabl_linuxboot_helper_get_info(
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
 	struct tegrabl_linuxboot_memblock *memblock;
 	struct tegrabl_linuxboot_memblock *free_dram_regions = NULL;
+	uint32_t num_regions;
 	uint32_t temp32;
 	uint64_t addr;
 
@@ -1334,6 +1544,13 @@ tegrabl_error_t tegrabl_linuxboot_helper_get_info(
 
 	case TEGRABL_LINUXBOOT_INFO_EXTRA_DT_NODES:
 		pr_debug("%s: extra_nodes: %p\n", __func__, extra_nodes);
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+		/* linuxboot applies the table next, closed by the pre-handoff hook */
+		if (dt_patch_span == TEGRABL_PROF_SPAN_NONE) {
+			dt_patch_span = tegrabl_profiler_span_begin(
+				"DT patching", TEGRABL_PROF_SPAN_NO_MODULE);
+		}
+#endif
 		*(struct tegrabl_linuxboot_dtnode_info **)out_data = extra_nodes;
 		break;
 
@@ -1406,9 +1623,23 @@ tegrabl_error_t tegrabl_linuxboot_helper_get_info(
 		temp32 = *((uint32_t *)in_data);
 		memblock = (struct tegrabl_linuxboot_memblock *)out_data;
 
-		free_dram_block_count = calculate_free_dram_regions(&free_dram_regions);
+		num_regions = calculate_free_dram_regions(&free_dram_regions);
 
-		if (temp32 >= free_dram_block_count) {
+#if defined(CONFIG_DRAM_BAD_PAGES_IN_RESERVED_MEMORY)
+		/*
+		 * Once bad pages are reserved through the reserved-memory node the
+		 * kernel gets the memory map without a split per bad page. If the
+		 * node could not be written, they are carved out of the map.
+		 */
+		if (temp32 == 0U) {
+			reserve_dram_bad_pages_early();
+		}
+		if (dram_bad_pages_reserved) {
+			free_dram_regions = dram_map.region;
+			num_regions = dram_map.region_count;
+		}
+#endif
+		if (temp32 >= num_regions) {
 			memblock->base = 0;
 			memblock->size = 0;
 		} else {
@@ -1447,25 +1678,45 @@ fail:
 }
 
 #if defined(CONFIG_DYNAMIC_LOAD_ADDRESS)
+/* arm64 Image header, see Documentation/arm64/booting.txt */
+#define ARM64_IMAGE_MAGIC			0x644d5241U
+#define ARM64_IMAGE_MAGIC_OFFSET	56U
+#define ARM64_IMAGE_TEXT_OFFSET		8U
+#define ARM64_IMAGE_SIZE_OFFSET		16U
+#define ARM64_IMAGE_HEADER_SIZE		64U
+
+/* Android header of the boot image last reserved by tegrabl_get_boot_img_load_addr() */
+static union tegrabl_bootimg_header *bootimg_header;
+
+static uint64_t read_le64(const uint8_t *p)
+{
+	uint64_t val = 0;
+	uint32_t i;
+
+	for (i = 0; i < 8U; i++) {
+		val |= (uint64_t)p[i] << (8U * i);
+	}
+
+	return val;
+}
+
 tegrabl_error_t tegrabl_get_nct_load_addr(void **load_addr)
 {
-	uint64_t addr;
-	addr = tegrabl_get_free_dram_address(NCT_PART_SIZE + MEM_SZ_64KB);
-	*load_addr = (void *)MEM_ALIGN(addr, MEM_SZ_64KB);
+	*load_addr = (void *)dram_alloc_aligned(NCT_PART_SIZE, MEM_SZ_64KB);
 	return TEGRABL_NO_ERROR;
 }
 
 tegrabl_error_t tegrabl_get_boot_img_load_addr(void **load_addr)
 {
 	uint64_t addr, partition_size;
-	void *addr_align;
 	uint64_t bootimg_size = 0;
 	uint64_t loading_total_size;
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
 	char partition_name[TEGRABL_GPT_MAX_PARTITION_NAME + 1];
 	struct tegrabl_partition partition;
 	uint8_t *ptr;
-	union tegrabl_bootimg_header *bootimg_header = NULL;
+
+	bootimg_header = NULL;
 
 	err = tegrabl_get_partition_name(TEGRABL_BINARY_KERNEL, 0, partition_name);
 	if (err != TEGRABL_NO_ERROR) {
@@ -1478,19 +1729,18 @@ tegrabl_error_t tegrabl_get_boot_img_load_addr(void **load_addr)
 		goto exit;
 	}
 	partition_size = tegrabl_partition_size(&partition);
-	addr = tegrabl_get_free_dram_address(partition_size + MEM_SZ_2MB);
-	addr_align = (void *)MEM_ALIGN(addr, MEM_SZ_2MB);
-	if (!U_BOOT_LOAD_ADDRESS_IS_VALID((uint64_t)addr_align, HEADERS_TOTAL_SIZE)) {
+	addr = dram_alloc_aligned(partition_size, MEM_SZ_2MB);
+	if (!U_BOOT_LOAD_ADDRESS_IS_VALID(addr, HEADERS_TOTAL_SIZE)) {
 		tegrabl_dealloc_dram_address(addr);
 		err = TEGRABL_ERR_NO_MEMORY;
 		goto exit;
 	}
-	err = tegrabl_partition_read(&partition, (void *)addr_align, HEADERS_TOTAL_SIZE);
+	err = tegrabl_partition_read(&partition, (void *)addr, HEADERS_TOTAL_SIZE);
 	if (err != TEGRABL_NO_ERROR) {
 		pr_error("Failed to read bootimage partition\n");
 		goto exit;
 	}
-	ptr = addr_align;
+	ptr = (uint8_t *)addr;
 	if ((strncmp((const char *)ptr, "GSHV", 4) == 0)
 		|| (strncmp((const char *)ptr, "NVDA", 4) == 0)) {
 		ptr += sizeof(struct tegrabl_sigheader);
@@ -1508,42 +1758,91 @@ tegrabl_error_t tegrabl_get_boot_img_load_addr(void **load_addr)
 		pr_info("Boot image size read from image header: %lx\n", bootimg_size);
 	}
 	tegrabl_partition_close(&partition);
-	if (bootimg_size > 0) {
-		loading_total_size = HEADERS_TOTAL_SIZE + bootimg_size;
-		tegrabl_dealloc_dram_address(addr);
-		addr = tegrabl_get_free_dram_address(loading_total_size + MEM_SZ_2MB);
-		addr_align = (void *)MEM_ALIGN(addr, MEM_SZ_2MB);
-		if (!U_BOOT_LOAD_ADDRESS_IS_VALID((uint64_t)addr_align, loading_total_size)) {
+	/* The loader only stops at the image end for an unsigned Android image,
+	 * anything else is read up to the end of the partition */
+	if ((bootimg_size > 0) && (ptr == (uint8_t *)addr)) {
+		/* Keep the address, hand back what the image does not need */
+		loading_total_size = tegrabl_bootimg_load_size(bootimg_header);
+		if (loading_total_size > partition_size) {
+			loading_total_size = partition_size;
+		}
+		if (!U_BOOT_LOAD_ADDRESS_IS_VALID(addr, loading_total_size)) {
 			tegrabl_dealloc_dram_address(addr);
+			bootimg_header = NULL;
 			err = TEGRABL_ERR_NO_MEMORY;
 			goto exit;
 		}
+		dram_arena_shrink(dram_arena_get(), addr, loading_total_size);
 	}
-	*load_addr = addr_align;
-	pr_info("Boot image load address: %p\n", addr_align);
+	*load_addr = (void *)addr;
+	pr_info("Boot image load address: %p\n", (void *)addr);
 exit:
 	return err;
 }
 
+/*
+ * Memory needed by the kernel at its load address, from the arm64 Image
+ * header of the loaded boot image. Compressed or unknown kernels get the
+ * worst case since their in-memory size is not known up front.
+ */
+static uint64_t get_kernel_reserve_size(void)
+{
+	const uint8_t *kernel;
+	uint64_t text_offset;
+	uint64_t image_size;
+
+	if ((bootimg_header == NULL) ||
+		(strncmp((const char *)bootimg_header->magic, ANDROID_MAGIC,
+				 ANDROID_MAGIC_SIZE) != 0) ||
+		(bootimg_header->kernelsize < ARM64_IMAGE_HEADER_SIZE)) {
+		return MAX_KERNEL_IMAGE_SIZE;
+	}
+
+	kernel = (const uint8_t *)bootimg_header + bootimg_header->pagesize;
+	if ((read_le64(&kernel[ARM64_IMAGE_MAGIC_OFFSET]) & 0xffffffffU) !=
+			ARM64_IMAGE_MAGIC) {
+		return MAX_KERNEL_IMAGE_SIZE;
+	}
+
+	text_offset = read_le64(&kernel[ARM64_IMAGE_TEXT_OFFSET]);
+	image_size = read_le64(&kernel[ARM64_IMAGE_SIZE_OFFSET]);
+	/* Pre-3.17 kernels do not fill image_size */
+	if ((image_size == 0U) ||
+		(text_offset + image_size > MAX_KERNEL_IMAGE_SIZE)) {
+		return MAX_KERNEL_IMAGE_SIZE;
+	}
+
+	return text_offset + image_size;
+}
+
 uint64_t tegrabl_get_kernel_load_addr(void)
 {
-	uint64_t addr;
-	addr = tegrabl_get_free_dram_address(MAX_KERNEL_IMAGE_SIZE + MEM_SZ_2MB);
-	return MEM_ALIGN(addr, MEM_SZ_2MB);
+	uint64_t size = get_kernel_reserve_size();
+
+	pr_debug("Reserving 0x%"PRIx64" bytes for kernel\n", size);
+	return dram_alloc_aligned(size, MEM_SZ_2MB);
 }
 
 uint64_t tegrabl_get_dtb_load_addr(void)
 {
-	uint64_t addr;
-	addr = tegrabl_get_free_dram_address(DTB_MAX_SIZE + MEM_SZ_2MB);
-	return MEM_ALIGN(addr, MEM_SZ_2MB);
+	/* DTB is expanded in place while patching, keep the max size */
+	return dram_alloc_aligned(DTB_MAX_SIZE, MEM_SZ_2MB);
 }
 
 uint64_t tegrabl_get_ramdisk_load_addr(void)
 {
-	uint64_t addr;
-	addr = tegrabl_get_free_dram_address(RAMDISK_MAX_SIZE + MEM_SZ_64KB);
-	return MEM_ALIGN(addr, MEM_SZ_64KB);
+	uint64_t size = RAMDISK_MAX_SIZE;
+
+	if ((bootimg_header != NULL) &&
+		(strncmp((const char *)bootimg_header->magic, ANDROID_MAGIC,
+				 ANDROID_MAGIC_SIZE) == 0) &&
+		(bootimg_header->ramdisksize != 0U) &&
+		(bootimg_header->ramdisksize <= RAMDISK_MAX_SIZE)) {
+		size = bootimg_header->ramdisksize;
+	}
+
+	pr_debug("Reserving 0x%"PRIx64" bytes for ramdisk\n", size);
+	return dram_alloc_aligned(size, MEM_SZ_64KB);
 }
 
 #else /* CONFIG_DYNAMIC_LOAD_ADDRESS */
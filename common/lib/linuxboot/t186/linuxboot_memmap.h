@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2020, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Free DRAM map for the kernel: permanent carveouts and DRAM bad pages merged
+ * into sorted free extents. Private to linuxboot_helper.c and kept free of
+ * target dependencies so that tests/linuxboot_memmap_test.c can build it on
+ * the host. Include after the headers providing stdint/stdbool, inttypes,
+ * pr_debug(), cpu_to_fdt64(), PAGE_SIZE and struct tegrabl_linuxboot_memblock.
+ */
+
+#ifndef INCLUDED_LINUXBOOT_MEMMAP_H
+#define INCLUDED_LINUXBOOT_MEMMAP_H
+
+struct linuxboot_memmap {
+	/* DRAM not covered by carveouts or bad pages, sorted by base */
+	struct tegrabl_linuxboot_memblock *free;
+	uint32_t free_count;
+	/* DRAM not covered by carveouts, bad pages not carved out */
+	struct tegrabl_linuxboot_memblock *region;
+	uint32_t region_count;
+};
+
+/* Sift-down step of heapsort over an array of (base, size) memblocks */
+static inline void memblock_sift_down(struct tegrabl_linuxboot_memblock arr[],
+									  uint32_t root, uint32_t count)
+{
+	struct tegrabl_linuxboot_memblock temp;
+	uint32_t child;
+
+	while ((2U * root) + 1U < count) {
+		child = (2U * root) + 1U;
+		if ((child + 1U < count) && (arr[child].base < arr[child + 1U].base)) {
+			child++;
+		}
+		if (arr[root].base >= arr[child].base) {
+			return;
+		}
+		temp = arr[root];
+		arr[root] = arr[child];
+		arr[child] = temp;
+		root = child;
+	}
+}
+
+/* Sort memblocks in increasing order of their base */
+static inline void sort_memblocks(struct tegrabl_linuxboot_memblock arr[],
+								  uint32_t count)
+{
+	struct tegrabl_linuxboot_memblock temp;
+	uint32_t i;
+
+	if (count < 2U) {
+		return;
+	}
+
+	for (i = count / 2U; i > 0U; i--) {
+		memblock_sift_down(arr, i - 1U, count);
+	}
+
+	for (i = count - 1U; i > 0U; i--) {
+		temp = arr[0];
+		arr[0] = arr[i];
+		arr[i] = temp;
+		memblock_sift_down(arr, 0, i);
+	}
+}
+
+/* Sift-down step of heapsort over an array of addresses */
+static inline void addr_sift_down(uint64_t arr[], uint64_t root,
+								  uint64_t count)
+{
+	uint64_t temp;
+	uint64_t child;
+
+	while ((2U * root) + 1U < count) {
+		child = (2U * root) + 1U;
+		if ((child + 1U < count) && (arr[child] < arr[child + 1U])) {
+			child++;
+		}
+		if (arr[root] >= arr[child]) {
+			return;
+		}
+		temp = arr[root];
+		arr[root] = arr[child];
+		arr[child] = temp;
+		root = child;
+	}
+}
+
+/* Sort addresses in increasing order, O(n log n) and in place */
+static inline void sort_array(uint64_t arr[], uint64_t count)
+{
+	uint64_t i, temp;
+
+	if (count < 2U) {
+		return;
+	}
+
+	for (i = count / 2U; i > 0U; i--) {
+		addr_sift_down(arr, i - 1U, count);
+	}
+
+	for (i = count - 1U; i > 0U; i--) {
+		temp = arr[0];
+		arr[0] = arr[i];
+		arr[i] = temp;
+		addr_sift_down(arr, 0, i);
+	}
+}
+
+/*
+ * Add [start, end) to map->free, carving out every bad page which falls in
+ * it. bad_page_arr must be sorted; *page_idx is advanced past the pages
+ * consumed so that all free blocks together walk the bad page list only once.
+ */
+static inline void add_free_extent(struct linuxboot_memmap *map,
+								   uint64_t start, uint64_t end,
+								   const uint64_t bad_page_arr[],
+								   uint64_t bad_page_count, uint64_t *page_idx)
+{
+	uint64_t page;
+
+	map->region[map->region_count].base = start;
+	map->region[map->region_count].size = end - start;
+	map->region_count++;
+
+	while ((*page_idx < bad_page_count) && (bad_page_arr[*page_idx] < end)) {
+		page = bad_page_arr[*page_idx];
+		(*page_idx)++;
+
+		/* Bad page in a carveout or duplicate entry, nothing to carve */
+		if (page + PAGE_SIZE <= start) {
+			continue;
+		}
+
+		if (page > start) {
+			pr_debug("[%u] START: 0x%"PRIx64", END: 0x%"PRIx64"\n",
+					 map->free_count, start, page);
+			map->free[map->free_count].base = start;
+			map->free[map->free_count].size = page - start;
+			map->free_count++;
+		}
+		start = page + PAGE_SIZE;
+	}
+
+	if (end > start) {
+		pr_debug("[%u] START: 0x%"PRIx64", END: 0x%"PRIx64"\n",
+				 map->free_count, start, end);
+		map->free[map->free_count].base = start;
+		map->free[map->free_count].size = end - start;
+		map->free_count++;
+	}
+}
+
+/*
+ * Fill map with DRAM [dram_start, dram_end) minus the carveouts and the bad
+ * pages, both of which are sorted in place. map->free must hold
+ * carveout_count + bad_page_count + 1 blocks, map->region carveout_count + 1.
+ */
+static inline void build_memmap(struct linuxboot_memmap *map,
+								uint64_t dram_start, uint64_t dram_end,
+								struct tegrabl_linuxboot_memblock carveouts[],
+								uint32_t carveout_count,
+								uint64_t bad_page_arr[],
+								uint64_t bad_page_count)
+{
+	uint64_t cur_start = dram_start;
+	uint64_t cur_end;
+	uint64_t page_idx = 0;
+	uint32_t i;
+
+	sort_memblocks(carveouts, carveout_count);
+	sort_array(bad_page_arr, bad_page_count);
+
+	/* Merge the gaps between carveouts with the bad pages in a single pass */
+	map->free_count = 0;
+	map->region_count = 0;
+
+	for (i = 0; i < carveout_count; i++) {
+		cur_end = carveouts[i].base;
+		if (cur_end > cur_start) {
+			add_free_extent(map, cur_start, cur_end, bad_page_arr,
+							bad_page_count, &page_idx);
+		}
+		if (carveouts[i].base + carveouts[i].size > cur_start) {
+			cur_start = carveouts[i].base + carveouts[i].size;
+		}
+	}
+
+	if (dram_end > cur_start) {
+		add_free_extent(map, cur_start, dram_end, bad_page_arr,
+						bad_page_count, &page_idx);
+	}
+}
+
+/*
+ * Walk the sorted bad pages which fall in map->region and merge those within
+ * gap bytes of each other. A range never extends past the end of its region,
+ * so carveouts are not covered. Stores up to max ranges into reg (as fdt64
+ * base/size pairs) if not NULL and returns the number of ranges needed.
+ */
+static inline uint32_t merge_bad_pages(const struct linuxboot_memmap *map,
+									   const uint64_t bad_page_arr[],
+									   uint64_t bad_page_count, uint64_t gap,
+									   uint64_t *reg, uint32_t max)
+{
+	uint64_t page_idx = 0;
+	uint64_t base = 0;
+	uint64_t end = 0;
+	uint64_t rgn_end;
+	uint32_t rgn;
+	uint32_t count = 0;
+	bool in_range;
+
+	for (rgn = 0; rgn < map->region_count; rgn++) {
+		rgn_end = map->region[rgn].base + map->region[rgn].size;
+		in_range = false;
+
+		for (; (page_idx < bad_page_count) &&
+				(bad_page_arr[page_idx] < rgn_end); page_idx++) {
+			if (bad_page_arr[page_idx] < map->region[rgn].base) {
+				continue;
+			}
+			if (in_range && (bad_page_arr[page_idx] <= end + gap)) {
+				if (bad_page_arr[page_idx] + PAGE_SIZE > end) {
+					end = bad_page_arr[page_idx] + PAGE_SIZE;
+				}
+				continue;
+			}
+			if (in_range) {
+				if ((reg != NULL) && (count < max)) {
+					reg[2U * count] = cpu_to_fdt64(base);
+					reg[(2U * count) + 1U] = cpu_to_fdt64(end - base);
+				}
+				count++;
+			}
+			base = bad_page_arr[page_idx];
+			end = base + PAGE_SIZE;
+			in_range = true;
+		}
+
+		if (in_range) {
+			if (end > rgn_end) {
+				end = rgn_end;
+			}
+			if ((reg != NULL) && (count < max)) {
+				reg[2U * count] = cpu_to_fdt64(base);
+				reg[(2U * count) + 1U] = cpu_to_fdt64(end - base);
+			}
+			count++;
+		}
+	}
+
+	return count;
+}
+
+#endif /* INCLUDED_LINUXBOOT_MEMMAP_H */
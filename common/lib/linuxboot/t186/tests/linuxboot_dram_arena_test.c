@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2020, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Host unit test for linuxboot_dram_arena.h. Random sequences of alloc,
+ * claim, free and shrink, with the prepare hook failing now and then, are
+ * mirrored on a page-by-page map of the same DRAM. After every step the free
+ * extents must be exactly the maximal free runs of the map, which rules out
+ * overlaps and uncoalesced neighbours, allocations must not overlap, and an
+ * allocation must be the best fit. Once everything is freed the arena must be
+ * back to the regions it started from.
+ *
+ * Build and run from the top of the tree:
+ *   cc -std=c99 -O2 -Wall -Wextra -I common/lib/linuxboot/t186 \
+ *      common/lib/linuxboot/t186/tests/linuxboot_dram_arena_test.c \
+ *      -o linuxboot_dram_arena_test
+ *   ./linuxboot_dram_arena_test      (exits non-zero on a failure)
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* What linuxboot_helper.c gets from the target headers */
+#define PAGE_SIZE				4096U
+#define pr_debug(...)			do { } while (0)
+#define pr_error(...)			do { } while (0)
+
+typedef uint32_t tegrabl_error_t;
+#define TEGRABL_NO_ERROR		0U
+#define TEGRABL_ERR_OVERFLOW	1U
+#define TEGRABL_ERR_TEST		2U
+#define TEGRABL_ERROR(reason, aux)	((reason) | ((uint32_t)(aux) << 8))
+
+struct tegrabl_linuxboot_memblock {
+	uint64_t base;
+	uint64_t size;
+};
+
+#include "linuxboot_dram_arena.h"
+
+#define DRAM_START				0x80000000ULL
+#define DRAM_PAGES				4096U
+#define MAX_REGIONS				16U
+#define MAX_ALLOCS				32U
+#define MAX_EXTENTS				(MAX_REGIONS + MAX_ALLOCS)
+#define RANDOM_ROUNDS			500U
+#define STEPS_PER_ROUND			400U
+
+enum page_state {
+	PAGE_NONE,		/* not in any region handed to the arena */
+	PAGE_FREE,
+	PAGE_ALLOC,
+};
+
+static uint8_t page_map[DRAM_PAGES];
+static struct tegrabl_linuxboot_memblock regions[MAX_REGIONS];
+static uint32_t region_count;
+static struct tegrabl_linuxboot_memblock free_extents[MAX_EXTENTS];
+static struct tegrabl_linuxboot_memblock allocs[MAX_ALLOCS];
+static struct tegrabl_linuxboot_memblock runs[DRAM_PAGES];
+static struct tegrabl_linuxboot_memblock sorted[MAX_EXTENTS];
+
+static struct dram_arena arena = {
+	.free = free_extents,
+	.max_free = MAX_EXTENTS,
+	.allocs = allocs,
+	.max_allocs = MAX_ALLOCS,
+};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+static uint32_t failures;
+static bool prepare_fails;
+static char step_name[96];
+
+static uint64_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+
+	return rng_state;
+}
+
+static uint64_t page_addr(uint32_t page)
+{
+	return DRAM_START + ((uint64_t)page * PAGE_SIZE);
+}
+
+static uint32_t addr_page(uint64_t addr)
+{
+	return (uint32_t)((addr - DRAM_START) / PAGE_SIZE);
+}
+
+static void fail(const char *what)
+{
+	if (failures < 20U) {
+		fprintf(stderr, "FAIL %s: %s\n", step_name, what);
+	}
+	failures++;
+}
+
+static tegrabl_error_t prepare(uint64_t base, uint64_t size)
+{
+	uint32_t page;
+
+	/* Only ever asked about memory which is about to be handed out */
+	for (page = addr_page(base); page < addr_page(base + size); page++) {
+		if (page_map[page] != PAGE_FREE) {
+			fail("prepare called on memory that is not free");
+			break;
+		}
+	}
+
+	return prepare_fails ? TEGRABL_ERROR(TEGRABL_ERR_TEST, 0) :
+		TEGRABL_NO_ERROR;
+}
+
+static void mark(uint64_t base, uint64_t size, uint8_t state)
+{
+	uint32_t page;
+
+	for (page = addr_page(base); page < addr_page(base + size); page++) {
+		page_map[page] = state;
+	}
+}
+
+/* Maximal runs of free pages in the page map */
+static uint32_t free_runs(void)
+{
+	uint32_t count = 0;
+	uint32_t page = 0;
+	uint32_t start;
+
+	while (page < DRAM_PAGES) {
+		if (page_map[page] != PAGE_FREE) {
+			page++;
+			continue;
+		}
+		start = page;
+		while ((page < DRAM_PAGES) && (page_map[page] == PAGE_FREE)) {
+			page++;
+		}
+		runs[count].base = page_addr(start);
+		runs[count].size = (uint64_t)(page - start) * PAGE_SIZE;
+		count++;
+	}
+
+	return count;
+}
+
+static int by_base(const void *a, const void *b)
+{
+	const struct tegrabl_linuxboot_memblock *x = a;
+	const struct tegrabl_linuxboot_memblock *y = b;
+
+	return (x->base > y->base) - (x->base < y->base);
+}
+
+/* Compare the arena with the page map */
+static void check_arena(void)
+{
+	uint64_t alloc_pages = 0;
+	uint64_t map_pages = 0;
+	uint32_t count;
+	uint32_t page;
+	uint32_t i;
+
+	for (i = 1; i < arena.free_count; i++) {
+		if (!dram_extent_is_before(&free_extents[i - 1U],
+								   free_extents[i].size,
+								   free_extents[i].base)) {
+			fail("free extents not sorted by (size, base)");
+			break;
+		}
+	}
+
+	/* Sorted by base, the free extents must be the free runs themselves:
+	 * no extent overlaps an allocation and no two of them touch */
+	count = free_runs();
+	memcpy(sorted, free_extents, arena.free_count * sizeof(sorted[0]));
+	qsort(sorted, arena.free_count, sizeof(sorted[0]), by_base);
+	if (count != arena.free_count) {
+		fail("free extents are not the free runs of the page map");
+	} else {
+		for (i = 0; i < count; i++) {
+			if ((sorted[i].base != runs[i].base) ||
+				(sorted[i].size != runs[i].size)) {
+				fail("free extents are not the free runs of the page map");
+				break;
+			}
+		}
+	}
+
+	memcpy(sorted, allocs, arena.alloc_count * sizeof(sorted[0]));
+	qsort(sorted, arena.alloc_count, sizeof(sorted[0]), by_base);
+	for (i = 0; i < arena.alloc_count; i++) {
+		if ((i > 0U) &&
+			(sorted[i - 1U].base + sorted[i - 1U].size > sorted[i].base)) {
+			fail("allocations overlap");
+		}
+		for (page = addr_page(sorted[i].base);
+			 page < addr_page(sorted[i].base + sorted[i].size); page++) {
+			if (page_map[page] != PAGE_ALLOC) {
+				fail("allocation covers memory that is not allocated");
+				break;
+			}
+		}
+		alloc_pages += sorted[i].size / PAGE_SIZE;
+	}
+	for (page = 0; page < DRAM_PAGES; page++) {
+		map_pages += (page_map[page] == PAGE_ALLOC) ? 1U : 0U;
+	}
+	if (alloc_pages != map_pages) {
+		fail("allocated memory is not tracked");
+	}
+}
+
+static struct tegrabl_linuxboot_memblock free_before[MAX_EXTENTS];
+static struct tegrabl_linuxboot_memblock allocs_before[MAX_ALLOCS];
+static uint32_t free_count_before;
+static uint32_t alloc_count_before;
+
+static void snapshot(void)
+{
+	free_count_before = arena.free_count;
+	alloc_count_before = arena.alloc_count;
+	memcpy(free_before, free_extents, sizeof(free_before));
+	memcpy(allocs_before, allocs, sizeof(allocs_before));
+}
+
+/* A refused request must leave the arena exactly as it was */
+static void check_unchanged(void)
+{
+	if ((arena.free_count != free_count_before) ||
+		(arena.alloc_count != alloc_count_before) ||
+		(memcmp(free_before, free_extents,
+				free_count_before * sizeof(free_before[0])) != 0) ||
+		(memcmp(allocs_before, allocs,
+				alloc_count_before * sizeof(allocs_before[0])) != 0)) {
+		fail("refused request changed the arena");
+	}
+}
+
+/* Whether a free run can hold an aligned allocation below limit */
+static bool run_fits(const struct tegrabl_linuxboot_memblock *run,
+					 uint64_t size, uint64_t align, uint64_t limit)
+{
+	uint64_t addr = dram_arena_align(run->base, align);
+
+	return (addr + size <= run->base + run->size) && (addr + size <= limit);
+}
+
+static void step_alloc(void)
+{
+	const struct tegrabl_linuxboot_memblock *best = NULL;
+	uint64_t size = (1U + (rng() % 64U)) * PAGE_SIZE - (rng() % PAGE_SIZE);
+	uint64_t align = (uint64_t)PAGE_SIZE << (rng() % 7U);
+	uint64_t limit = ((rng() % 4U) == 0U) ?
+		page_addr((uint32_t)(rng() % DRAM_PAGES)) : UINT64_MAX;
+	uint64_t rounded = dram_arena_align(size, PAGE_SIZE);
+	uint64_t addr;
+	uint32_t count;
+	uint32_t i;
+
+	snprintf(step_name, sizeof(step_name), "alloc 0x%" PRIx64 " align 0x%"
+			 PRIx64, size, align);
+
+	count = free_runs();
+	for (i = 0; i < count; i++) {
+		if (run_fits(&runs[i], rounded, align, limit) &&
+			((best == NULL) ||
+			 dram_extent_is_before(&runs[i], best->size, best->base))) {
+			best = &runs[i];
+		}
+	}
+
+	snapshot();
+	addr = dram_arena_alloc(&arena, size, align, limit);
+	if ((best == NULL) || (alloc_count_before == MAX_ALLOCS) ||
+		prepare_fails) {
+		if (addr != 0U) {
+			fail("allocated where nothing fits");
+		}
+		check_unchanged();
+		return;
+	}
+	if (addr == 0U) {
+		fail("no allocation although a run fits");
+		return;
+	}
+	if ((addr & (align - 1U)) != 0U) {
+		fail("allocation misaligned");
+	}
+	if (addr + rounded > limit) {
+		fail("allocation above its limit");
+	}
+	/* Best fit: the smallest run which fits, lowest first on a tie */
+	if (addr != dram_arena_align(best->base, align)) {
+		fail("allocation is not the best fit");
+	}
+	for (i = addr_page(addr); i < addr_page(addr + rounded); i++) {
+		if (page_map[i] != PAGE_FREE) {
+			fail("allocated memory that is not free");
+			break;
+		}
+	}
+	mark(addr, rounded, PAGE_ALLOC);
+}
+
+static void step_claim(void)
+{
+	uint32_t first = (uint32_t)(rng() % DRAM_PAGES);
+	uint32_t pages = 1U + (uint32_t)(rng() % 32U);
+	bool expect = arena.alloc_count < MAX_ALLOCS;
+	bool claimed;
+	uint32_t page;
+
+	if (first + pages > DRAM_PAGES) {
+		pages = DRAM_PAGES - first;
+	}
+	snprintf(step_name, sizeof(step_name), "claim page %u + %u", first, pages);
+
+	for (page = first; page < first + pages; page++) {
+		expect = expect && (page_map[page] == PAGE_FREE);
+	}
+	expect = expect && !prepare_fails;
+
+	snapshot();
+	claimed = dram_arena_claim(&arena, page_addr(first),
+							   (uint64_t)pages * PAGE_SIZE);
+	if (claimed != expect) {
+		fail(expect ? "free range not claimed" : "claimed a busy range");
+		return;
+	}
+	if (claimed) {
+		mark(page_addr(first), (uint64_t)pages * PAGE_SIZE, PAGE_ALLOC);
+	} else {
+		check_unchanged();
+	}
+}
+
+static void step_free(void)
+{
+	struct tegrabl_linuxboot_memblock block;
+	uint32_t count = arena.alloc_count;
+
+	if ((count == 0U) || ((rng() % 8U) == 0U)) {
+		/* Unknown addresses leave the arena alone */
+		snprintf(step_name, sizeof(step_name), "free unknown address");
+		snapshot();
+		dram_arena_free(&arena, page_addr((uint32_t)(rng() % DRAM_PAGES)) +
+						1U);
+		check_unchanged();
+		return;
+	}
+
+	block = allocs[rng() % count];
+	snprintf(step_name, sizeof(step_name), "free 0x%" PRIx64, block.base);
+	dram_arena_free(&arena, block.base);
+	if (arena.alloc_count != count - 1U) {
+		fail("allocation not dropped");
+	}
+	mark(block.base, block.size, PAGE_FREE);
+}
+
+static void step_shrink(void)
+{
+	struct tegrabl_linuxboot_memblock block;
+	uint64_t new_size;
+	uint64_t kept;
+
+	if (arena.alloc_count == 0U) {
+		return;
+	}
+
+	block = allocs[rng() % arena.alloc_count];
+	new_size = rng() % (block.size + PAGE_SIZE);
+	snprintf(step_name, sizeof(step_name), "shrink 0x%" PRIx64 " to 0x%"
+			 PRIx64, block.base, new_size);
+
+	dram_arena_shrink(&arena, block.base, new_size);
+
+	/* 0 and sizes which do not shrink the whole pages are ignored */
+	kept = dram_arena_align(new_size, PAGE_SIZE);
+	if ((kept == 0U) || (kept >= block.size)) {
+		kept = block.size;
+	}
+	mark(block.base + kept, block.size - kept, PAGE_FREE);
+}
+
+/* Disjoint regions with at least one page in between, as free_dram_block */
+static void make_regions(void)
+{
+	uint32_t page = (uint32_t)(rng() % 8U);
+	uint32_t pages;
+
+	region_count = 0;
+	memset(page_map, PAGE_NONE, sizeof(page_map));
+	while ((region_count < MAX_REGIONS) && (page < DRAM_PAGES)) {
+		pages = 1U + (uint32_t)(rng() % (2U * DRAM_PAGES / MAX_REGIONS));
+		if (page + pages > DRAM_PAGES) {
+			pages = DRAM_PAGES - page;
+		}
+		regions[region_count].base = page_addr(page);
+		regions[region_count].size = (uint64_t)pages * PAGE_SIZE;
+		region_count++;
+		mark(page_addr(page), (uint64_t)pages * PAGE_SIZE, PAGE_FREE);
+		page += pages + 1U + (uint32_t)(rng() % 64U);
+	}
+}
+
+static void random_round(uint32_t round)
+{
+	uint32_t count;
+	uint32_t step;
+	uint32_t i;
+
+	make_regions();
+	dram_arena_init(&arena, regions, region_count);
+	snprintf(step_name, sizeof(step_name), "round %u init", round);
+	check_arena();
+
+	for (step = 0; step < STEPS_PER_ROUND; step++) {
+		prepare_fails = (rng() % 16U) == 0U;
+		switch (rng() % 8U) {
+		case 0:
+		case 1:
+		case 2:
+			step_alloc();
+			break;
+		case 3:
+			step_claim();
+			break;
+		case 4:
+		case 5:
+			step_free();
+			break;
+		default:
+			step_shrink();
+			break;
+		}
+		check_arena();
+	}
+	prepare_fails = false;
+
+	/* Free everything in random order, the arena must fully coalesce */
+	snprintf(step_name, sizeof(step_name), "round %u drain", round);
+	while (arena.alloc_count != 0U) {
+		i = (uint32_t)(rng() % arena.alloc_count);
+		mark(allocs[i].base, allocs[i].size, PAGE_FREE);
+		dram_arena_free(&arena, allocs[i].base);
+	}
+	check_arena();
+	count = arena.free_count;
+	memcpy(sorted, free_extents, count * sizeof(sorted[0]));
+	qsort(sorted, count, sizeof(sorted[0]), by_base);
+	if ((count != region_count) ||
+		(memcmp(sorted, regions, count * sizeof(sorted[0])) != 0)) {
+		fail("arena not back to its regions once everything is freed");
+	}
+}
+
+static void fixed_cases(void)
+{
+	uint64_t a, b, c;
+
+	/* One region, carved from both ends and the middle, then freed */
+	memset(page_map, PAGE_NONE, sizeof(page_map));
+	regions[0].base = page_addr(0);
+	regions[0].size = 16U * PAGE_SIZE;
+	region_count = 1;
+	mark(regions[0].base, regions[0].size, PAGE_FREE);
+	dram_arena_init(&arena, regions, region_count);
+
+	snprintf(step_name, sizeof(step_name), "fixed claim middle");
+	if (!dram_arena_claim(&arena, page_addr(6), 4U * PAGE_SIZE)) {
+		fail("claim failed");
+	}
+	mark(page_addr(6), 4U * PAGE_SIZE, PAGE_ALLOC);
+	check_arena();
+
+	/* Head is 6 pages, tail 6 pages: a tie goes to the lower one */
+	snprintf(step_name, sizeof(step_name), "fixed alloc tie");
+	a = dram_arena_alloc(&arena, PAGE_SIZE, PAGE_SIZE, UINT64_MAX);
+	if (a != page_addr(0)) {
+		fail("tie not broken by base");
+	}
+	mark(a, PAGE_SIZE, PAGE_ALLOC);
+
+	/* 5 pages left at the head, 6 at the tail: best fit takes the head */
+	snprintf(step_name, sizeof(step_name), "fixed alloc best fit");
+	b = dram_arena_alloc(&arena, 5U * PAGE_SIZE, PAGE_SIZE, UINT64_MAX);
+	if (b != page_addr(1)) {
+		fail("not the best fit");
+	}
+	mark(b, 5U * PAGE_SIZE, PAGE_ALLOC);
+
+	/* Too big for what is left */
+	snprintf(step_name, sizeof(step_name), "fixed alloc too big");
+	if (dram_arena_alloc(&arena, 7U * PAGE_SIZE, PAGE_SIZE, UINT64_MAX) !=
+		0U) {
+		fail("allocated more than is free");
+	}
+
+	/* Bad arguments */
+	snprintf(step_name, sizeof(step_name), "fixed alloc bad arguments");
+	if ((dram_arena_alloc(&arena, 0, PAGE_SIZE, UINT64_MAX) != 0U) ||
+		(dram_arena_alloc(&arena, PAGE_SIZE, 0, UINT64_MAX) != 0U) ||
+		(dram_arena_alloc(&arena, PAGE_SIZE, 3U * PAGE_SIZE, UINT64_MAX) !=
+		 0U) ||
+		(dram_arena_alloc(&arena, UINT64_MAX, PAGE_SIZE, UINT64_MAX) != 0U)) {
+		fail("bad arguments accepted");
+	}
+
+	c = dram_arena_alloc(&arena, 6U * PAGE_SIZE, PAGE_SIZE, UINT64_MAX);
+	if (c != page_addr(10)) {
+		fail("tail not allocated");
+	}
+	mark(c, 6U * PAGE_SIZE, PAGE_ALLOC);
+	check_arena();
+
+	/* Shrink the tail allocation, then free all in an order which needs
+	 * merging on both sides */
+	snprintf(step_name, sizeof(step_name), "fixed shrink and free");
+	dram_arena_shrink(&arena, c, PAGE_SIZE + 1U);
+	mark(c + 2U * PAGE_SIZE, 4U * PAGE_SIZE, PAGE_FREE);
+	check_arena();
+	dram_arena_free(&arena, a);
+	dram_arena_free(&arena, c);
+	dram_arena_free(&arena, page_addr(6));
+	dram_arena_free(&arena, b);
+	mark(regions[0].base, regions[0].size, PAGE_FREE);
+	check_arena();
+	if ((arena.free_count != 1U) || (free_extents[0].base != page_addr(0)) ||
+		(free_extents[0].size != 16U * PAGE_SIZE)) {
+		fail("region not coalesced back");
+	}
+}
+
+int main(void)
+{
+	uint32_t round;
+
+	arena.prepare = prepare;
+
+	fixed_cases();
+	for (round = 0; round < RANDOM_ROUNDS; round++) {
+		random_round(round);
+	}
+
+	if (failures != 0U) {
+		fprintf(stderr, "%u checks failed\n", failures);
+		return 1;
+	}
+	printf("linuxboot_dram_arena: all checks passed\n");
+
+	return 0;
+}
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2020, NVIDIA Corporation.  All Rights Reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property and
+ * proprietary rights in and to this software and related documentation.  Any
+ * use, reproduction, disclosure or distribution of this software and related
+ * documentation without an express license agreement from NVIDIA Corporation
+ * is strictly prohibited.
+ */
+
+/*
+ * Host unit test and benchmark for linuxboot_memmap.h. The free DRAM map and
+ * the merged bad page ranges are checked against a page-by-page map of the
+ * same DRAM, for fixed corner cases and for random carveouts with up to
+ * thousands of bad pages. The benchmark times build_memmap() against the
+ * bubble sort the bad page list used to go through.
+ *
+ * Build and run from the top of the tree:
+ *   cc -std=c99 -O2 -Wall -Wextra -I common/lib/linuxboot/t186 \
+ *      common/lib/linuxboot/t186/tests/linuxboot_memmap_test.c \
+ *      -o linuxboot_memmap_test
+ *   ./linuxboot_memmap_test          (exits non-zero on a failure)
+ *   ./linuxboot_memmap_test bench
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* What linuxboot_helper.c gets from the target headers */
+#define PAGE_SIZE				4096U
+#define pr_debug(...)			do { } while (0)
+#define cpu_to_fdt64(x)			(x)
+
+struct tegrabl_linuxboot_memblock {
+	uint64_t base;
+	uint64_t size;
+};
+
+#include "linuxboot_memmap.h"
+
+#define DRAM_START				0x80000000ULL
+#define DRAM_PAGES				65536U
+#define MAX_CARVEOUTS			24U
+#define MAX_BAD_PAGES			16384U
+#define MAX_RANGES				(MAX_BAD_PAGES + 1U)
+#define RANDOM_ROUNDS			2000U
+#define CANARY					0x5a5a5a5a5a5a5a5aULL
+
+enum page_state {
+	PAGE_FREE,
+	PAGE_CARVEOUT,
+	PAGE_BAD,
+};
+
+static uint8_t page_map[DRAM_PAGES];
+static struct tegrabl_linuxboot_memblock carveouts[MAX_CARVEOUTS];
+static uint64_t bad_pages[MAX_BAD_PAGES];
+/* One extra entry past the capacity build_memmap() is promised */
+static struct tegrabl_linuxboot_memblock free_blocks[MAX_CARVEOUTS + MAX_BAD_PAGES + 2U];
+static struct tegrabl_linuxboot_memblock regions[MAX_CARVEOUTS + 2U];
+static struct tegrabl_linuxboot_memblock expected[MAX_CARVEOUTS + MAX_BAD_PAGES + 1U];
+static uint64_t reg[(2U * MAX_RANGES) + 1U];
+static uint64_t expected_reg[2U * MAX_RANGES];
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+static uint32_t failures;
+
+static uint64_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+
+	return rng_state;
+}
+
+static uint64_t page_addr(uint32_t page)
+{
+	return DRAM_START + ((uint64_t)page * PAGE_SIZE);
+}
+
+static void fail(const char *name, const char *what)
+{
+	fprintf(stderr, "FAIL %s: %s\n", name, what);
+	failures++;
+}
+
+/* Maximal runs of pages for which want(state) holds, as memblocks */
+static uint32_t page_runs(uint32_t dram_pages, bool (*want)(uint8_t),
+						  struct tegrabl_linuxboot_memblock out[])
+{
+	uint32_t count = 0;
+	uint32_t page = 0;
+	uint32_t start;
+
+	while (page < dram_pages) {
+		if (!want(page_map[page])) {
+			page++;
+			continue;
+		}
+		start = page;
+		while ((page < dram_pages) && want(page_map[page])) {
+			page++;
+		}
+		out[count].base = page_addr(start);
+		out[count].size = (uint64_t)(page - start) * PAGE_SIZE;
+		count++;
+	}
+
+	return count;
+}
+
+static bool is_free(uint8_t state)
+{
+	return state == PAGE_FREE;
+}
+
+static bool is_region(uint8_t state)
+{
+	return state != PAGE_CARVEOUT;
+}
+
+static bool same_blocks(const struct tegrabl_linuxboot_memblock a[],
+						const struct tegrabl_linuxboot_memblock b[],
+						uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if ((a[i].base != b[i].base) || (a[i].size != b[i].size)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Ranges merge_bad_pages() should produce, walking each region of the page
+ * map one page at a time
+ */
+static uint32_t expected_ranges(uint32_t dram_pages, uint64_t gap)
+{
+	uint32_t count = 0;
+	uint32_t page = 0;
+	uint64_t addr;
+	uint64_t base = 0;
+	uint64_t end = 0;
+	bool in_range;
+
+	while (page < dram_pages) {
+		if (page_map[page] == PAGE_CARVEOUT) {
+			page++;
+			continue;
+		}
+		in_range = false;
+		for (; (page < dram_pages) && (page_map[page] != PAGE_CARVEOUT);
+			 page++) {
+			if (page_map[page] != PAGE_BAD) {
+				continue;
+			}
+			addr = page_addr(page);
+			if (in_range && (addr <= end + gap)) {
+				end = addr + PAGE_SIZE;
+				continue;
+			}
+			if (in_range) {
+				expected_reg[2U * count] = base;
+				expected_reg[(2U * count) + 1U] = end - base;
+				count++;
+			}
+			base = addr;
+			end = addr + PAGE_SIZE;
+			in_range = true;
+		}
+		if (in_range) {
+			expected_reg[2U * count] = base;
+			expected_reg[(2U * count) + 1U] = end - base;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Run build_memmap() and merge_bad_pages() over carveouts[] and bad_pages[]
+ * and compare them with the page map of the same DRAM
+ */
+static void check(const char *name, uint32_t dram_pages,
+				  uint32_t carveout_count, uint32_t bad_page_count)
+{
+	struct linuxboot_memmap map = {
+		.free = free_blocks,
+		.region = regions,
+	};
+	uint32_t free_cap = carveout_count + bad_page_count + 1U;
+	uint32_t region_cap = carveout_count + 1U;
+	uint32_t count;
+	uint32_t ranges;
+	uint32_t max;
+	uint32_t page;
+	uint32_t i;
+	uint64_t first;
+	uint64_t last;
+	uint64_t gap;
+
+	memset(page_map, PAGE_FREE, dram_pages);
+	for (i = 0; i < carveout_count; i++) {
+		first = (carveouts[i].base - DRAM_START) / PAGE_SIZE;
+		last = first + (carveouts[i].size / PAGE_SIZE);
+		for (page = (uint32_t)first; (page < last) && (page < dram_pages);
+			 page++) {
+			page_map[page] = PAGE_CARVEOUT;
+		}
+	}
+	for (i = 0; i < bad_page_count; i++) {
+		page = (uint32_t)((bad_pages[i] - DRAM_START) / PAGE_SIZE);
+		if (page_map[page] == PAGE_FREE) {
+			page_map[page] = PAGE_BAD;
+		}
+	}
+
+	free_blocks[free_cap].base = CANARY;
+	regions[region_cap].base = CANARY;
+
+	build_memmap(&map, DRAM_START, page_addr(dram_pages), carveouts,
+				 carveout_count, bad_pages, bad_page_count);
+
+	if ((free_blocks[free_cap].base != CANARY) ||
+		(regions[region_cap].base != CANARY) ||
+		(map.free_count > free_cap) || (map.region_count > region_cap)) {
+		fail(name, "overran the promised capacity");
+		return;
+	}
+	for (i = 1; i < bad_page_count; i++) {
+		if (bad_pages[i - 1U] > bad_pages[i]) {
+			fail(name, "bad pages not sorted");
+			break;
+		}
+	}
+	for (i = 1; i < carveout_count; i++) {
+		if (carveouts[i - 1U].base > carveouts[i].base) {
+			fail(name, "carveouts not sorted");
+			break;
+		}
+	}
+
+	count = page_runs(dram_pages, is_free, expected);
+	if ((count != map.free_count) ||
+		!same_blocks(expected, map.free, count)) {
+		fail(name, "free blocks differ from the page map");
+	}
+	count = page_runs(dram_pages, is_region, expected);
+	if ((count != map.region_count) ||
+		!same_blocks(expected, map.region, count)) {
+		fail(name, "regions differ from the page map");
+	}
+
+	for (gap = PAGE_SIZE; gap <= 4U * PAGE_SIZE; gap <<= 1) {
+		ranges = expected_ranges(dram_pages, gap);
+		if (merge_bad_pages(&map, bad_pages, bad_page_count, gap, NULL, 0) !=
+			ranges) {
+			fail(name, "merged range count differs from the page map");
+			continue;
+		}
+
+		/* A short reg gets the first max ranges and nothing past them */
+		max = (ranges > 1U) ? (ranges / 2U) : ranges;
+		reg[2U * max] = CANARY;
+		if ((merge_bad_pages(&map, bad_pages, bad_page_count, gap, reg,
+							 max) != ranges) ||
+			(memcmp(reg, expected_reg, 2U * max * sizeof(reg[0])) != 0) ||
+			(reg[2U * max] != CANARY)) {
+			fail(name, "merged ranges differ from the page map");
+		}
+
+		merge_bad_pages(&map, bad_pages, bad_page_count, gap, reg, ranges);
+		if (memcmp(reg, expected_reg, 2U * ranges * sizeof(reg[0])) != 0) {
+			fail(name, "merged ranges differ from the page map");
+		}
+	}
+}
+
+static void set_carveout(uint32_t i, uint32_t first_page, uint32_t pages)
+{
+	carveouts[i].base = page_addr(first_page);
+	carveouts[i].size = (uint64_t)pages * PAGE_SIZE;
+}
+
+static void fixed_cases(void)
+{
+	/* No carveouts, no bad pages */
+	check("empty", 64, 0, 0);
+
+	/* Bad pages at both ends of DRAM, listed backwards and twice */
+	bad_pages[0] = page_addr(63);
+	bad_pages[1] = page_addr(0);
+	bad_pages[2] = page_addr(63);
+	check("dram edges", 64, 0, 3);
+
+	/* Carveouts covering both ends of DRAM */
+	set_carveout(0, 56, 8);
+	set_carveout(1, 0, 8);
+	bad_pages[0] = page_addr(8);
+	bad_pages[1] = page_addr(55);
+	check("carveouts at edges", 64, 2, 2);
+
+	/* Bad pages inside carveouts and at their edges */
+	set_carveout(0, 10, 10);
+	set_carveout(1, 30, 5);
+	bad_pages[0] = page_addr(15);
+	bad_pages[1] = page_addr(9);
+	bad_pages[2] = page_addr(20);
+	bad_pages[3] = page_addr(29);
+	bad_pages[4] = page_addr(34);
+	bad_pages[5] = page_addr(35);
+	check("bad pages in carveouts", 64, 2, 6);
+
+	/* Nested, overlapping and back-to-back carveouts */
+	set_carveout(0, 10, 20);
+	set_carveout(1, 12, 4);
+	set_carveout(2, 25, 10);
+	set_carveout(3, 35, 5);
+	bad_pages[0] = page_addr(41);
+	bad_pages[1] = page_addr(9);
+	check("overlapping carveouts", 64, 4, 2);
+
+	/* Runs of bad pages, every merge gap apart */
+	bad_pages[0] = page_addr(1);
+	bad_pages[1] = page_addr(2);
+	bad_pages[2] = page_addr(4);
+	bad_pages[3] = page_addr(7);
+	bad_pages[4] = page_addr(11);
+	bad_pages[5] = page_addr(16);
+	bad_pages[6] = page_addr(22);
+	bad_pages[7] = page_addr(30);
+	set_carveout(0, 20, 1);
+	check("bad page runs", 64, 1, 8);
+
+	/* Every page of DRAM bad */
+	for (uint32_t i = 0; i < 64U; i++) {
+		bad_pages[i] = page_addr(63U - i);
+	}
+	check("all bad", 64, 0, 64);
+}
+
+static void random_cases(void)
+{
+	static const uint32_t bad_counts[] = { 1, 16, 1024, 4096, MAX_BAD_PAGES };
+	char name[64];
+	uint32_t round;
+	uint32_t carveout_count;
+	uint32_t bad_page_count;
+	uint32_t pages;
+	uint32_t i;
+
+	for (round = 0; round < RANDOM_ROUNDS; round++) {
+		carveout_count = (uint32_t)(rng() % (MAX_CARVEOUTS + 1U));
+		for (i = 0; i < carveout_count; i++) {
+			pages = 1U + (uint32_t)(rng() % (DRAM_PAGES / 16U));
+			set_carveout(i, (uint32_t)(rng() % (DRAM_PAGES - pages)), pages);
+		}
+
+		bad_page_count = bad_counts[round % (sizeof(bad_counts) /
+											 sizeof(bad_counts[0]))];
+		bad_page_count = (uint32_t)(rng() % (bad_page_count + 1U));
+		for (i = 0; i < bad_page_count; i++) {
+			if ((i > 0U) && ((rng() % 8U) == 0U)) {
+				/* Duplicates and clusters */
+				bad_pages[i] = bad_pages[rng() % i] +
+					((rng() % 4U) * PAGE_SIZE);
+				if (bad_pages[i] >= page_addr(DRAM_PAGES)) {
+					bad_pages[i] = page_addr(0);
+				}
+			} else {
+				bad_pages[i] = page_addr((uint32_t)(rng() % DRAM_PAGES));
+			}
+		}
+
+		snprintf(name, sizeof(name), "random round %u (%u carveouts, %u bad "
+				 "pages)", round, carveout_count, bad_page_count);
+		check(name, DRAM_PAGES, carveout_count, bad_page_count);
+	}
+}
+
+/* The O(n^2) sort the bad page list went through before build_memmap() */
+static void bubble_sort(uint64_t arr[], uint64_t count)
+{
+	uint64_t i, j, temp;
+
+	for (i = 0; i + 1U < count; i++) {
+		for (j = 0; j < count - i - 1U; j++) {
+			if (arr[j] > arr[j + 1U]) {
+				temp = arr[j];
+				arr[j] = arr[j + 1U];
+				arr[j + 1U] = temp;
+			}
+		}
+	}
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((double)ts.tv_sec * 1e6) + ((double)ts.tv_nsec / 1e3);
+}
+
+static void bench(void)
+{
+	static const uint32_t bad_counts[] = { 1024, 4096, MAX_BAD_PAGES };
+	static struct tegrabl_linuxboot_memblock co_in[MAX_CARVEOUTS];
+	static uint64_t bad_in[MAX_BAD_PAGES];
+	struct linuxboot_memmap map = {
+		.free = free_blocks,
+		.region = regions,
+	};
+	uint32_t reps;
+	uint32_t n;
+	uint32_t i;
+	uint32_t r;
+	double start;
+	double build_us;
+	double bubble_us;
+
+	for (i = 0; i < MAX_CARVEOUTS; i++) {
+		co_in[i].base = page_addr((uint32_t)(rng() % (DRAM_PAGES - 256U)));
+		co_in[i].size = (1U + (rng() % 256U)) * PAGE_SIZE;
+	}
+
+	printf("%10s %16s %16s\n", "bad pages", "build_memmap us", "bubble sort us");
+	for (i = 0; i < sizeof(bad_counts) / sizeof(bad_counts[0]); i++) {
+		n = bad_counts[i];
+		for (r = 0; r < n; r++) {
+			bad_in[r] = page_addr((uint32_t)(rng() % DRAM_PAGES));
+		}
+
+		reps = 200;
+		start = now_us();
+		for (r = 0; r < reps; r++) {
+			memcpy(carveouts, co_in, sizeof(co_in));
+			memcpy(bad_pages, bad_in, n * sizeof(bad_in[0]));
+			build_memmap(&map, DRAM_START, page_addr(DRAM_PAGES), carveouts,
+						 MAX_CARVEOUTS, bad_pages, n);
+		}
+		build_us = (now_us() - start) / reps;
+
+		reps = 2;
+		start = now_us();
+		for (r = 0; r < reps; r++) {
+			memcpy(bad_pages, bad_in, n * sizeof(bad_in[0]));
+			bubble_sort(bad_pages, n);
+		}
+		bubble_us = (now_us() - start) / reps;
+
+		printf("%10u %16.1f %16.1f\n", n, build_us, bubble_us);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if ((argc == 2) && (strcmp(argv[1], "bench") == 0)) {
+		bench();
+		return 0;
+	}
+
+	fixed_cases();
+	random_cases();
+
+	if (failures != 0U) {
+		fprintf(stderr, "%u checks failed\n", failures);
+		return 1;
+	}
+	printf("linuxboot_memmap: all checks passed\n");
+
+	return 0;
+}
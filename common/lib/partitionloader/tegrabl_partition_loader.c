@@ -27,11 +27,21 @@
 #include <tegrabl_bootimg.h>
 #include <tegrabl_linuxboot_helper.h>
 #include <tegrabl_exit.h>
+#include <tegrabl_profiler_span.h>
 
 #ifdef CONFIG_ENABLE_A_B_SLOT
 #include <tegrabl_a_b_boot_control.h>
 #endif
 
+#if defined(CONFIG_ENABLE_QSPI)
+#include <tegrabl_qspi_calib.h>
+#endif
+
+#if defined(CONFIG_ENABLE_BINARY_PREFETCH)
+#include <tegrabl_blockdev.h>
+#include <tegrabl_timer.h>
+#endif
+
 /* boot.img signature size for verify_boot */
 #define BOOT_IMG_SIG_SIZE (4 * 1024)
 
@@ -225,6 +235,18 @@ static tegrabl_error_t tegrabl_get_binary_info(
 	return err;
 }
 
+uint64_t tegrabl_bootimg_load_size(const union tegrabl_bootimg_header *hdr)
+{
+	uint64_t size = ANDROID_HEADER_SIZE;
+
+	size += ALIGN(hdr->kernelsize, hdr->pagesize);
+	size += ALIGN(hdr->ramdisksize, hdr->pagesize);
+	size += ALIGN(hdr->secondsize, hdr->pagesize);
+	size += ALIGN(BOOT_IMG_SIG_SIZE, hdr->pagesize);
+
+	return size;
+}
+
 static tegrabl_error_t read_kernel_partition(
 	struct tegrabl_partition *partition, void *load_address,
 	uint64_t *partition_size)
@@ -248,10 +270,8 @@ static tegrabl_error_t read_kernel_partition(
 	if (!strncmp((char *)hdr->magic, ANDROID_MAGIC, ANDROID_MAGIC_SIZE)) {
 		/* for android kernel, read remaining kernel size */
 		/* align kernel/ramdisk/secondimage/signature size with page size */
-		remain_size = ALIGN(hdr->kernelsize, hdr->pagesize);
-		remain_size += ALIGN(hdr->ramdisksize, hdr->pagesize);
-		remain_size += ALIGN(hdr->secondsize, hdr->pagesize);
-		remain_size += ALIGN(BOOT_IMG_SIG_SIZE, hdr->pagesize);
+		remain_size = (uint32_t)(tegrabl_bootimg_load_size(hdr) -
+								 ANDROID_HEADER_SIZE);
 		pr_trace("%u: kernel partition: read size (excluding header): 0x%08x\n", __LINE__, remain_size);
 
 		if (remain_size + ANDROID_HEADER_SIZE > *partition_size) {
@@ -392,6 +412,379 @@ done:
 	return err;
 }
 
+#if defined(CONFIG_ENABLE_BINARY_PREFETCH)
+/* Number of binaries which can be queued for prefetch at a time */
+#define TEGRABL_PREFETCH_MAX_SLOTS		4U
+
+/* Max time to wait for a prefetch transfer to complete */
+#define TEGRABL_PREFETCH_TIMEOUT_US		(5U * 1000U * 1000U)
+
+/* macro prefetch slot state */
+typedef uint32_t prefetch_state_t;
+#define PREFETCH_STATE_FREE		0U
+#define PREFETCH_STATE_PENDING	1U
+#define PREFETCH_STATE_IN_FLIGHT	2U
+#define PREFETCH_STATE_DONE		3U
+#define PREFETCH_STATE_FAILED	4U
+
+/**
+ * @brief Book-keeping for a binary being read in the background
+ */
+struct tegrabl_prefetch_slot {
+	prefetch_state_t state;
+	tegrabl_binary_type_t bin_type;
+	tegrabl_binary_copy_t binary_copy;
+	void *load_address;
+	uint64_t size;
+	struct tegrabl_partition partition;
+	struct tegrabl_blockdev_xfer_info xfer;
+};
+
+/* Slots are started in the order they were queued, one transfer at a time */
+static struct tegrabl_prefetch_slot prefetch_slots[TEGRABL_PREFETCH_MAX_SLOTS];
+static uint32_t prefetch_slot_count;
+
+static struct tegrabl_prefetch_slot *prefetch_find_slot(
+		tegrabl_binary_type_t bin_type, tegrabl_binary_copy_t binary_copy)
+{
+	uint32_t i;
+
+	for (i = 0; i < prefetch_slot_count; i++) {
+		if ((prefetch_slots[i].state != PREFETCH_STATE_FREE) &&
+			(prefetch_slots[i].bin_type == bin_type) &&
+			(prefetch_slots[i].binary_copy == binary_copy)) {
+			return &prefetch_slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+static tegrabl_error_t prefetch_wait_slot(struct tegrabl_prefetch_slot *slot)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	uint8_t status = TEGRABL_BLOCKDEV_XFER_IN_PROGRESS;
+
+	if (slot->state != PREFETCH_STATE_IN_FLIGHT) {
+		goto done;
+	}
+
+	err = tegrabl_blockdev_xfer_wait(&slot->xfer, TEGRABL_PREFETCH_TIMEOUT_US,
+									 &status);
+	if ((err != TEGRABL_NO_ERROR) ||
+		(status != TEGRABL_BLOCKDEV_XFER_COMPLETE)) {
+		pr_warn("Prefetch of %s failed, will be read again\n",
+				slot->partition.partition_info->name);
+		slot->state = PREFETCH_STATE_FAILED;
+		if (err == TEGRABL_NO_ERROR) {
+			err = TEGRABL_ERROR(TEGRABL_ERR_TIMEOUT, 0);
+		}
+		goto done;
+	}
+
+	slot->state = PREFETCH_STATE_DONE;
+
+done:
+	return err;
+}
+
+/* Wait for the transfer currently owning the storage device, if any */
+static void prefetch_quiesce(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < prefetch_slot_count; i++) {
+		if (prefetch_slots[i].state == PREFETCH_STATE_IN_FLIGHT) {
+			prefetch_wait_slot(&prefetch_slots[i]);
+		}
+	}
+}
+
+/* Start the oldest pending transfer if the storage device is idle */
+static void prefetch_kick(void)
+{
+	tegrabl_error_t err;
+	struct tegrabl_prefetch_slot *slot;
+	uint32_t i;
+
+	for (i = 0; i < prefetch_slot_count; i++) {
+		if (prefetch_slots[i].state == PREFETCH_STATE_IN_FLIGHT) {
+			return;
+		}
+	}
+
+	for (i = 0; i < prefetch_slot_count; i++) {
+		slot = &prefetch_slots[i];
+		if (slot->state != PREFETCH_STATE_PENDING) {
+			continue;
+		}
+
+		err = tegrabl_blockdev_xfer(&slot->xfer);
+		if (err != TEGRABL_NO_ERROR) {
+			pr_warn("Failed to start prefetch of %s\n",
+					slot->partition.partition_info->name);
+			slot->state = PREFETCH_STATE_FAILED;
+			continue;
+		}
+
+		slot->state = PREFETCH_STATE_IN_FLIGHT;
+		return;
+	}
+}
+
+/*
+ * Hand over a binary queued for prefetch. Returns false if it was not
+ * queued, in which case caller has to read it. If the prefetch failed the
+ * binary is read again into the address reserved for it when it was
+ * queued, as asking for a new one would leave that reservation behind;
+ * err returns the result.
+ */
+static bool prefetch_claim(tegrabl_binary_type_t bin_type,
+		tegrabl_binary_copy_t binary_copy, void **load_address,
+		uint32_t *binary_length, tegrabl_error_t *err)
+{
+	struct tegrabl_prefetch_slot *slot;
+	uint32_t i;
+
+	slot = prefetch_find_slot(bin_type, binary_copy);
+	if (slot == NULL) {
+		return false;
+	}
+
+	/* Slots ahead of this one have to drain before it can be started */
+	for (i = 0; (&prefetch_slots[i] != slot) &&
+			(slot->state == PREFETCH_STATE_PENDING); i++) {
+		prefetch_wait_slot(&prefetch_slots[i]);
+		prefetch_kick();
+	}
+	prefetch_kick();
+	prefetch_wait_slot(slot);
+
+	*err = TEGRABL_NO_ERROR;
+	if (slot->state != PREFETCH_STATE_DONE) {
+		/* Storage device is shared with the background reads */
+		prefetch_quiesce();
+		pr_info("Loading partition %s at %p\n",
+				slot->partition.partition_info->name, slot->load_address);
+		*err = tegrabl_partition_read(&slot->partition, slot->load_address,
+									  slot->size);
+		if (*err != TEGRABL_NO_ERROR) {
+			pr_error("Error reading partition %s\n",
+					 slot->partition.partition_info->name);
+			TEGRABL_SET_HIGHEST_MODULE(*err);
+			slot->state = PREFETCH_STATE_FREE;
+			return true;
+		}
+	} else {
+		pr_info("Loaded partition %s at %p (prefetched)\n",
+				slot->partition.partition_info->name, slot->load_address);
+	}
+
+	if (load_address) {
+		*load_address = slot->load_address;
+	}
+
+	if (binary_length) {
+		*binary_length = (uint32_t)slot->size;
+	}
+
+	slot->state = PREFETCH_STATE_FREE;
+	prefetch_kick();
+
+	return true;
+}
+
+tegrabl_error_t tegrabl_prefetch_binary_copy(tegrabl_binary_type_t bin_type,
+		tegrabl_binary_copy_t binary_copy)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	struct tegrabl_prefetch_slot *slot;
+	struct tegrabl_binary_info binary = {0};
+	char partition_name[TEGRABL_GPT_MAX_PARTITION_NAME + 1];
+	tegrabl_bdev_t *bdev;
+	uint64_t partition_size;
+
+	if ((bin_type >= TEGRABL_BINARY_MAX) ||
+		(binary_copy >= TEGRABL_BINARY_COPY_MAX)) {
+		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+		goto done;
+	}
+
+	/* Boot images need their header parsed before the rest can be read */
+#if defined(CONFIG_ENABLE_L4T_RECOVERY)
+	if ((bin_type == TEGRABL_BINARY_KERNEL) ||
+		(bin_type == TEGRABL_BINARY_RECOVERY_KERNEL) ||
+		(bin_type == TEGRABL_BINARY_RECOVERY_IMG))
+#else
+	if ((bin_type == TEGRABL_BINARY_KERNEL) ||
+		(bin_type == TEGRABL_BINARY_RECOVERY_KERNEL))
+#endif
+	{
+		err = TEGRABL_ERROR(TEGRABL_ERR_NOT_SUPPORTED, 0);
+		goto done;
+	}
+
+	slot = prefetch_find_slot(bin_type, binary_copy);
+	if (slot != NULL) {
+		/* A failed read is queued again with the address it already has */
+		if (slot->state == PREFETCH_STATE_FAILED) {
+			slot->state = PREFETCH_STATE_PENDING;
+			prefetch_kick();
+		}
+		goto done;
+	}
+
+	if (prefetch_slot_count == TEGRABL_PREFETCH_MAX_SLOTS) {
+		/* Reuse slots once everything queued so far has been claimed */
+		for (prefetch_slot_count = TEGRABL_PREFETCH_MAX_SLOTS;
+				prefetch_slot_count > 0U; prefetch_slot_count--) {
+			if (prefetch_slots[prefetch_slot_count - 1U].state !=
+					PREFETCH_STATE_FREE) {
+				break;
+			}
+		}
+		if (prefetch_slot_count == TEGRABL_PREFETCH_MAX_SLOTS) {
+			err = TEGRABL_ERROR(TEGRABL_ERR_OVERFLOW, 0);
+			goto done;
+		}
+	}
+	slot = &prefetch_slots[prefetch_slot_count];
+
+	/* Resolve the load address now, it is reserved for this binary */
+	binary.partition_name = partition_name;
+	err = tegrabl_get_binary_info(bin_type, &binary, binary_copy);
+	if (err != TEGRABL_NO_ERROR) {
+		TEGRABL_SET_HIGHEST_MODULE(err);
+		goto done;
+	}
+
+	err = tegrabl_partition_open(binary.partition_name, &slot->partition);
+	if (err != TEGRABL_NO_ERROR) {
+		TEGRABL_SET_HIGHEST_MODULE(err);
+		goto done;
+	}
+
+	partition_size = tegrabl_partition_size(&slot->partition);
+	bdev = slot->partition.block_device;
+	if ((partition_size == 0U) ||
+		((partition_size & (TEGRABL_BLOCKDEV_BLOCK_SIZE(bdev) - 1U)) != 0U)) {
+		err = TEGRABL_ERROR(TEGRABL_ERR_INVALID, 1);
+		goto done;
+	}
+
+	memset(&slot->xfer, 0, sizeof(slot->xfer));
+	slot->xfer.dev = bdev;
+	slot->xfer.xfer_type = TEGRABL_BLOCKDEV_READ;
+	slot->xfer.start_block = slot->partition.partition_info->start_sector;
+	slot->xfer.block_count = partition_size >> bdev->block_size_log2;
+	slot->xfer.buf = binary.load_address;
+	slot->xfer.is_non_blocking = true;
+
+	slot->bin_type = bin_type;
+	slot->binary_copy = binary_copy;
+	slot->load_address = binary.load_address;
+	slot->size = partition_size;
+	slot->state = PREFETCH_STATE_PENDING;
+	prefetch_slot_count++;
+
+	pr_debug("Queued prefetch of %s at %p\n", binary.partition_name,
+			 binary.load_address);
+
+	prefetch_kick();
+
+done:
+	return err;
+}
+
+tegrabl_error_t tegrabl_prefetch_binary(tegrabl_binary_type_t bin_type)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	tegrabl_binary_copy_t bin_copy = TEGRABL_BINARY_COPY_PRIMARY;
+
+#if defined(CONFIG_ENABLE_A_B_SLOT)
+	err = a_b_get_bin_copy(bin_type, &bin_copy);
+	if (err != TEGRABL_NO_ERROR) {
+		goto done;
+	}
+#endif
+
+	err = tegrabl_prefetch_binary_copy(bin_type, bin_copy);
+
+#if defined(CONFIG_ENABLE_A_B_SLOT)
+done:
+#endif
+	return err;
+}
+
+/*
+ * Queue the binaries read after the given kernel (kernel DTB, then NCT, or
+ * recovery DTB) from the same copy, so that they get read while the kernel
+ * is verified. Failures only mean they are read on demand.
+ */
+static void prefetch_kernel_companions(tegrabl_binary_type_t kernel_type,
+		tegrabl_binary_copy_t binary_copy)
+{
+	/* Order matters, slots are read back to back in the order queued */
+#if defined(CONFIG_ENABLE_L4T_RECOVERY)
+	if (kernel_type == TEGRABL_BINARY_RECOVERY_IMG) {
+		(void)tegrabl_prefetch_binary_copy(TEGRABL_BINARY_RECOVERY_DTB,
+										   binary_copy);
+		return;
+	}
+#endif
+
+	if (tegrabl_prefetch_binary_copy(TEGRABL_BINARY_KERNEL_DTB, binary_copy) !=
+			TEGRABL_NO_ERROR) {
+		pr_debug("Kernel DTB not queued for prefetch\n");
+		return;
+	}
+
+	if (kernel_type == TEGRABL_BINARY_KERNEL) {
+		/* NCT is optional, do not report its absence */
+		if (tegrabl_prefetch_binary_copy(TEGRABL_BINARY_NCT, binary_copy) !=
+				TEGRABL_NO_ERROR) {
+			pr_debug("NCT not queued for prefetch\n");
+		}
+	}
+}
+
+/*
+ * Drop the slots of a binary read on demand; they target the same load
+ * address. Called with no transfer in flight.
+ */
+static void prefetch_cancel(tegrabl_binary_type_t bin_type)
+{
+	uint32_t i;
+
+	for (i = 0; i < prefetch_slot_count; i++) {
+		if (prefetch_slots[i].bin_type == bin_type) {
+			prefetch_slots[i].state = PREFETCH_STATE_FREE;
+		}
+	}
+}
+#endif /* CONFIG_ENABLE_BINARY_PREFETCH */
+
+/* Controller a partition is read through, for its load span */
+static tegrabl_module_t partition_span_module(
+		struct tegrabl_partition *partition)
+{
+	switch (tegrabl_blockdev_get_storage_type(partition->block_device)) {
+	case TEGRABL_STORAGE_SDMMC_BOOT:
+	case TEGRABL_STORAGE_SDMMC_USER:
+	case TEGRABL_STORAGE_SDMMC_RPMB:
+	case TEGRABL_STORAGE_SDCARD:
+		return TEGRABL_MODULE_SDMMC;
+	case TEGRABL_STORAGE_QSPI_FLASH:
+		return TEGRABL_MODULE_QSPI;
+	case TEGRABL_STORAGE_SATA:
+		return TEGRABL_MODULE_SATA;
+	case TEGRABL_STORAGE_USB_MS:
+		return TEGRABL_MODULE_XUSB_HOST;
+	default:
+		return TEGRABL_PROF_SPAN_NO_MODULE;
+	}
+}
+
 tegrabl_error_t tegrabl_load_binary_copy(
 	tegrabl_binary_type_t bin_type, void **load_address,
 	uint32_t *binary_length, tegrabl_binary_copy_t binary_copy)
@@ -402,6 +795,7 @@ tegrabl_error_t tegrabl_load_binary_copy(
 	struct tegrabl_binary_info binary = {0};
 	char partition_name[TEGRABL_GPT_MAX_PARTITION_NAME + 1];
 	bool load_addr_predefined = true;
+	uint32_t span;
 
 	pr_trace("%s(): %u\n", __func__, __LINE__);
 
@@ -410,6 +804,17 @@ tegrabl_error_t tegrabl_load_binary_copy(
 		goto done;
 	}
 
+#if defined(CONFIG_ENABLE_BINARY_PREFETCH)
+	if (prefetch_claim(bin_type, binary_copy, load_address, binary_length,
+					   &err)) {
+		goto done;
+	}
+
+	/* Storage device is shared with the background reads */
+	prefetch_quiesce();
+	prefetch_cancel(bin_type);
+#endif
+
 	binary.partition_name = partition_name;
 	err = tegrabl_get_binary_info(bin_type, &binary, binary_copy);
 	if (err != TEGRABL_NO_ERROR &&
@@ -445,6 +850,14 @@ tegrabl_error_t tegrabl_load_binary_copy(
 	pr_info("Loading partition %s at %p from device(0x%x)\n", binary.partition_name, binary.load_address,
 			tegrabl_blockdev_get_storage_type(partition.block_device));
 
+#if defined(CONFIG_ENABLE_QSPI)
+	/* QSPI driver is up by now and no background read is in flight */
+	if (tegrabl_blockdev_get_storage_type(partition.block_device) ==
+		TEGRABL_STORAGE_QSPI_FLASH) {
+		(void)tegrabl_qspi_calib_run();
+	}
+#endif
+
 	/* Get partition size */
 	partition_size = tegrabl_partition_size(&partition);
 	pr_debug("Size of partition: %"PRIu64"\n", partition_size);
@@ -462,6 +875,8 @@ tegrabl_error_t tegrabl_load_binary_copy(
 	}
 
 	/* Read the partition from storage */
+	span = tegrabl_profiler_span_begin(binary.partition_name,
+									   partition_span_module(&partition));
 #if defined(CONFIG_ENABLE_L4T_RECOVERY)
 	if (bin_type == TEGRABL_BINARY_KERNEL
 		|| bin_type == TEGRABL_BINARY_RECOVERY_IMG)
@@ -473,6 +888,7 @@ tegrabl_error_t tegrabl_load_binary_copy(
 	else
 		err = tegrabl_partition_read(&partition, binary.load_address,
 									 partition_size);
+	tegrabl_profiler_span_end(span, partition_size);
 
 	if (err != TEGRABL_NO_ERROR) {
 		pr_error("Error reading partition %s\n", binary.partition_name);
@@ -489,7 +905,24 @@ tegrabl_error_t tegrabl_load_binary_copy(
 		*binary_length = partition_size;
 	}
 
+#if defined(CONFIG_ENABLE_BINARY_PREFETCH)
+#if defined(CONFIG_ENABLE_L4T_RECOVERY)
+	if ((bin_type == TEGRABL_BINARY_KERNEL) ||
+		(bin_type == TEGRABL_BINARY_RECOVERY_KERNEL) ||
+		(bin_type == TEGRABL_BINARY_RECOVERY_IMG))
+#else
+	if ((bin_type == TEGRABL_BINARY_KERNEL) ||
+		(bin_type == TEGRABL_BINARY_RECOVERY_KERNEL))
+#endif
+	{
+		prefetch_kernel_companions(bin_type, binary_copy);
+	}
+#endif
+
 done:
+#if defined(CONFIG_ENABLE_BINARY_PREFETCH)
+	prefetch_kick();
+#endif
 	return err;
 }
 
@@ -29,6 +29,10 @@
 #include <tegrabl_brbct.h>
 #include <tegrabl_soc_misc.h>
 #include <tegrabl_se.h>
+#include <tegrabl_profiler_span.h>
+#if defined(CONFIG_ENABLE_VIC_BULK_COPY)
+#include <tegrabl_vic.h>
+#endif
 
 #define ONE_KB 1024
 #define BR_BCT_ECCPUBKEY_ADDRESS 0x4004EA0C
@@ -992,7 +996,11 @@ tegrabl_error_t tegrabl_auth_set_new_destination(
 
 
 	if (move) {
+#if defined(CONFIG_ENABLE_VIC_BULK_COPY)
+		cb_vic_memcpy(new_addr, auth->dest_location, auth->processed_size);
+#else
 		memmove(new_addr, auth->dest_location, auth->processed_size);
+#endif
 		auth->safe_dest_location = (void *)((uintptr_t)new_addr +
 				auth->processed_size);
 
@@ -1013,12 +1021,14 @@ tegrabl_error_t tegrabl_auth_payload(tegrabl_binary_type_t bin_type,
 {
 	tegrabl_error_t err = TEGRABL_NO_ERROR;
 	struct tegrabl_auth_handle auth = {0};
+	uint32_t span;
 #if defined(CONFIG_OS_IS_L4T)
 	uint32_t binary_len;
 #endif
 
 	pr_info("T18x: Authenticate %s (bin_type %u), max size 0x%x\n", name,
 			bin_type, max_size);
+	span = tegrabl_profiler_span_begin("auth", TEGRABL_MODULE_SE);
 
 	/* validate bin_type type */
 	switch (bin_type) {
@@ -1080,6 +1090,7 @@ tegrabl_error_t tegrabl_auth_payload(tegrabl_binary_type_t bin_type,
 fail:
 	/* End of authentication process */
 	tegrabl_auth_end(&auth);
+	tegrabl_profiler_span_end(span, auth.processed_size);
 
 	return err;
 }
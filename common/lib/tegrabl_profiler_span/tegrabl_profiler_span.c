@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_NO_MODULE
+
+#include "build_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <tegrabl_compiler.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_profiler_span.h>
+
+#if defined(CONFIG_ENABLE_PROFILER_SPANS)
+
+struct prof_span_open {
+	uint16_t name;
+	uint16_t module;
+};
+
+/* Own memory, so the log does not depend on any shared carveout layout */
+static uint64_t prof_span_buf[TEGRABL_PROF_SPAN_LOG_SIZE / sizeof(uint64_t)];
+static struct tegrabl_prof_span_header *prof_span_log;
+static struct prof_span_open prof_span_stack[TEGRABL_PROF_SPAN_MAX_DEPTH];
+static uint32_t prof_span_depth;
+
+/* The log is set up on the first span */
+static void prof_span_init(void)
+{
+	if (prof_span_log != NULL) {
+		return;
+	}
+
+	prof_span_log = (struct tegrabl_prof_span_header *)prof_span_buf;
+	memset(prof_span_log, 0, sizeof(*prof_span_log));
+	prof_span_log->magic = TEGRABL_PROF_SPAN_MAGIC;
+	prof_span_log->version = TEGRABL_PROF_SPAN_VERSION;
+	prof_span_log->record_size = sizeof(struct tegrabl_prof_span_record);
+	prof_span_log->size = TEGRABL_PROF_SPAN_LOG_SIZE;
+	prof_span_log->str_offset = TEGRABL_PROF_SPAN_LOG_SIZE;
+}
+
+static struct tegrabl_prof_span_record *prof_span_records(void)
+{
+	return (struct tegrabl_prof_span_record *)(prof_span_log + 1);
+}
+
+/* Whether that many more records fit below str_offset */
+static bool prof_span_room(uint32_t records, uint32_t str_offset)
+{
+	return (sizeof(*prof_span_log) +
+			((prof_span_log->num_records + records) *
+			 sizeof(struct tegrabl_prof_span_record))) <= str_offset;
+}
+
+static uint16_t prof_span_intern(const char *name, uint32_t reserve)
+{
+	char *strtab = (char *)prof_span_log;
+	uint32_t offset;
+	uint32_t len;
+
+	for (offset = prof_span_log->str_offset; offset < prof_span_log->size;
+		 offset += strlen(&strtab[offset]) + 1U) {
+		if (strcmp(&strtab[offset], name) == 0) {
+			return (uint16_t)offset;
+		}
+	}
+
+	len = strlen(name) + 1U;
+	if ((len > prof_span_log->str_offset) ||
+		!prof_span_room(reserve, prof_span_log->str_offset - len)) {
+		return 0;
+	}
+
+	prof_span_log->str_offset -= len;
+	memcpy(&strtab[prof_span_log->str_offset], name, len);
+
+	return (uint16_t)prof_span_log->str_offset;
+}
+
+static void prof_span_record(uint8_t type, const struct prof_span_open *open,
+							 uint64_t bytes)
+{
+	struct tegrabl_prof_span_record *rec;
+
+	rec = &prof_span_records()[prof_span_log->num_records++];
+	rec->timestamp_us = (uint32_t)tegrabl_get_timestamp_us();
+	rec->type = type;
+	rec->depth = (uint8_t)prof_span_depth;
+	rec->module = open->module;
+	rec->name = open->name;
+	rec->reserved = 0;
+	rec->bytes = (bytes > UINT32_MAX) ? UINT32_MAX : (uint32_t)bytes;
+}
+
+uint32_t tegrabl_profiler_span_begin(const char *name, tegrabl_module_t module)
+{
+	struct prof_span_open *open;
+	/* This BEGIN plus the END of every span open after it */
+	uint32_t reserve = prof_span_depth + 2U;
+
+	prof_span_init();
+
+	if ((prof_span_depth == TEGRABL_PROF_SPAN_MAX_DEPTH) ||
+		!prof_span_room(reserve, prof_span_log->str_offset)) {
+		prof_span_log->dropped++;
+		return TEGRABL_PROF_SPAN_NONE;
+	}
+
+	open = &prof_span_stack[prof_span_depth];
+	open->name = prof_span_intern(name, reserve);
+	open->module = (module >= TEGRABL_PROF_SPAN_NO_MODULE) ?
+		TEGRABL_PROF_SPAN_REC_NO_MODULE : (uint16_t)module;
+	prof_span_record(TEGRABL_PROF_SPAN_BEGIN, open, 0);
+	prof_span_depth++;
+
+	return prof_span_depth;
+}
+
+void tegrabl_profiler_span_end(uint32_t span, uint64_t bytes)
+{
+	if ((span == TEGRABL_PROF_SPAN_NONE) || (span > prof_span_depth)) {
+		return;
+	}
+
+	/* Spans left open inside this one end with it */
+	while (prof_span_depth >= span) {
+		prof_span_depth--;
+		prof_span_record(TEGRABL_PROF_SPAN_END,
+						 &prof_span_stack[prof_span_depth],
+						 (prof_span_depth == (span - 1U)) ? bytes : 0U);
+	}
+}
+
+uint64_t tegrabl_profiler_span_log(uint32_t *size)
+{
+	if (prof_span_log == NULL) {
+		return 0;
+	}
+
+	*size = prof_span_log->size;
+	return (uint64_t)(uintptr_t)prof_span_log;
+}
+
+#else
+
+uint32_t tegrabl_profiler_span_begin(const char *name, tegrabl_module_t module)
+{
+	TEGRABL_UNUSED(name);
+	TEGRABL_UNUSED(module);
+
+	return TEGRABL_PROF_SPAN_NONE;
+}
+
+void tegrabl_profiler_span_end(uint32_t span, uint64_t bytes)
+{
+	TEGRABL_UNUSED(span);
+	TEGRABL_UNUSED(bytes);
+}
+
+uint64_t tegrabl_profiler_span_log(uint32_t *size)
+{
+	TEGRABL_UNUSED(size);
+
+	return 0;
+}
+
+#endif /* CONFIG_ENABLE_PROFILER_SPANS */
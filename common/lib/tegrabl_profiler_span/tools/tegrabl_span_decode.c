@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+/*
+ * Host tool: decodes a dump of the boot span log (bl_prof_spanptr) into
+ * Chrome trace event JSON, which chrome://tracing and Perfetto load, and
+ * prints the duration and throughput of every span to stderr.
+ *
+ * Build:
+ *   cc -std=c99 -Wall -I common/include/lib \
+ *      common/lib/tegrabl_profiler_span/tools/tegrabl_span_decode.c \
+ *      -o tegrabl_span_decode
+ *
+ * Dump on target, with <size>@<addr> from bl_prof_spanptr:
+ *   dd if=/dev/mem of=spans.bin bs=<size> count=1 iflag=skip_bytes \
+ *      skip=<addr>
+ *
+ * Usage:
+ *   tegrabl_span_decode spans.bin > spans.json
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tegrabl_profiler_span_log.h>
+
+#define MAX_DEPTH	256U
+
+struct span_open {
+	uint32_t timestamp_us;
+	uint16_t name;
+	uint16_t module;
+};
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return (uint32_t)get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+/* Offsets as laid out in tegrabl_profiler_span_log.h */
+static void read_header(const uint8_t *p, struct tegrabl_prof_span_header *h)
+{
+	h->magic = get32(p);
+	h->version = get16(p + 4);
+	h->record_size = get16(p + 6);
+	h->size = get32(p + 8);
+	h->num_records = get32(p + 12);
+	h->str_offset = get32(p + 16);
+	h->dropped = get32(p + 20);
+}
+
+static void read_record(const uint8_t *p, struct tegrabl_prof_span_record *r)
+{
+	r->timestamp_us = get32(p);
+	r->type = p[4];
+	r->depth = p[5];
+	r->module = get16(p + 6);
+	r->name = get16(p + 8);
+	r->bytes = get32(p + 12);
+}
+
+static const char *span_name(const uint8_t *log, uint32_t size,
+							 uint32_t str_offset, uint16_t name)
+{
+	if ((name == 0U) || (name < str_offset) || (name >= size) ||
+		(memchr(&log[name], '\0', size - name) == NULL)) {
+		return "?";
+	}
+
+	return (const char *)&log[name];
+}
+
+static void print_json_string(const char *s)
+{
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		if ((*s == '"') || (*s == '\\')) {
+			putchar('\\');
+			putchar(*s);
+		} else if ((unsigned char)*s < 0x20U) {
+			printf("\\u%04x", (unsigned char)*s);
+		} else {
+			putchar(*s);
+		}
+	}
+	putchar('"');
+}
+
+static void print_category(uint16_t module)
+{
+	if (module == TEGRABL_PROF_SPAN_REC_NO_MODULE) {
+		printf("\"cpu\"");
+	} else {
+		printf("\"module%u\"", module);
+	}
+}
+
+static int decode(const uint8_t *log, size_t len)
+{
+	struct tegrabl_prof_span_header hdr;
+	struct tegrabl_prof_span_record rec;
+	struct span_open stack[MAX_DEPTH];
+	uint32_t depth = 0;
+	uint32_t dur_us;
+	uint32_t i;
+	const char *name;
+	const char *sep = "";
+
+	if (len < sizeof(hdr)) {
+		fprintf(stderr, "dump too short for a span log header\n");
+		return 1;
+	}
+	read_header(log, &hdr);
+	if (hdr.magic != TEGRABL_PROF_SPAN_MAGIC) {
+		fprintf(stderr, "bad magic 0x%08x\n", hdr.magic);
+		return 1;
+	}
+	if (hdr.version != TEGRABL_PROF_SPAN_VERSION) {
+		fprintf(stderr, "unsupported version %u\n", hdr.version);
+		return 1;
+	}
+	if (hdr.record_size != sizeof(rec)) {
+		fprintf(stderr, "unexpected record size %u\n", hdr.record_size);
+		return 1;
+	}
+	if ((hdr.size > len) || (hdr.str_offset < sizeof(hdr)) ||
+		(hdr.str_offset > hdr.size) ||
+		(hdr.num_records > ((hdr.str_offset - sizeof(hdr)) / sizeof(rec)))) {
+		fprintf(stderr, "log of %u bytes with %u records does not fit the "
+				"%zu byte dump\n", hdr.size, hdr.num_records, len);
+		return 1;
+	}
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (i = 0; i < hdr.num_records; i++) {
+		read_record(&log[sizeof(hdr) + (i * sizeof(rec))], &rec);
+		name = span_name(log, hdr.size, hdr.str_offset, rec.name);
+
+		printf("%s{\"name\":", sep);
+		print_json_string(name);
+		printf(",\"cat\":");
+		print_category(rec.module);
+		printf(",\"ph\":\"%c\",\"ts\":%u,\"pid\":0,\"tid\":0",
+			   (rec.type == TEGRABL_PROF_SPAN_BEGIN) ? 'B' : 'E',
+			   rec.timestamp_us);
+		if (rec.type == TEGRABL_PROF_SPAN_END) {
+			printf(",\"args\":{\"bytes\":%u}", rec.bytes);
+		}
+		printf("}");
+		sep = ",\n";
+
+		if (rec.type == TEGRABL_PROF_SPAN_BEGIN) {
+			if (depth < MAX_DEPTH) {
+				stack[depth].timestamp_us = rec.timestamp_us;
+				stack[depth].name = rec.name;
+				stack[depth].module = rec.module;
+			}
+			depth++;
+			continue;
+		}
+		if ((rec.type != TEGRABL_PROF_SPAN_END) || (depth == 0U)) {
+			fprintf(stderr, "record %u: unexpected type %u\n", i, rec.type);
+			continue;
+		}
+		depth--;
+		if ((depth >= MAX_DEPTH) || (stack[depth].name != rec.name)) {
+			fprintf(stderr, "record %u: END does not match its BEGIN\n", i);
+			continue;
+		}
+
+		dur_us = rec.timestamp_us - stack[depth].timestamp_us;
+		fprintf(stderr, "%*s%-24s %8u us", (int)(2U * depth), "", name,
+				dur_us);
+		if ((rec.bytes != 0U) && (dur_us != 0U)) {
+			fprintf(stderr, " %10u bytes %8.2f MB/s", rec.bytes,
+					(double)rec.bytes / (double)dur_us);
+		}
+		fprintf(stderr, "\n");
+	}
+	printf("\n]}\n");
+
+	if (depth != 0U) {
+		fprintf(stderr, "%u spans left open\n", depth);
+	}
+	if (hdr.dropped != 0U) {
+		fprintf(stderr, "%u spans dropped by the bootloader\n", hdr.dropped);
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	FILE *fp;
+	uint8_t *log;
+	size_t len;
+	int ret;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <span log dump>\n", argv[0]);
+		return 2;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	log = malloc(TEGRABL_PROF_SPAN_LOG_SIZE);
+	if (log == NULL) {
+		fclose(fp);
+		return 1;
+	}
+	len = fread(log, 1, TEGRABL_PROF_SPAN_LOG_SIZE, fp);
+	fclose(fp);
+
+	ret = decode(log, len);
+	free(log);
+
+	return ret;
+}
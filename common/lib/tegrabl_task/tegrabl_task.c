@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#define MODULE TEGRABL_ERR_NO_MODULE
+
+#include "build_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <tegrabl_error.h>
+#include <tegrabl_debug.h>
+#include <tegrabl_cpu_arch.h>
+#include <tegrabl_timer.h>
+#include <tegrabl_task.h>
+
+#if defined(CONFIG_ENABLE_DEFERRED_TASKS)
+
+/* Tasks kept for tegrabl_task_trace_dump() */
+#define TASK_MAX_TRACED		16U
+
+static struct tegrabl_task *task_queue;
+/* Task whose step is running, steps do not nest */
+static struct tegrabl_task *task_current;
+/* Round robin position among the queued tasks */
+static struct tegrabl_task *task_last;
+static uint32_t task_claimed;
+/* Depth of no-yield sections */
+static uint32_t task_no_yield;
+
+static struct tegrabl_task *task_traced[TASK_MAX_TRACED];
+static uint32_t task_num_traced;
+
+/* Timestamps are compared as differences so a TSCUS wrap is harmless */
+static uint32_t task_now(void)
+{
+	return (uint32_t)tegrabl_get_timestamp_us();
+}
+
+static bool task_ready(const struct tegrabl_task *task, uint32_t now,
+					   uint32_t budget_us)
+{
+	return ((int32_t)(now - task->wake_us) >= 0) &&
+		((task->resources & task_claimed) == 0U) &&
+		(task->step_us <= budget_us);
+}
+
+static void task_remove(struct tegrabl_task *task)
+{
+	struct tegrabl_task **prev = &task_queue;
+
+	while ((*prev != NULL) && (*prev != task)) {
+		prev = &(*prev)->next;
+	}
+	if (*prev != NULL) {
+		*prev = task->next;
+	}
+	if (task_last == task) {
+		task_last = NULL;
+	}
+	task->next = NULL;
+	task->queued = false;
+}
+
+static void task_run(struct tegrabl_task *task, bool from_delay)
+{
+	uint32_t claimed;
+	uint32_t start;
+	uint32_t us;
+	bool done;
+
+	task_current = task;
+	task_last = task;
+	claimed = tegrabl_task_claim(task->resources);
+
+	start = task_now();
+	done = task->step(task);
+	us = task_now() - start;
+
+	tegrabl_task_release(claimed);
+	task_current = NULL;
+
+	task->steps++;
+	task->busy_us += us;
+	if (from_delay) {
+		task->delay_steps++;
+		task->delay_us += us;
+	}
+	if (us > task->step_us) {
+		task->step_us = us;
+	}
+
+	if (done) {
+		task_remove(task);
+		task->done = true;
+		if (task->err != TEGRABL_NO_ERROR) {
+			pr_error("task %s failed, error 0x%x\n", task->name, task->err);
+		}
+	}
+}
+
+/* Next ready task after the last one run, so no task starves the others */
+static struct tegrabl_task *task_pick(uint32_t budget_us)
+{
+	struct tegrabl_task *task;
+	struct tegrabl_task *start;
+	uint32_t now = task_now();
+
+	start = ((task_last != NULL) && (task_last->next != NULL)) ?
+		task_last->next : task_queue;
+	task = start;
+	while (task != NULL) {
+		if (task_ready(task, now, budget_us)) {
+			return task;
+		}
+		task = (task->next != NULL) ? task->next : task_queue;
+		if (task == start) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+tegrabl_error_t tegrabl_task_add(struct tegrabl_task *task)
+{
+	struct tegrabl_task **tail = &task_queue;
+	uint32_t i;
+
+	if ((task == NULL) || (task->step == NULL)) {
+		return TEGRABL_ERROR(TEGRABL_ERR_BAD_PARAMETER, 0);
+	}
+	if (task->queued) {
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 0);
+	}
+
+	task->state = 0;
+	task->err = TEGRABL_NO_ERROR;
+	task->next = NULL;
+	task->queued = true;
+	task->done = false;
+	task->wake_us = task_now();
+	if (task->step_us == 0U) {
+		task->step_us = TEGRABL_TASK_DEFAULT_STEP_US;
+	}
+
+	while (*tail != NULL) {
+		tail = &(*tail)->next;
+	}
+	*tail = task;
+
+	/* A task added again adds to its earlier figures */
+	for (i = 0; i < task_num_traced; i++) {
+		if (task_traced[i] == task) {
+			break;
+		}
+	}
+	if ((i == task_num_traced) && (task_num_traced < TASK_MAX_TRACED)) {
+		task_traced[task_num_traced++] = task;
+	}
+
+	return TEGRABL_NO_ERROR;
+}
+
+void tegrabl_task_sleep(struct tegrabl_task *task, uint32_t usec)
+{
+	task->wake_us = task_now() + usec;
+	task->sleep_us += usec;
+}
+
+bool tegrabl_task_pending(const struct tegrabl_task *task)
+{
+	return task->queued;
+}
+
+tegrabl_error_t tegrabl_task_wait(struct tegrabl_task *task)
+{
+	struct tegrabl_task *other;
+	uint32_t start;
+	uint32_t now;
+
+	if (!task->queued) {
+		return task->done ? task->err :
+			TEGRABL_ERROR(TEGRABL_ERR_NOT_STARTED, 0);
+	}
+	if (task_current != NULL) {
+		pr_error("task %s waited for from task %s\n", task->name,
+				 task_current->name);
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 1);
+	}
+	if ((task->resources & task_claimed) != 0U) {
+		pr_error("task %s waited for with its resources 0x%x claimed\n",
+				 task->name, task->resources & task_claimed);
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 2);
+	}
+	if (task_no_yield != 0U) {
+		pr_error("task %s waited for in a no-yield section\n", task->name);
+		return TEGRABL_ERROR(TEGRABL_ERR_INVALID, 3);
+	}
+
+	start = task_now();
+	while (task->queued) {
+		now = task_now();
+		if (task_ready(task, now, UINT32_MAX)) {
+			task_run(task, false);
+			continue;
+		}
+		/* While it sleeps, give the time to others whose steps fit */
+		other = task_pick(task->wake_us - now);
+		if (other != NULL) {
+			task_run(other, true);
+		} else {
+			tegrabl_yield();
+		}
+	}
+	task->wait_us += task_now() - start;
+
+	return task->err;
+}
+
+tegrabl_error_t tegrabl_task_wait_all(void)
+{
+	tegrabl_error_t err = TEGRABL_NO_ERROR;
+	tegrabl_error_t status;
+
+	while (task_queue != NULL) {
+		status = tegrabl_task_wait(task_queue);
+		if (TEGRABL_ERROR_REASON(status) == TEGRABL_ERR_INVALID) {
+			return status;
+		}
+		if (err == TEGRABL_NO_ERROR) {
+			err = status;
+		}
+	}
+
+	return err;
+}
+
+void tegrabl_task_yield(time_t budget_us)
+{
+	struct tegrabl_task *task;
+
+	if ((task_queue == NULL) || (task_current != NULL) ||
+		(task_no_yield != 0U)) {
+		return;
+	}
+
+	task = task_pick((budget_us > UINT32_MAX) ? UINT32_MAX :
+					 (uint32_t)budget_us);
+	if (task != NULL) {
+		task_run(task, true);
+	}
+}
+
+uint32_t tegrabl_task_claim(uint32_t resources)
+{
+	uint32_t claimed = resources & ~task_claimed;
+
+	task_claimed |= claimed;
+
+	return claimed;
+}
+
+void tegrabl_task_release(uint32_t resources)
+{
+	task_claimed &= ~resources;
+}
+
+void tegrabl_task_no_yield_begin(void)
+{
+	task_no_yield++;
+}
+
+void tegrabl_task_no_yield_end(void)
+{
+	if (task_no_yield != 0U) {
+		task_no_yield--;
+	}
+}
+
+void tegrabl_task_trace_dump(void)
+{
+	const struct tegrabl_task *task;
+	uint32_t serial_us;
+	uint32_t total_serial = 0;
+	uint32_t total_wait = 0;
+	uint32_t i;
+
+	pr_info("Deferred tasks: %u\n", task_num_traced);
+	pr_info("  steps in_delay  busy_us delay_us sleep_us  wait_us task\n");
+	for (i = 0; i < task_num_traced; i++) {
+		task = task_traced[i];
+		pr_info("  %5u %8u %8u %8u %8u %8u %s%s\n", task->steps,
+				task->delay_steps, task->busy_us, task->delay_us,
+				task->sleep_us, task->wait_us, task->name,
+				task->queued ? " (pending)" :
+				(task->err != TEGRABL_NO_ERROR) ? " (failed)" : "");
+
+		/* In line, the task would have cost its steps and its sleeps */
+		serial_us = task->busy_us + task->sleep_us;
+		total_serial += serial_us;
+		total_wait += task->wait_us;
+	}
+	pr_info("  in line %u us, waited for %u us, saved %u us\n", total_serial,
+			total_wait, (total_serial > total_wait) ?
+			(total_serial - total_wait) : 0U);
+}
+
+#endif /* CONFIG_ENABLE_DEFERRED_TASKS */
@@ -460,13 +460,22 @@ fail:
 void mb1_print_chip_info(void)
 {
 	uint32_t reg = 0;
+	uint32_t row = 0;
 	struct tegrabl_chip_info info;
 	/* print bootrom patch version */
 	reg = tegrabl_fuse_get_bootrom_patch_version();
-	pr_info("Bootrom patch version : %u (%s)\n", reg,
-			(((reg > 1) &&  (tegrabl_fuserdata_read(0xBA) == 0)) ?
-			"incorrectly patched" : "correctly patched"));
-	pr_info("ATE fuse revision : 0x%x\n", tegrabl_fuserdata_read(0x14));
+	if ((reg > 1) && (tegrabl_fuserdata_read(0xBA, &row) != TEGRABL_NO_ERROR)) {
+		pr_info("Bootrom patch version : %u (unknown)\n", reg);
+	} else {
+		pr_info("Bootrom patch version : %u (%s)\n", reg,
+				(((reg > 1) && (row == 0)) ?
+				"incorrectly patched" : "correctly patched"));
+	}
+	if (tegrabl_fuserdata_read(0x14, &row) != TEGRABL_NO_ERROR) {
+		pr_error("ATE fuse revision read failed\n");
+	} else {
+		pr_info("ATE fuse revision : 0x%x\n", row);
+	}
 	if (!fuse_is_nv_production_mode()) {
 		if (tegrabl_fuse_read(FUSE_OPT_PRIV_SEC_EN, &reg, sizeof(reg)) != TEGRABL_NO_ERROR) {
 			pr_error("OPT fuse priv sec_en read failed\n");